@@ -0,0 +1,404 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// End-to-end benchmark: generates synthetic VCD files, runs vcdiff on them
+// and compares the measurements with a stored baseline.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+///> Set of generated files
+struct Config {
+    const char*name;
+
+    // vcdgen parameters, the second file gets the injected differences
+    const char*params;
+    const char*diffs;
+};
+
+static const Config configs[] = {
+    { "flat",   "-n 2000 -d 1 -w 16 -t 0.1 -a 0.1 -s 10000",
+        "100:5,2000:17,5000:1000,9000:1500" },
+    { "deep",   "-n 20000 -d 6 -w 128 -t 0.01 -a 0.2 -s 5000",
+        "10:10,1000:300,2500:12345,4000:19999" },
+    { NULL, NULL, NULL }
+};
+
+///> Result of a single vcdiff run
+struct Run {
+    double wall;        // seconds
+    long peak_rss;      // kilobytes
+    unsigned long diffs;
+};
+
+///> Metric stored in results, with its preferred direction
+struct Metric {
+    double value;
+    bool higher_better;
+};
+
+typedef map<string, Metric> Results;
+
+// Splits a string at spaces
+static vector<string> split(const string&str) {
+    vector<string> res;
+    size_t pos = 0;
+
+    while((pos = str.find_first_not_of(' ', pos)) != string::npos) {
+        size_t end = str.find(' ', pos);
+        res.push_back(str.substr(pos, end - pos));
+        pos = end;
+    }
+
+    return res;
+}
+
+// Runs a command, stdout is passed to a file descriptor (or /dev/null if -1)
+static bool run(const vector<string>&args, int out_fd, struct rusage*usage) {
+    pid_t pid = fork();
+
+    if(pid < 0)
+        return false;
+
+    if(pid == 0) {
+        vector<char*> argv;
+
+        for(const string&arg : args)
+            argv.push_back(const_cast<char*>(arg.c_str()));
+
+        argv.push_back(NULL);
+
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(out_fd >= 0 ? out_fd : null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+
+    int status;
+
+    if(wait4(pid, &status, 0, usage) < 0)
+        return false;
+
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Runs vcdiff and collects the measurements, the fastest run is reported
+static bool measure(const string&vcdiff, const string&file1,
+        const string&file2, unsigned int repeats, Run&result) {
+    result.wall = 1e30;
+    result.peak_rss = 0;
+    result.diffs = 0;
+
+    for(unsigned int i = 0; i < repeats; ++i) {
+        // Store the output in a temporary file to count the differences
+        char path[] = "/tmp/vcdiff_bench.XXXXXX";
+        int fd = mkstemp(path);
+
+        if(fd < 0)
+            return false;
+
+        unlink(path);
+
+        vector<string> args = { vcdiff, "-Wno-all", file1, file2 };
+        struct rusage usage;
+        auto start = chrono::steady_clock::now();
+        bool ok = run(args, fd, &usage);
+        chrono::duration<double> wall = chrono::steady_clock::now() - start;
+
+        if(!ok) {
+            close(fd);
+            return false;
+        }
+
+        result.wall = min(result.wall, wall.count());
+        result.peak_rss = max(result.peak_rss, usage.ru_maxrss);
+
+        // Each difference is reported as a pair of lines starting with
+        // the file name in brackets
+        unsigned long lines = 0;
+        FILE*out = fdopen(fd, "r");
+        char buf[65536];
+
+        rewind(out);
+
+        while(fgets(buf, sizeof(buf), out)) {
+            if(buf[0] == '(')
+                ++lines;
+        }
+
+        fclose(out);
+        result.diffs = lines / 2;
+    }
+
+    return true;
+}
+
+// Counts the value changes and the bytes that follow the header
+static void file_stats(const string&path, unsigned long&body_bytes,
+        unsigned long&changes, string&header) {
+    ifstream file(path.c_str());
+    string line;
+    bool in_header = true;
+
+    body_bytes = changes = 0;
+    header.clear();
+
+    while(getline(file, line)) {
+        if(in_header) {
+            header += line + "\n";
+
+            if(line.find("$enddefinitions") != string::npos)
+                in_header = false;
+
+            continue;
+        }
+
+        body_bytes += line.size() + 1;
+
+        if(!line.empty() && strchr("01xzXZbr", line[0]))
+            ++changes;
+    }
+}
+
+static bool generate(const string&vcdgen, const Config&config,
+        const string&path, bool with_diffs) {
+    vector<string> args = split(config.params);
+    args.insert(args.begin(), vcdgen);
+    args.push_back("-o");
+    args.push_back(path);
+
+    if(with_diffs) {
+        args.push_back("-D");
+        args.push_back(config.diffs);
+    }
+
+    struct rusage usage;
+    return run(args, -1, &usage);
+}
+
+static void write_results(const Results&results, FILE*out) {
+    fprintf(out, "{\n");
+
+    for(Results::const_iterator it = results.begin(); it != results.end(); ++it) {
+        fprintf(out, "    \"%s\": %.6g%s\n", it->first.c_str(), it->second.value,
+                next(it) == results.end() ? "" : ",");
+    }
+
+    fprintf(out, "}\n");
+}
+
+// Reads results stored by write_results()
+static bool read_results(const string&path, map<string, double>&results) {
+    ifstream file(path.c_str());
+    string line;
+
+    if(!file.good())
+        return false;
+
+    while(getline(file, line)) {
+        char key[256];
+        double value;
+
+        if(sscanf(line.c_str(), " \"%255[^\"]\": %lf", key, &value) == 2)
+            results[key] = value;
+    }
+
+    return true;
+}
+
+static void usage() {
+    fprintf(stderr, "Usage: bench [options]\n");
+    fprintf(stderr, "--vcdiff <path>\t\tTested binary (default: ./vcdiff).\n");
+    fprintf(stderr, "--vcdgen <path>\t\tGenerator binary (default: bench/vcdgen).\n");
+    fprintf(stderr, "--dir <path>\t\tDirectory for generated files (default: /tmp/vcdiff_bench).\n");
+    fprintf(stderr, "--output <file>\t\tResults file (default: bench/results.json).\n");
+    fprintf(stderr, "--baseline <file>\tBaseline file (default: bench/baseline.json).\n");
+    fprintf(stderr, "--threshold <pct>\tAllowed regression in percent (default: 10).\n");
+    fprintf(stderr, "--repeat <n>\t\tNumber of runs, the fastest one is used (default: 3).\n");
+    fprintf(stderr, "--update-baseline\tStores the results as the new baseline.\n");
+}
+
+int main(int argc, char*argv[]) {
+    string vcdiff = "./vcdiff", vcdgen = "bench/vcdgen", dir = "/tmp/vcdiff_bench";
+    string output = "bench/results.json", baseline = "bench/baseline.json";
+    double threshold = 10.0;
+    unsigned int repeats = 3;
+    bool update_baseline = false;
+
+    static const struct option options[] = {
+        { "vcdiff",          required_argument, NULL, 'v' },
+        { "vcdgen",          required_argument, NULL, 'g' },
+        { "dir",             required_argument, NULL, 'd' },
+        { "output",          required_argument, NULL, 'o' },
+        { "baseline",        required_argument, NULL, 'b' },
+        { "threshold",       required_argument, NULL, 't' },
+        { "repeat",          required_argument, NULL, 'r' },
+        { "update-baseline", no_argument,       NULL, 'u' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int opt;
+
+    while((opt = getopt_long(argc, argv, "h", options, NULL)) != -1) {
+        switch(opt) {
+            case 'v': vcdiff = optarg; break;
+            case 'g': vcdgen = optarg; break;
+            case 'd': dir = optarg; break;
+            case 'o': output = optarg; break;
+            case 'b': baseline = optarg; break;
+            case 't': threshold = atof(optarg); break;
+            case 'r': repeats = max(1, atoi(optarg)); break;
+            case 'u': update_baseline = true; break;
+            default: usage(); return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    mkdir(dir.c_str(), 0755);
+
+    Results results;
+
+    for(const Config*config = configs; config->name; ++config) {
+        string name = config->name;
+        string file1 = dir + "/" + name + "_1.vcd";
+        string file2 = dir + "/" + name + "_2.vcd";
+        string header_file = dir + "/" + name + "_header.vcd";
+
+        printf("Generating '%s' files...\n", config->name);
+        fflush(stdout);
+
+        if(!generate(vcdgen, *config, file1, false)
+                || !generate(vcdgen, *config, file2, true)) {
+            fprintf(stderr, "Error: could not generate files using %s\n", vcdgen.c_str());
+            return 1;
+        }
+
+        unsigned long body_bytes, changes;
+        string header;
+        file_stats(file1, body_bytes, changes, header);
+        ofstream(header_file.c_str()) << header;
+
+        // Header only, to separate the header parsing time
+        Run header_run, self_run, diff_run;
+
+        if(!measure(vcdiff, header_file, header_file, repeats, header_run)
+                || !measure(vcdiff, file1, file1, repeats, self_run)
+                || !measure(vcdiff, file1, file2, repeats, diff_run)) {
+            fprintf(stderr, "Error: could not run %s\n", vcdiff.c_str());
+            return 1;
+        }
+
+        results[name + ".header_parse_s"] = { header_run.wall / 2, false };
+
+        const pair<const char*, const Run*> cases[] = {
+            { "self", &self_run }, { "diff", &diff_run }
+        };
+
+        for(const auto&c : cases) {
+            string prefix = name + "." + c.first + ".";
+            const Run&run = *c.second;
+
+            // Both files have the same size and number of changes
+            double body_time = max(run.wall - header_run.wall, 1e-6);
+
+            results[prefix + "wall_s"] = { run.wall, false };
+            results[prefix + "body_mb_s"] = { 2 * body_bytes / 1e6 / body_time, true };
+            results[prefix + "changes_s"] = { 2 * changes / body_time, true };
+            results[prefix + "peak_rss_kb"] = { (double) run.peak_rss, false };
+
+            if(run.diffs > 0)
+                results[prefix + "diffs_s"] = { run.diffs / body_time, true };
+        }
+    }
+
+    FILE*out = fopen(output.c_str(), "w");
+
+    if(!out) {
+        fprintf(stderr, "Error: could not write %s\n", output.c_str());
+        return 1;
+    }
+
+    write_results(results, out);
+    fclose(out);
+
+    if(update_baseline) {
+        out = fopen(baseline.c_str(), "w");
+
+        if(!out) {
+            fprintf(stderr, "Error: could not write %s\n", baseline.c_str());
+            return 1;
+        }
+
+        write_results(results, out);
+        fclose(out);
+        printf("Baseline stored in %s\n", baseline.c_str());
+        return 0;
+    }
+
+    map<string, double> base;
+
+    if(!read_results(baseline, base)) {
+        fprintf(stderr, "Warning: no baseline in %s, use --update-baseline\n",
+                baseline.c_str());
+        write_results(results, stdout);
+        return 0;
+    }
+
+    // Report changes, positive numbers are improvements
+    bool regression = false;
+
+    printf("%-28s %14s %14s %9s\n", "metric", "baseline", "current", "change");
+
+    for(const auto&entry : results) {
+        map<string, double>::const_iterator it = base.find(entry.first);
+
+        if(it == base.end() || it->second == 0) {
+            printf("%-28s %14s %14.6g\n", entry.first.c_str(), "-", entry.second.value);
+            continue;
+        }
+
+        double change = (entry.second.value - it->second) / it->second * 100.0;
+
+        if(!entry.second.higher_better)
+            change = -change;
+
+        bool failed = change < -threshold;
+        regression |= failed;
+
+        printf("%-28s %14.6g %14.6g %+8.1f%%%s\n", entry.first.c_str(), it->second,
+                entry.second.value, change, failed ? "  REGRESSION" : "");
+    }
+
+    return regression ? 1 : 0;
+}
@@ -0,0 +1,402 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Microbenchmarks for the primitives executed for every value change.
+// Each case reports the time per operation, so the effect of a data layout
+// change can be checked without running the end-to-end benchmark.
+
+#include "link.h"
+#include "scope.h"
+#include "tokenizer.h"
+#include "value.h"
+#include "variable.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <unistd.h>
+
+using namespace std;
+
+// xorshift64*, the same generator as in vcdgen
+class Random {
+public:
+    Random(uint64_t seed) : state_(seed * 2654435761u + 1) {}
+
+    inline uint64_t next() {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 2685821657736338717ull;
+    }
+
+private:
+    uint64_t state_;
+};
+
+// Bus widths measured separately
+static const unsigned int widths[] = { 1, 8, 32, 64, 256 };
+
+// Width distribution of a typical design: mostly single bits and
+// narrow buses, with a few wide ones
+static unsigned int mixed_width(Random&rnd) {
+    unsigned int p = rnd.next() % 100;
+
+    if(p < 50) return 1;
+    if(p < 80) return 8 + rnd.next() % 25;
+    if(p < 95) return 64;
+    return 256;
+}
+
+// Random value, with occasional 'x' and 'z' bits
+static string random_bits(Random&rnd, unsigned int width) {
+    string value(width, '0');
+
+    for(unsigned int i = 0; i < width; ++i) {
+        uint64_t r = rnd.next();
+        value[i] = (r % 64 == 0) ? ((r & 64) ? 'x' : 'z') : ((r & 128) ? '1' : '0');
+    }
+
+    return value;
+}
+
+// Converts a number to a VCD identifier (printable characters '!'..'~')
+static string make_ident(unsigned int num) {
+    string ident;
+
+    do {
+        ident.push_back('!' + num % 94);
+        num /= 94;
+    } while(num > 0);
+
+    return ident;
+}
+
+// Prevents the compiler from removing the measured code
+static volatile size_t sink;
+
+// Minimal measurement time per case (seconds)
+static double min_time = 0.2;
+
+// Only cases containing this string are executed
+static const char*filter = NULL;
+
+/**
+ * @brief Runs a case until it takes at least min_time and prints the time
+ * per operation.
+ * @param ops is the number of operations performed by a single call.
+ * @param func is the measured function, it returns a value that is passed
+ * to the sink.
+ */
+static void measure(const string&name, unsigned long ops,
+        const function<size_t()>&func) {
+    if(filter && name.find(filter) == string::npos)
+        return;
+
+    typedef chrono::steady_clock clock;
+    unsigned long calls = 0;
+    chrono::duration<double> elapsed(0);
+
+    // Warm up caches and allocators
+    sink = sink + func();
+
+    while(elapsed.count() < min_time) {
+        clock::time_point start = clock::now();
+        sink = sink + func();
+        elapsed += clock::now() - start;
+        ++calls;
+    }
+
+    double ns = elapsed.count() * 1e9 / (calls * ops);
+    printf("%-32s %12.2f ns/op %12.2f Mop/s\n", name.c_str(), ns, 1e3 / ns);
+    fflush(stdout);
+}
+
+static void bench_tokenizer(Random&rnd) {
+    // Files made of value changes for each width and the mix
+    for(int i = 0; i <= (int)(sizeof(widths) / sizeof(widths[0])); ++i) {
+        bool mix = (i == sizeof(widths) / sizeof(widths[0]));
+        string name = "tokenizer.get/" + (mix ? string("mix") : to_string(widths[i]));
+        const unsigned int LINES = 20000;
+
+        char path[] = "/tmp/vcdiff_microbench.XXXXXX";
+        int fd = mkstemp(path);
+
+        if(fd < 0) {
+            fprintf(stderr, "Error: could not create a temporary file\n");
+            return;
+        }
+
+        FILE*out = fdopen(fd, "w");
+        unsigned long tokens = 0;
+
+        for(unsigned int l = 0; l < LINES; ++l) {
+            if(l % 10 == 0) {
+                fprintf(out, "#%u\n", l * 10);
+                ++tokens;
+            }
+
+            unsigned int width = mix ? mixed_width(rnd) : widths[i];
+            string ident = make_ident(rnd.next() % 10000);
+
+            if(width == 1) {
+                fprintf(out, "%s%s\n", random_bits(rnd, 1).c_str(), ident.c_str());
+                ++tokens;
+            } else {
+                fprintf(out, "b%s %s\n", random_bits(rnd, width).c_str(), ident.c_str());
+                tokens += 2;
+            }
+        }
+
+        fclose(out);
+
+        measure(name, tokens, [&]() {
+            Tokenizer tokenizer(path);
+            char*token;
+            size_t res = 0;
+
+            while(tokenizer.get(token) > 0)
+                res += token[0];
+
+            return res;
+        });
+
+        unlink(path);
+    }
+}
+
+static void bench_value(Random&rnd) {
+    const unsigned int COUNT = 1024;
+
+    for(unsigned int width : widths) {
+        string suffix = "/" + to_string(width);
+        vector<string> strings;
+        vector<Value> values;
+
+        for(unsigned int i = 0; i < COUNT; ++i) {
+            strings.push_back(random_bits(rnd, width));
+
+            if(width == 1)
+                values.push_back(Value(strings.back()[0]));
+            else
+                values.push_back(Value(strings.back()));
+        }
+
+        // The same way as VcdFile creates values
+        measure("value.construct" + suffix, COUNT, [&]() {
+            size_t res = 0;
+
+            for(const string&str : strings) {
+                if(width == 1) {
+                    Value value(str[0]);
+                    res += value.size;
+                } else {
+                    Value value(str);
+                    res += value.size;
+                }
+            }
+
+            return res;
+        });
+
+        measure("value.assign" + suffix, COUNT, [&]() {
+            // Same size, so the assignment reuses the buffer
+            Value target(values.back());
+
+            for(const Value&value : values)
+                target = value;
+
+            return (size_t) target.size;
+        });
+
+        measure("value.hash" + suffix, COUNT, [&]() {
+            size_t res = 0;
+
+            for(const Value&value : values)
+                res += value.hash();
+
+            return res;
+        });
+    }
+}
+
+// Creates a variable of the requested width, either a scalar or a vector
+static Variable*make_variable(unsigned int width, const string&ident) {
+    if(width == 1)
+        return new Scalar(Variable::WIRE, Value::BIT, "s", ident);
+
+    Vector*vec = new Vector(Variable::WIRE, width - 1, 0, "v", ident);
+    vec->fill();
+
+    return vec;
+}
+
+static vector<Value> make_values(Random&rnd, unsigned int width, unsigned int count) {
+    vector<Value> values;
+
+    for(unsigned int i = 0; i < count; ++i) {
+        string bits = random_bits(rnd, width);
+        values.push_back(width == 1 ? Value(bits[0]) : Value(bits));
+    }
+
+    return values;
+}
+
+static void bench_variable(Random&rnd) {
+    const unsigned int COUNT = 256;
+
+    for(unsigned int width : widths) {
+        string suffix = "/" + to_string(width);
+        vector<Value> values = make_values(rnd, width, COUNT);
+        Variable*var1 = make_variable(width, "!");
+        Variable*var2 = make_variable(width, "\"");
+
+        if(width > 1) {
+            measure("vector.set_value" + suffix, COUNT, [&]() {
+                for(const Value&value : values)
+                    var1->set_value(value);
+
+                return var1->hash();
+            });
+        }
+
+        measure("variable.hash" + suffix, COUNT, [&]() {
+            size_t res = 0;
+
+            for(const Value&value : values) {
+                var1->set_value(value);
+                res += var1->hash();
+            }
+
+            return res;
+        });
+
+        // Both variables get the same values, so the comparison checks
+        // both current and previous values
+        Link link(var1, var2);
+
+        measure("link.compare" + suffix, COUNT, [&]() {
+            size_t res = 0;
+
+            for(const Value&value : values) {
+                var1->set_value(value);
+                var2->set_value(value);
+                res += link.compare();
+                var1->clear_transition();
+                var2->clear_transition();
+            }
+
+            return res;
+        });
+
+        delete var1;
+        delete var2;
+    }
+}
+
+static void bench_idents(Random&rnd) {
+    const unsigned int LOOKUPS = 4096;
+
+    for(unsigned int count : { 1000, 100000 }) {
+        VarStringMap idents;
+        vector<Variable*> vars;
+
+        for(unsigned int i = 0; i < count; ++i) {
+            string ident = make_ident(i);
+            vars.push_back(new Scalar(Variable::WIRE, Value::BIT, "s", ident));
+            idents[ident] = vars.back();
+        }
+
+        // Identifiers in random order, as they appear in value changes
+        vector<string> queries;
+
+        for(unsigned int i = 0; i < LOOKUPS; ++i)
+            queries.push_back(make_ident(rnd.next() % count));
+
+        measure("idents.find/" + to_string(count), LOOKUPS, [&]() {
+            size_t res = 0;
+
+            for(const string&ident : queries)
+                res += (size_t) idents.find(ident)->second;
+
+            return res;
+        });
+
+        for(Variable*var : vars)
+            delete var;
+    }
+}
+
+static void bench_scope(Random&rnd) {
+    for(unsigned int count : { 100, 10000 }) {
+        // Names are added in the file order, which is not sorted
+        vector<string> names;
+
+        for(unsigned int i = 0; i < count; ++i)
+            names.push_back("sig_" + to_string(rnd.next() % 1000000) + "_" + to_string(i));
+
+        measure("scope.add_variable/" + to_string(count), count, [&]() {
+            Scope scope(Scope::MODULE, "top", NULL);
+
+            for(const string&name : names)
+                scope.add_variable(new Scalar(Variable::WIRE, Value::BIT, name, "!"));
+
+            scope.freeze();
+            return scope.variables().size();
+        });
+    }
+}
+
+static void usage() {
+    fprintf(stderr, "Usage: microbench [options] [filter]\n");
+    fprintf(stderr, "-t <seconds>\tMinimal measurement time per case (default: 0.2).\n");
+    fprintf(stderr, "-S <seed>\tRandom generator seed (default: 1).\n");
+    fprintf(stderr, "filter\t\tRuns only cases containing the string (e.g. value.assign/256).\n");
+}
+
+int main(int argc, char*argv[]) {
+    uint64_t seed = 1;
+    int opt;
+
+    while((opt = getopt(argc, argv, "t:S:h")) != -1) {
+        switch(opt) {
+            case 't': min_time = atof(optarg); break;
+            case 'S': seed = strtoull(optarg, NULL, 10); break;
+            default: usage(); return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if(optind < argc)
+        filter = argv[optind];
+
+    Random rnd(seed);
+
+    bench_tokenizer(rnd);
+    bench_value(rnd);
+    bench_variable(rnd);
+    bench_idents(rnd);
+    bench_scope(rnd);
+
+    return 0;
+}
@@ -0,0 +1,309 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Synthetic VCD generator for benchmarks. The output depends only on
+// the parameters, so two files generated with the same seed are identical,
+// apart from the injected differences.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+#include <unistd.h>
+
+using namespace std;
+
+// xorshift64*, used instead of <random> distributions, as their results
+// are implementation specific
+class Random {
+public:
+    Random(uint64_t seed) : state_(seed * 2654435761u + 1) {}
+
+    inline uint64_t next() {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        return state_ * 2685821657736338717ull;
+    }
+
+    // Returns true with the given probability
+    inline bool chance(double probability) {
+        return (next() >> 11) * (1.0 / 9007199254740992.0) < probability;
+    }
+
+    inline unsigned int range(unsigned int min, unsigned int max) {
+        return min + next() % (max - min + 1);
+    }
+
+private:
+    uint64_t state_;
+};
+
+struct Signal {
+    string scope;
+    string name;
+    string ident;
+    unsigned int width;
+
+    // Index of the aliased signal, -1 if it is not an alias
+    int alias;
+
+    string value;
+};
+
+static void usage() {
+    fprintf(stderr, "Usage: vcdgen [options]\n");
+    fprintf(stderr, "-n <count>\tNumber of signals (default: 1000).\n");
+    fprintf(stderr, "-d <depth>\tScope hierarchy depth (default: 2).\n");
+    fprintf(stderr, "-w <width>\tMaximal bus width (default: 32).\n");
+    fprintf(stderr, "-t <rate>\tProbability of a signal change per step (default: 0.1).\n");
+    fprintf(stderr, "-a <ratio>\tRatio of signals that alias another one (default: 0.1).\n");
+    fprintf(stderr, "-s <steps>\tNumber of timestamps (default: 10000).\n");
+    fprintf(stderr, "-S <seed>\tRandom generator seed (default: 1).\n");
+    fprintf(stderr, "-D <list>\tInjected differences: step:signal[,step:signal...].\n");
+    fprintf(stderr, "-o <file>\tOutput file (default: standard output).\n");
+}
+
+// Converts a number to a VCD identifier (printable characters '!'..'~')
+static string make_ident(unsigned int num) {
+    string ident;
+
+    do {
+        ident.push_back('!' + num % 94);
+        num /= 94;
+    } while(num > 0);
+
+    return ident;
+}
+
+static void random_value(Random&rnd, unsigned int width, string&value) {
+    value.resize(width);
+
+    for(unsigned int i = 0; i < width; i += 64) {
+        uint64_t bits = rnd.next();
+
+        for(unsigned int j = i; j < width && j < i + 64; ++j) {
+            value[j] = (bits & 1) ? '1' : '0';
+            bits >>= 1;
+        }
+    }
+}
+
+static void write_value(FILE*out, const Signal&sig, const string&value) {
+    if(sig.width == 1)
+        fprintf(out, "%c%s\n", value[0], sig.ident.c_str());
+    else
+        fprintf(out, "b%s %s\n", value.c_str(), sig.ident.c_str());
+}
+
+int main(int argc, char*argv[]) {
+    unsigned int count = 1000, depth = 2, max_width = 32, steps = 10000;
+    double toggle_rate = 0.1, alias_ratio = 0.1;
+    uint64_t seed = 1;
+    set<pair<unsigned int, unsigned int> > diffs;   // (step, signal)
+    const char*output = NULL;
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:d:w:t:a:s:S:D:o:h")) != -1) {
+        switch(opt) {
+            case 'n': count = atoi(optarg); break;
+            case 'd': depth = atoi(optarg); break;
+            case 'w': max_width = atoi(optarg); break;
+            case 't': toggle_rate = atof(optarg); break;
+            case 'a': alias_ratio = atof(optarg); break;
+            case 's': steps = atoi(optarg); break;
+            case 'S': seed = strtoull(optarg, NULL, 10); break;
+            case 'o': output = optarg; break;
+
+            case 'D':
+                for(char*entry = strtok(optarg, ","); entry; entry = strtok(NULL, ",")) {
+                    unsigned int step, signal;
+
+                    if(sscanf(entry, "%u:%u", &step, &signal) != 2) {
+                        fprintf(stderr, "Error: invalid difference: %s\n", entry);
+                        return 1;
+                    }
+
+                    diffs.insert(make_pair(step, signal));
+                }
+                break;
+
+            default:
+                usage();
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if(count == 0 || max_width == 0) {
+        usage();
+        return 1;
+    }
+
+    FILE*out = output ? fopen(output, "w") : stdout;
+
+    if(!out) {
+        fprintf(stderr, "Error: could not open %s\n", output);
+        return 1;
+    }
+
+    // Declarations
+    Random rnd(seed);
+    vector<Signal> signals(count);
+    unsigned int idents = 0;
+
+    for(unsigned int i = 0; i < count; ++i) {
+        Signal&sig = signals[i];
+
+        // Distribute signals in a tree with 4 branches per scope
+        unsigned int path = i;
+
+        for(unsigned int level = 0; level < depth; ++level) {
+            sig.scope += "u" + to_string(path % 4) + " ";
+            path /= 4;
+        }
+
+        sig.name = "s" + to_string(i);
+        sig.alias = -1;
+
+        if(i > 0 && rnd.chance(alias_ratio)) {
+            sig.alias = rnd.range(0, i - 1);
+
+            // Follow the chain to the original signal
+            while(signals[sig.alias].alias >= 0)
+                sig.alias = signals[sig.alias].alias;
+
+            sig.width = signals[sig.alias].width;
+            sig.ident = signals[sig.alias].ident;
+        } else {
+            sig.width = (max_width == 1 || rnd.chance(0.5)) ? 1 : rnd.range(2, max_width);
+            sig.ident = make_ident(idents++);
+            random_value(rnd, sig.width, sig.value);
+        }
+    }
+
+    fprintf(out, "$date\n    today\n$end\n");
+    fprintf(out, "$version\n    vcdgen\n$end\n");
+    fprintf(out, "$timescale 1ns $end\n");
+    fprintf(out, "$scope module top $end\n");
+
+    // Signals are sorted by scope, so the hierarchy is emitted in order
+    vector<unsigned int> order(count);
+
+    for(unsigned int i = 0; i < count; ++i)
+        order[i] = i;
+
+    stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+        return signals[a].scope < signals[b].scope;
+    });
+
+    vector<string> cur_scope;
+
+    for(unsigned int idx : order) {
+        const Signal&sig = signals[idx];
+        vector<string> scope;
+
+        for(size_t pos = 0; pos < sig.scope.size(); ) {
+            size_t end = sig.scope.find(' ', pos);
+            scope.push_back(sig.scope.substr(pos, end - pos));
+            pos = end + 1;
+        }
+
+        size_t common = 0;
+
+        while(common < scope.size() && common < cur_scope.size()
+                && scope[common] == cur_scope[common])
+            ++common;
+
+        for(size_t i = common; i < cur_scope.size(); ++i)
+            fprintf(out, "$upscope $end\n");
+
+        for(size_t i = common; i < scope.size(); ++i)
+            fprintf(out, "$scope module %s $end\n", scope[i].c_str());
+
+        cur_scope = scope;
+
+        if(sig.width == 1) {
+            fprintf(out, "$var wire 1 %s %s $end\n", sig.ident.c_str(), sig.name.c_str());
+        } else {
+            fprintf(out, "$var wire %u %s %s [%u:0] $end\n", sig.width,
+                    sig.ident.c_str(), sig.name.c_str(), sig.width - 1);
+        }
+    }
+
+    for(size_t i = 0; i < cur_scope.size(); ++i)
+        fprintf(out, "$upscope $end\n");
+
+    fprintf(out, "$upscope $end\n");
+    fprintf(out, "$enddefinitions $end\n");
+
+    // Initial values
+    fprintf(out, "#0\n$dumpvars\n");
+
+    for(const Signal&sig : signals) {
+        if(sig.alias < 0)
+            write_value(out, sig, sig.value);
+    }
+
+    fprintf(out, "$end\n");
+
+    // Value changes
+    vector<unsigned int> reverts;
+    string value;
+
+    for(unsigned int step = 1; step <= steps; ++step) {
+        fprintf(out, "#%u\n", step * 10);
+        vector<unsigned int> injected;
+
+        for(unsigned int i = 0; i < count; ++i) {
+            Signal&sig = signals[i];
+
+            if(sig.alias >= 0)
+                continue;
+
+            bool toggle = rnd.chance(toggle_rate);
+
+            if(toggle)
+                random_value(rnd, sig.width, sig.value);
+
+            if(diffs.count(make_pair(step, i))) {
+                // Invert the first bit, without affecting the next values
+                value = sig.value;
+                value[0] = (value[0] == '1') ? '0' : '1';
+                write_value(out, sig, value);
+                injected.push_back(i);
+
+            } else if(toggle || binary_search(reverts.begin(), reverts.end(), i)) {
+                // Injected differences last for a single step
+                write_value(out, sig, sig.value);
+            }
+        }
+
+        reverts.swap(injected);
+    }
+
+    if(out != stdout)
+        fclose(out);
+
+    return 0;
+}
@@ -0,0 +1,462 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "columns.h"
+#include "history.h"
+#include "link.h"
+#include "options.h"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace std;
+
+Column::Column()
+    : offsets_(1, 0) {
+}
+
+void Column::append(unsigned long time, const string&value) {
+    times_.push_back(time);
+    data_.append(value);
+    offsets_.push_back(data_.size());
+}
+
+void Column::append(const Column&other) {
+    for(unsigned int i = 0; i < other.size(); ++i) {
+        times_.push_back(other.times_[i]);
+        offsets_.push_back(data_.size() + other.offsets_[i + 1]);
+    }
+
+    data_.append(other.data_);
+}
+
+void Column::clear() {
+    vector<unsigned long>().swap(times_);
+    vector<uint64_t>(1, 0).swap(offsets_);
+    string().swap(data_);
+}
+
+// Writes a memory block to a file, handling partial writes
+static bool write_all(int fd, const void*data, size_t size) {
+    const char*ptr = static_cast<const char*>(data);
+
+    while(size > 0) {
+        ssize_t res = ::write(fd, ptr, size);
+
+        if(res <= 0)
+            return false;
+
+        ptr += res;
+        size -= res;
+    }
+
+    return true;
+}
+
+// Reads a memory block from a specific file offset
+static bool read_all(int fd, void*data, size_t size, uint64_t offset) {
+    char*ptr = static_cast<char*>(data);
+
+    while(size > 0) {
+        ssize_t res = ::pread(fd, ptr, size, offset);
+
+        if(res <= 0)
+            return false;
+
+        ptr += res;
+        size -= res;
+        offset += res;
+    }
+
+    return true;
+}
+
+long Column::write(int fd) const {
+    // Store lengths of the values instead of offsets
+    vector<unsigned int> lengths(size());
+
+    for(unsigned int i = 0; i < size(); ++i)
+        lengths[i] = offsets_[i + 1] - offsets_[i];
+
+    size_t times_size = times_.size() * sizeof(unsigned long);
+    size_t lengths_size = lengths.size() * sizeof(unsigned int);
+
+    if(!write_all(fd, times_.data(), times_size)
+            || !write_all(fd, lengths.data(), lengths_size)
+            || !write_all(fd, data_.data(), data_.size()))
+        return -1;
+
+    return times_size + lengths_size + data_.size();
+}
+
+bool Column::read(int fd, uint64_t offset, unsigned int count, size_t data_size) {
+    vector<unsigned long> times(count);
+    vector<unsigned int> lengths(count);
+    string data(data_size, 0);
+
+    size_t times_size = count * sizeof(unsigned long);
+    size_t lengths_size = count * sizeof(unsigned int);
+
+    if(!read_all(fd, times.data(), times_size, offset)
+            || !read_all(fd, lengths.data(), lengths_size, offset + times_size)
+            || !read_all(fd, &data[0], data_size, offset + times_size + lengths_size))
+        return false;
+
+    for(unsigned int i = 0; i < count; ++i) {
+        times_.push_back(times[i]);
+        offsets_.push_back(offsets_.back() + lengths[i]);
+    }
+
+    data_.append(data);
+
+    return true;
+}
+
+ColumnStore::ColumnStore(unsigned int columns, unsigned long budget)
+    : columns_(columns), segments_(columns), budget_(budget), usage_(0),
+    fd_(-1), file_size_(0) {
+}
+
+ColumnStore::~ColumnStore() {
+    if(fd_ >= 0)
+        close(fd_);
+}
+
+void ColumnStore::spill_if_needed() {
+    if(budget_ == 0 || usage_ < budget_)
+        return;
+
+    if(!spill()) {
+        cerr << "Warning: Could not write a temporary file, "
+            "value changes are kept in memory." << endl;
+
+        // Do not try again
+        budget_ = 0;
+    }
+}
+
+int open_temp_file() {
+    const char*tmpdir = getenv("TMPDIR");
+    string path = string(tmpdir ? tmpdir : "/tmp") + "/vcdiff.XXXXXX";
+    int fd = mkstemp(&path[0]);
+
+    if(fd >= 0)
+        unlink(path.c_str());
+
+    return fd;
+}
+
+bool ColumnStore::spill() {
+    if(fd_ < 0 && (fd_ = open_temp_file()) < 0)
+        return false;
+
+    if(!timestamps_.empty()) {
+        Segment segment;
+        segment.offset = file_size_;
+        segment.count = timestamps_.size();
+        segment.data_size = 0;
+
+        size_t size = timestamps_.size() * sizeof(unsigned long);
+
+        if(!write_all(fd_, timestamps_.data(), size))
+            return false;
+
+        file_size_ += size;
+        time_segments_.push_back(segment);
+        vector<unsigned long>().swap(timestamps_);
+    }
+
+    for(unsigned int i = 0; i < columns_.size(); ++i) {
+        Column&column = columns_[i];
+
+        if(column.size() == 0)
+            continue;
+
+        Segment segment;
+        segment.offset = file_size_;
+        segment.count = column.size();
+        segment.data_size = column.data_size();
+
+        long written = column.write(fd_);
+
+        if(written < 0)
+            return false;
+
+        file_size_ += written;
+        segments_[i].push_back(segment);
+        column.clear();
+    }
+
+    usage_ = 0;
+
+    return true;
+}
+
+bool ColumnStore::load(unsigned int idx, Column&column) const {
+    column.clear();
+    column.initial = columns_[idx].initial;
+
+    for(const Segment&segment : segments_[idx]) {
+        if(!column.read(fd_, segment.offset, segment.count, segment.data_size))
+            return false;
+    }
+
+    // The most recent changes are still in memory
+    column.append(columns_[idx]);
+
+    return true;
+}
+
+// Number of timestamps read from the temporary file at once
+static const unsigned int TIMESTAMP_CHUNK = 65536;
+
+ColumnStore::TimestampReader::TimestampReader(const ColumnStore&store)
+    : store_(store), pos_(0), segment_(0), segment_pos_(0),
+    memory_read_(false), failed_(false) {
+    load();
+}
+
+void ColumnStore::TimestampReader::next() {
+    if(++pos_ == chunk_.size())
+        load();
+}
+
+void ColumnStore::TimestampReader::load() {
+    chunk_.clear();
+    pos_ = 0;
+
+    if(segment_ < store_.time_segments_.size()) {
+        const Segment&segment = store_.time_segments_[segment_];
+        unsigned int count = min(TIMESTAMP_CHUNK, segment.count - segment_pos_);
+        chunk_.resize(count);
+
+        if(!read_all(store_.fd_, chunk_.data(), count * sizeof(unsigned long),
+                    segment.offset + (uint64_t) segment_pos_ * sizeof(unsigned long))) {
+            chunk_.clear();
+            failed_ = true;
+            return;
+        }
+
+        if((segment_pos_ += count) == segment.count) {
+            ++segment_;
+            segment_pos_ = 0;
+        }
+
+    } else if(!memory_read_) {
+        // The most recent timestamps are still in memory
+        chunk_ = store_.timestamps_;
+        memory_read_ = true;
+    }
+}
+
+DiffStore::DiffStore(unsigned int columns, unsigned long budget)
+    : lists_(columns), budget_(budget), usage_(0), fd_(-1), file_size_(0),
+    failed_(false) {
+}
+
+DiffStore::~DiffStore() {
+    if(fd_ >= 0)
+        close(fd_);
+}
+
+// Fixed size part of a difference stored in the temporary file
+struct DiffHeader {
+    unsigned long time, start;
+    unsigned int lengths[3];
+};
+
+bool DiffStore::spill(List&list, const vector<ColumnDiff>&diffs) {
+    string buffer;
+
+    for(const ColumnDiff&diff : diffs) {
+        DiffHeader header = { diff.time, diff.start, { (unsigned int) diff.value1.size(),
+            (unsigned int) diff.value2.size(), (unsigned int) diff.context.size() } };
+        buffer.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        buffer.append(diff.value1);
+        buffer.append(diff.value2);
+        buffer.append(diff.context);
+    }
+
+    lock_guard<mutex> guard(lock_);
+
+    if(fd_ < 0 && (fd_ = open_temp_file()) < 0)
+        return false;
+
+    if(!write_all(fd_, buffer.data(), buffer.size()))
+        return false;
+
+    list.offset = file_size_;
+    list.spilled = true;
+    file_size_ += buffer.size();
+
+    return true;
+}
+
+void DiffStore::store(unsigned int idx, vector<ColumnDiff>&diffs) {
+    List&list = lists_[idx];
+    unsigned long size = 0;
+
+    list.count = diffs.size();
+
+    for(const ColumnDiff&diff : diffs) {
+        size += sizeof(ColumnDiff) + diff.value1.size() + diff.value2.size()
+            + diff.context.size();
+    }
+
+    {
+        lock_guard<mutex> guard(lock_);
+
+        if(budget_ == 0 || usage_ + size <= budget_) {
+            usage_ += size;
+            list.diffs.swap(diffs);
+            return;
+        }
+    }
+
+    if(!spill(list, diffs)) {
+        lock_guard<mutex> guard(lock_);
+
+        if(budget_ > 0) {
+            cerr << "Warning: Could not write a temporary file, "
+                "differences are kept in memory." << endl;
+
+            // Do not try again
+            budget_ = 0;
+        }
+
+        usage_ += size;
+        list.diffs.swap(diffs);
+        return;
+    }
+
+    vector<ColumnDiff>().swap(diffs);
+}
+
+bool DiffStore::next(unsigned int idx, ColumnDiff&diff) {
+    List&list = lists_[idx];
+
+    if(list.read == list.count)
+        return false;
+
+    ++list.read;
+
+    if(!list.spilled) {
+        diff = list.diffs[list.read - 1];
+        return true;
+    }
+
+    DiffHeader header;
+
+    if(!read_all(fd_, &header, sizeof(header), list.offset)) {
+        failed_ = true;
+        return false;
+    }
+
+    string data(header.lengths[0] + header.lengths[1] + header.lengths[2], 0);
+
+    if(!read_all(fd_, &data[0], data.size(), list.offset + sizeof(header))) {
+        failed_ = true;
+        return false;
+    }
+
+    diff.time = header.time;
+    diff.start = header.start;
+    diff.value1 = data.substr(0, header.lengths[0]);
+    diff.value2 = data.substr(header.lengths[0], header.lengths[1]);
+    diff.context = data.substr(header.lengths[0] + header.lengths[1]);
+    list.offset += sizeof(header) + data.size();
+
+    return true;
+}
+
+unsigned int compare_columns(const Column&col1, const Column&col2,
+        vector<ColumnDiff>&diffs) {
+    const unsigned long NONE = numeric_limits<unsigned long>::max();
+    string cur1 = col1.initial, cur2 = col2.initial;
+    unsigned int i = 0, j = 0, count = 0;
+    unique_ptr<ValueHistory> history(context_depth ? new ValueHistory(context_depth) : NULL);
+    ColumnDiff interval;
+    bool open = false;
+
+    while(i < col1.size() || j < col2.size()) {
+        unsigned long time1 = i < col1.size() ? col1.time(i) : NONE;
+        unsigned long time2 = j < col2.size() ? col2.time(j) : NONE;
+        unsigned long time = min(time1, time2);
+        string prev1 = cur1, prev2 = cur2;
+        ++count;
+
+        // Apply changes from the columns that have an entry for the timestamp
+        if(time1 == time)
+            cur1 = col1.value(i++);
+
+        if(time2 == time)
+            cur2 = col2.value(j++);
+
+        bool equal = (cur1 == cur2 && (compare_states || prev1 == prev2));
+
+        if(intervals_mode) {
+            // Only the changes of the mismatch status are reported
+            if(!equal && !open) {
+                open = true;
+                interval.start = time;
+                interval.value1 = cur1;
+                interval.value2 = cur2;
+
+            } else if(equal && open) {
+                open = false;
+                interval.time = time;
+                diffs.push_back(interval);
+            }
+
+        } else if(!equal) {
+            ColumnDiff diff;
+            diff.time = time;
+            diff.start = time;
+
+            // Summary shows only the first values
+            if(!summary_mode || diffs.empty()) {
+                diff.value1 = Link::value_str(prev1, cur1, prev1 != cur1);
+                diff.value2 = Link::value_str(prev2, cur2, prev2 != cur2);
+            }
+
+            if(history) {
+                stringstream context;
+                history->print(context, 0);
+                diff.context = context.str();
+            }
+
+            diffs.push_back(diff);
+        }
+
+        if(history)
+            history->add(0, time, cur1, cur2);
+    }
+
+    if(open) {
+        interval.time = NONE;
+        diffs.push_back(interval);
+    }
+
+    return count;
+}
@@ -0,0 +1,303 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COLUMNS_H
+#define COLUMNS_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Value changes of a single variable, stored as a list of timestamps
+ * and values packed into a single buffer.
+ */
+class Column {
+public:
+    Column();
+
+    void append(unsigned long time, const std::string&value);
+
+    /**
+     * @brief Appends all changes stored in another column.
+     */
+    void append(const Column&other);
+
+    /**
+     * @brief Removes all changes and releases the memory.
+     */
+    void clear();
+
+    inline unsigned int size() const {
+        return times_.size();
+    }
+
+    inline unsigned long time(unsigned int idx) const {
+        return times_[idx];
+    }
+
+    inline std::string value(unsigned int idx) const {
+        return data_.substr(offsets_[idx], offsets_[idx + 1] - offsets_[idx]);
+    }
+
+    /**
+     * @brief Writes the changes to a file.
+     * @return Number of written bytes or -1 in case of error.
+     */
+    long write(int fd) const;
+
+    /**
+     * @brief Appends changes stored by write() at a specific file offset.
+     */
+    bool read(int fd, uint64_t offset, unsigned int count, size_t data_size);
+
+    inline size_t data_size() const {
+        return data_.size();
+    }
+
+    ///> Value assigned before the first change
+    std::string initial;
+
+private:
+    std::vector<unsigned long> times_;
+
+    // offsets_[i] is the beginning of i-th value, the last one marks the end
+    std::vector<uint64_t> offsets_;
+
+    std::string data_;
+};
+
+/**
+ * @brief Set of columns, one per Link. When the stored changes exceed
+ * the memory budget, they are moved to a temporary file as a run of
+ * columns, together with the timestamps. Runs are written in time order,
+ * so a complete column is restored by concatenating its parts from all runs.
+ */
+class ColumnStore {
+public:
+    /**
+     * @param budget is the memory limit (in bytes) for the stored changes,
+     * 0 means no limit.
+     */
+    ColumnStore(unsigned int columns, unsigned long budget = 0);
+    ~ColumnStore();
+
+    inline void append(unsigned int idx, unsigned long time,
+            const std::string&value) {
+        columns_[idx].append(time, value);
+        usage_ += sizeof(unsigned long) + sizeof(uint64_t) + value.size();
+    }
+
+    ///> Adds a timestamp found in the file
+    inline void add_timestamp(unsigned long time) {
+        timestamps_.push_back(time);
+        usage_ += sizeof(unsigned long);
+    }
+
+    /**
+     * @brief Sets the value assigned to a variable before the first change.
+     */
+    inline void set_initial(unsigned int idx, const std::string&value) {
+        columns_[idx].initial = value;
+    }
+
+    /**
+     * @brief Moves the stored changes to a temporary file, if they exceed
+     * the memory budget.
+     */
+    void spill_if_needed();
+
+    /**
+     * @brief Loads a complete column, including the parts that have been
+     * moved to the temporary file. It is safe to call it from multiple
+     * threads.
+     */
+    bool load(unsigned int idx, Column&column) const;
+
+    inline unsigned int size() const {
+        return columns_.size();
+    }
+
+    /**
+     * @brief Reads the timestamps found in the file in order, including
+     * the ones moved to the temporary file.
+     */
+    class TimestampReader {
+    public:
+        TimestampReader(const ColumnStore&store);
+
+        inline bool valid() const {
+            return pos_ < chunk_.size();
+        }
+
+        inline unsigned long time() const {
+            return chunk_[pos_];
+        }
+
+        void next();
+
+        ///> Set if the temporary file could not be read
+        inline bool failed() const {
+            return failed_;
+        }
+
+    private:
+        // Loads the next part of timestamps
+        void load();
+
+        const ColumnStore&store_;
+        std::vector<unsigned long> chunk_;
+        unsigned int pos_;
+
+        // Next segment to be read and the number of its timestamps read so far
+        unsigned int segment_;
+        unsigned int segment_pos_;
+
+        bool memory_read_, failed_;
+    };
+
+private:
+    ///> Part of a column stored in the temporary file
+    struct Segment {
+        uint64_t offset;
+        unsigned int count;
+        size_t data_size;
+    };
+
+    bool spill();
+
+    std::vector<Column> columns_;
+
+    // Column parts moved to the temporary file, in the order of runs
+    std::vector<std::vector<Segment> > segments_;
+
+    // Timestamps that are still in memory and the ones in the temporary file
+    std::vector<unsigned long> timestamps_;
+    std::vector<Segment> time_segments_;
+
+    // Memory budget and estimated memory used by the stored changes
+    unsigned long budget_, usage_;
+
+    // Temporary file descriptor (-1 if there is none) and its size
+    int fd_;
+    uint64_t file_size_;
+};
+
+///> Difference found by comparing a pair of columns
+struct ColumnDiff {
+    unsigned long time;
+
+    // With --intervals: beginning of the mismatch interval that ends at time
+    // (ULONG_MAX if it lasts until the end), values are the first differing ones
+    unsigned long start;
+
+    // Values formatted as in the regular output (see Link::value_str())
+    std::string value1, value2;
+
+    // Preceding values printed with the difference (--context)
+    std::string context;
+};
+
+/**
+ * @brief Differences found for each column. When they exceed the memory
+ * budget, the lists stored afterwards are moved to a temporary file and read
+ * back one difference at a time, so merging them needs little memory.
+ */
+class DiffStore {
+public:
+    /**
+     * @param budget is the memory limit (in bytes) for the stored
+     * differences, 0 means no limit.
+     */
+    DiffStore(unsigned int columns, unsigned long budget = 0);
+    ~DiffStore();
+
+    /**
+     * @brief Takes over the differences of a column. It is safe to call it
+     * from multiple threads for different columns.
+     */
+    void store(unsigned int idx, std::vector<ColumnDiff>&diffs);
+
+    inline unsigned int size() const {
+        return lists_.size();
+    }
+
+    ///> Number of differences stored for a column
+    inline unsigned int count(unsigned int idx) const {
+        return lists_[idx].count;
+    }
+
+    /**
+     * @brief Reads the next difference of a column.
+     * @return false if there are no more differences or the temporary file
+     * could not be read (see failed()).
+     */
+    bool next(unsigned int idx, ColumnDiff&diff);
+
+    ///> Set if the temporary file could not be read
+    inline bool failed() const {
+        return failed_;
+    }
+
+private:
+    struct List {
+        List() : offset(0), count(0), read(0), spilled(false) {}
+
+        // Differences kept in memory
+        std::vector<ColumnDiff> diffs;
+
+        // Position of the next difference in the temporary file
+        uint64_t offset;
+
+        unsigned int count, read;
+        bool spilled;
+    };
+
+    // Writes a list to the temporary file
+    bool spill(List&list, const std::vector<ColumnDiff>&diffs);
+
+    std::vector<List> lists_;
+
+    // Guards the memory usage and the temporary file while storing
+    std::mutex lock_;
+
+    unsigned long budget_, usage_;
+
+    int fd_;
+    uint64_t file_size_;
+    bool failed_;
+};
+
+/**
+ * @brief Compares two columns, walking through the change times of both.
+ * @param diffs is the list where the found differences (or mismatch intervals
+ * with --intervals) are appended, sorted by time.
+ * @return Number of compared timestamps.
+ */
+unsigned int compare_columns(const Column&col1, const Column&col2,
+        std::vector<ColumnDiff>&diffs);
+
+/**
+ * @brief Creates a temporary file in $TMPDIR (or /tmp), it is removed as soon
+ * as it is closed.
+ * @return File descriptor or -1 on failure.
+ */
+int open_temp_file();
+
+#endif /* COLUMNS_H */
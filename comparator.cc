@@ -17,19 +17,93 @@
  */
 
 #include "comparator.h"
+#include "columns.h"
+#include "diffdb.h"
+#include "digest.h"
+#include "fuzzy.h"
+#include "history.h"
 #include "link.h"
-#include "vcdfile.h"
+#include "mapcache.h"
+#include "memusage.h"
+#include "namemap.h"
+#include "output.h"
+#include "wavefile.h"
 #include "options.h"
+#include "progress.h"
+#include "trace.h"
 #include "debug.h"
 
+#include <algorithm>
+#include <atomic>
 #include <limits>
+#include <queue>
+#include <sstream>
+#include <thread>
+
+#include <malloc.h>
 
 // TODO adapt timescales if they are different
 
 using namespace std;
 
-Comparator::Comparator(VcdFile&file1, VcdFile&file2)
-    : file1_(file1), file2_(file2) {
+// Returns the variable type as used in VCD files
+static const char*type_name(Variable::var_type_t type) {
+    static const char*names[] = {
+        "event", "integer", "parameter", "real", "reg", "supply0", "supply1",
+        "time", "tri", "tri0", "tri1", "triand", "trior", "trireg", "wand",
+        "wire", "wor", "unknown"
+    };
+
+    return names[type];
+}
+
+static string range_str(const Vector&vec) {
+    return "[" + to_string(vec.left_idx()) + ":" + to_string(vec.right_idx()) + "]";
+}
+
+// Strips the root scope, named after the file
+static string relative_name(const string&name, const WaveFile&file) {
+    const string&root = file.root_scope().full_name();
+
+    if(name.compare(0, root.size() + 1, root + ".") == 0)
+        return name.substr(root.size() + 1);
+
+    return name;
+}
+
+static string relative_name(const Variable&var, const WaveFile&file) {
+    stringstream name;
+    name << var;
+    return relative_name(name.str(), file);
+}
+
+// Variable name with the scope hierarchy, without the root scope and range
+static string hierarchy_name(const Variable&var, const WaveFile&file) {
+    const Scope*root = &file.root_scope();
+    string name = var.name();
+
+    for(const Scope*scope = var.scope(); scope && scope != root; scope = scope->parent())
+        name = scope->name() + "." + name;
+
+    return name;
+}
+
+// Aliases to vectors share the elements with their targets
+static Vector*vector_of(Variable*var) {
+    if(Alias*alias = dynamic_cast<Alias*>(var))
+        var = alias->target();
+
+    return static_cast<Vector*>(var);
+}
+
+Comparator::Comparator(WaveFile&file1, WaveFile&file2)
+    : file1_(file1), file2_(file2), dropped_unlinked_(false), quiet_mapping_(false),
+    structure_differs_(false), map_cache_(NULL) {
+    if(context_depth && !test_mode)
+        history_.reset(new ValueHistory(context_depth));
+
+    if(db_file && !test_mode)
+        db_.reset(new DiffDbWriter);
 }
 
 Comparator::~Comparator() {
@@ -50,138 +124,483 @@ int Comparator::compare() {
         return 1;
     }
 
-    if(!file1_.parse_header() || !file2_.parse_header()) {
-        return 2;
+    if(digest_bucket)
+        return compare_digests();
+
+    if(map_file) {
+        NameMapping*mapping = new NameMapping;
+        name_mapping_.reset(mapping);
+
+        if(!mapping->load(map_file))
+            return 1;
+    }
+
+    if(structure_mode)
+        return compare_structure();
+
+    {
+        PhaseTimer timer(stats_.header, true);
+        TraceScope trace("parse_header", "\"file\":1");
+
+        if(!file1_.parse_header()) {
+            return 2;
+        }
+
+        trace.restart("parse_header", "\"file\":2");
+
+        if(!file2_.parse_header()) {
+            return 2;
+        }
     }
 
     if(file1_.timescale() != file2_.timescale()) {
         cerr << "Warning: Compared files use different timescales." << endl;
     }
 
-    map_signals(file1_.root_scope(), file2_.root_scope());
-    check_value_changes();
+    {
+        PhaseTimer timer(stats_.mapping, true);
+        TRACE_SCOPE("map_signals");
+
+        if(map_cache_dir)
+            map_signals_cached();
+        else
+            map_signals(file1_.root_scope(), file2_.root_scope());
+    }
+
+    if(mem_limit && !enforce_mem_limit())
+        return 3;
+
+    {
+        PhaseTimer timer(stats_.comparison, true);
+        TRACE_SCOPE("compare");
+
+        if(test_mode) {
+            check_value_changes(file1_.valid(), file2_.valid(),
+                    numeric_limits<unsigned long>::max(), cout, cerr, false);
+        } else if(columnar_mode) {
+            check_value_changes_columnar();
+        } else if(!partitioned_mode || threads < 2
+                // Intervals and the context span the window boundaries
+                || intervals_mode || history_
+                || !check_value_changes_partitioned()) {
+            check_value_changes(file1_.valid(), file2_.valid(),
+                    numeric_limits<unsigned long>::max(), cout, cerr, threads > 1);
+        }
+    }
+
+    if(db_ && !db_->save(db_file, links_, file1_, file2_)) {
+        cerr << "Error: Could not write file " << db_file << "." << endl;
+        return 1;
+    }
+
+    if(summary_mode && !test_mode)
+        print_summary(cout, links_, link_summary_);
+
+    if(mem_report_count) {
+        cout.flush();
+        print_mem_report(cerr, mem_report_count, file1_, file2_, links_);
+    }
+
+    if(profile_count) {
+        cout.flush();
+        print_profile(cerr, profile_count, file1_, file2_, links_, link_profile_);
+    }
+
+    if(stats_mode) {
+        Stats stats;
+        collect_stats(stats);
+        cout.flush();
+        print_stats(cerr, stats);
+    }
 
     return 0;
 }
 
+void Comparator::collect_stats(Stats&stats) const {
+    stats = stats_;
+    file1_.collect_stats(stats);
+    file2_.collect_stats(stats);
+
+    stats.links = links_.size();
+    stats.aliases = file1_.aliases() + file2_.aliases();
+}
+
+void Comparator::ScopeMatch::add(MatchAction::type_t type, unsigned int file,
+        unsigned int index, Scope*scope, Variable*var1, Variable*var2) {
+    MatchAction action;
+    action.type = type;
+    action.file = file;
+    action.index = index;
+    action.scope = scope;
+    action.var1 = var1;
+    action.var2 = var2;
+    actions.push_back(action);
+}
+
 void Comparator::map_signals(Scope&scope1, Scope&scope2) {
-    // Go through the scope hierarchy,
-    // trying to match signals in each subscope.
-    ScopeStringMap::iterator scope_it1 = scope1.scopes().begin();
-    ScopeStringMap::iterator scope_it2 = scope2.scopes().begin();
+    vector<ScopeMatch> matches;
+    map_scopes(scope1, scope2, matches);
+    unsigned int scope_pairs = matches.size();
+
+    // Listed pairs are matched first, so they are skipped later
+    if(name_mapping_) {
+        matches.push_back(ScopeMatch(&scope1, &scope2));
+        map_listed(scope1, scope2, matches.back());
+    }
+
+    // Scope pairs are independent, so their variables are matched in parallel
+    unsigned int workers_count = min(threads, scope_pairs);
+
+    if(workers_count > 1) {
+        atomic<unsigned int> next_match(0);
+        vector<thread> workers;
+
+        for(unsigned int i = 0; i < workers_count; ++i) {
+            workers.push_back(thread([&, i]() {
+                trace_thread_name("mapper " + to_string(i + 1));
+                TRACE_SCOPE("map_variables");
+                unsigned int idx;
+
+                while((idx = next_match++) < scope_pairs)
+                    map_variables(matches[idx]);
+            }));
+        }
+
+        for(thread&worker : workers)
+            worker.join();
+
+    } else {
+        for(unsigned int i = 0; i < scope_pairs; ++i)
+            map_variables(matches[i]);
+    }
+
+    if(name_mapping_)
+        apply_match(matches, scope_pairs, NULL);
+
+    // Variables that do not occur in the other file are reported after
+    // trying to match them by similar names
+    vector<Unmatched> missing;
+    apply_match(matches, 0, fuzzy_match ? &missing : NULL);
+
+    if(fuzzy_match) {
+        TRACE_SCOPE("map_similar");
+        matches.push_back(ScopeMatch(&scope1, &scope2));
+        map_similar(missing, matches.back());
+        apply_match(matches, matches.size() - 1, NULL);
+    }
+}
+
+unsigned int Comparator::map_scopes(Scope&scope1, Scope&scope2,
+        vector<ScopeMatch>&matches) {
+    // Go through the scope hierarchy, collecting pairs of matching scopes.
+    // The list grows while subscopes are visited, so it is accessed by index.
+    unsigned int index = matches.size();
+    ScopeList::iterator scope_it1 = scope1.scopes().begin();
+    ScopeList::iterator scope_it2 = scope2.scopes().begin();
 
     DBG("mapping %s <-> %s", scope1.full_name().c_str(),
             scope2.full_name().c_str());
 
+    matches.push_back(ScopeMatch(&scope1, &scope2));
+
     while(scope_it1 != scope1.scopes().end()
             && scope_it2 != scope2.scopes().end()) {
         // Check if the current scope names match
-        int comp_name = scope_it1->first.compare(scope_it2->first);
+        int comp_name = compare_names(scope_it1->first, scope_it2->first);
 
         if(comp_name == 0) {
             // Subscope names match, go deeper
-            map_signals(*scope_it1->second, *scope_it2->second);
+            unsigned int subscope = map_scopes(*scope_it1->second,
+                    *scope_it2->second, matches);
+            matches[index].add(MatchAction::SUBSCOPE, 0, subscope, NULL, NULL, NULL);
             ++scope_it1;
             ++scope_it2;
 
         } else if(comp_name < 0) {
-            if(warn_missing_scopes) {
-                cerr << "Warning: There is no scope '"
-                    << scope_it1->second->full_name()
-                    << "' in " << file2_.filename() << ", skipping." << endl;
-            }
-
+            matches[index].add(MatchAction::MISSING_SCOPE, 0, 0,
+                    scope_it1->second, NULL, NULL);
             ++scope_it1;
 
         } else { // comp_name > 0
-            if(warn_missing_scopes) {
-                cerr << "Warning: There is no scope '"
-                    << scope_it2->second->full_name()
-                    << "' in " << file1_.filename() << ", skipping." << endl;
-            }
-
+            matches[index].add(MatchAction::MISSING_SCOPE, 1, 0,
+                    scope_it2->second, NULL, NULL);
             ++scope_it2;
         }
     }
 
     // Handle remainding scopes
     while(scope_it1 != scope1.scopes().end()) {
-        if(warn_missing_scopes) {
-            cerr << "Warning: There is no scope '"
-                    << scope_it1->second->full_name()
-                    << "' in " << file2_.filename() << ", skipping." << endl;
-        }
-
+        matches[index].add(MatchAction::MISSING_SCOPE, 0, 0,
+                scope_it1->second, NULL, NULL);
         ++scope_it1;
     }
 
     while(scope_it2 != scope2.scopes().end()) {
-        if(warn_missing_scopes) {
-            cerr << "Warning: There is no scope '"
-                    << scope_it2->second->full_name()
-                    << "' in " << file1_.filename() << ", skipping." << endl;
-        }
-
+        matches[index].add(MatchAction::MISSING_SCOPE, 1, 0,
+                scope_it2->second, NULL, NULL);
         ++scope_it2;
     }
 
+    return index;
+}
 
+void Comparator::map_variables(ScopeMatch&match) {
     // Find matching signals in the current scope
-    VarStringMap::iterator var_it1 = scope1.variables().begin();
-    VarStringMap::iterator var_it2 = scope2.variables().begin();
+    VarList::iterator var_it1 = match.scope1->variables().begin();
+    VarList::iterator var_it2 = match.scope2->variables().begin();
+    VarList::iterator var_end1 = match.scope1->variables().end();
+    VarList::iterator var_end2 = match.scope2->variables().end();
+    const Scope&root1 = file1_.root_scope();
+    const Scope&root2 = file2_.root_scope();
+
+    while(var_it1 != var_end1 || var_it2 != var_end2) {
+        // Variables from the mapping file are matched by map_listed()
+        if(var_it1 != var_end1 && is_listed(0, *var_it1->second, root1)) {
+            ++var_it1;
+            continue;
+        }
+
+        if(var_it2 != var_end2 && is_listed(1, *var_it2->second, root2)) {
+            ++var_it2;
+            continue;
+        }
 
-    while(var_it1 != scope1.variables().end()
-            && var_it2 != scope2.variables().end()) {
         // Check if the current variable names match
-        int comp_name = var_it1->first.compare(var_it2->first);
+        int comp_name;
+
+        if(var_it1 == var_end1)
+            comp_name = 1;
+        else if(var_it2 == var_end2)
+            comp_name = -1;
+        else
+            comp_name = compare_names(var_it1->first, var_it2->first);
 
         if(comp_name == 0) {
             // Variable names match!
-            compare_and_match(var_it1->second, var_it2->second);
+            if(!compare_and_match(var_it1->second, var_it2->second, match))
+                match.unmatched += 2;
+
             ++var_it1;
             ++var_it2;
 
         } else if(comp_name < 0) {
-            if(warn_missing_vars) {
-                cerr << "Warning: There is no variable '" << *var_it1->second
-                    << "' in " << file2_.filename() << "." << endl;
-            }
-
+            ++match.unmatched;
+            match.add(MatchAction::MISSING_VARIABLE, 0, 0, NULL, var_it1->second, NULL);
             ++var_it1;
 
         } else { // comp_name > 0
-            if(warn_missing_vars) {
-                cerr << "Warning: There is no variable '" << *var_it2->second
-                    << "' in " << file1_.filename() << "." << endl;
-            }
-
+            ++match.unmatched;
+            match.add(MatchAction::MISSING_VARIABLE, 1, 0, NULL, NULL, var_it2->second);
             ++var_it2;
         }
     }
+}
 
-    // Handle remainding variables
-    while(var_it1 != scope1.variables().end()) {
-        if(warn_missing_vars) {
-            cerr << "Warning: There is no variable '" << *var_it1->second
-                << "' in " << file2_.filename() << "." << endl;
+void Comparator::find_listed(Scope&root1, Scope&root2,
+        vector<pair<Variable*, Variable*> >&pairs) {
+    const vector<NameMapping::Entry>&entries = name_mapping_->entries();
+    listed_.assign(entries.size(), false);
+
+    for(unsigned int i = 0; i < entries.size(); ++i) {
+        const NameMapping::Entry&entry = entries[i];
+        Variable*var1 = NameMapping::find_variable(root1, entry.name1);
+        Variable*var2 = NameMapping::find_variable(root2, entry.name2);
+
+        if(var1 && var2) {
+            pairs.push_back(make_pair(var1, var2));
+            listed_[i] = true;
+        } else if(warn_missing_vars && !quiet_mapping_) {
+            cerr << "Warning: " << name_mapping_->path() << ":" << entry.line
+                << ": There is no variable '" << (var1 ? entry.name2 : entry.name1)
+                << "' in " << (var1 ? file2_ : file1_).filename() << "." << endl;
         }
+    }
+}
 
-        ++var_it1;
+bool Comparator::is_listed(unsigned int file, const Variable&var,
+        const Scope&root) const {
+    if(!name_mapping_)
+        return false;
+
+    int entry = name_mapping_->find(file, var, root);
+
+    return entry >= 0 && listed_[entry];
+}
+
+void Comparator::map_listed(Scope&root1, Scope&root2, ScopeMatch&match) {
+    vector<pair<Variable*, Variable*> > pairs;
+    find_listed(root1, root2, pairs);
+
+    for(const auto&vars : pairs) {
+        if(!compare_and_match(vars.first, vars.second, match))
+            match.unmatched += 2;
     }
+}
+
+void Comparator::add_unmatched(unsigned int file, Scope&scope,
+        vector<Unmatched>&missing) const {
+    const WaveFile&wave_file = file == 0 ? file1_ : file2_;
+
+    for(auto&var : scope.variables()) {
+        if(!is_listed(file, *var.second, wave_file.root_scope()))
+            missing.push_back(Unmatched(file, var.second, true));
+    }
+
+    for(auto&subscope : scope.scopes())
+        add_unmatched(file, *subscope.second, missing);
+}
+
+void Comparator::map_similar(const vector<Unmatched>&missing, ScopeMatch&match) {
+    FuzzyMatcher matcher;
+    set<const Variable*> paired;
+    set<const Variable*> counted;
+
+    for(const Unmatched&var : missing) {
+        matcher.add(var.file, var.var,
+                hierarchy_name(*var.var, var.file == 0 ? file1_ : file2_));
+
+        // Variables of missing scopes are not counted as unmatched
+        if(!var.in_missing_scope)
+            counted.insert(var.var);
+    }
+
+    for(const auto&vars : matcher.match()) {
+        match.add(MatchAction::RENAMED, 0, 0, NULL, vars.first, vars.second);
+        paired.insert(vars.first);
+        paired.insert(vars.second);
 
-    while(var_it2 != scope2.variables().end()) {
-        if(warn_missing_vars) {
-            cerr << "Warning: There is no variable '" << *var_it2->second
-                    << "' in " << file1_.filename() << "." << endl;
+        if(compare_and_match(vars.first, vars.second, match)) {
+            stats_.unmatched -= counted.count(vars.first)
+                + counted.count(vars.second);
         }
+    }
 
-        ++var_it2;
+    for(const Unmatched&var : missing) {
+        if(!paired.count(var.var) && !var.in_missing_scope) {
+            match.add(MatchAction::MISSING_VARIABLE, var.file, 0, NULL,
+                    var.file == 0 ? var.var : NULL, var.file == 1 ? var.var : NULL);
+        }
     }
 }
 
-void Comparator::check_value_changes() {
-    bool file1_ok = file1_.valid();
-    bool file2_ok = file2_.valid();
+void Comparator::apply_match(vector<ScopeMatch>&matches, unsigned int index,
+        vector<Unmatched>*missing) {
+    ScopeMatch&match = matches[index];
+    stats_.unmatched += match.unmatched;
+
+    for(const MatchAction&action : match.actions) {
+        const string*texts = action.index < match.texts.size()
+            ? &match.texts[action.index] : NULL;
+
+        switch(action.type) {
+            case MatchAction::SUBSCOPE:
+                apply_match(matches, action.index, missing);
+                break;
+
+            case MatchAction::MISSING_SCOPE:
+                missing_scope(*action.scope, action.file == 0 ? file2_ : file1_);
+
+                // Variables of the scope might still have similar names
+                if(missing)
+                    add_unmatched(action.file, *action.scope, *missing);
+                break;
+
+            case MatchAction::MISSING_VARIABLE:
+                if(missing) {
+                    missing->push_back(Unmatched(action.file,
+                                action.file == 0 ? action.var1 : action.var2, false));
+                } else if(action.file == 0)
+                    missing_variable(*action.var1, file2_);
+                else
+                    missing_variable(*action.var2, file1_);
+                break;
+
+            case MatchAction::MISMATCH:
+                mismatch(*action.var1, *action.var2, texts[0], texts[1], texts[2]);
+                break;
+
+            case MatchAction::REVERSED:
+                if(structure_mode) {
+                    cout << "~ range " << texts[0] << ": "
+                        << texts[1] << " -> " << texts[2]
+                        << " (reversed, matched)" << endl;
+                }
+
+                {
+                    Vector*vec1 = vector_of(action.var1);
+                    Vector*vec2 = vector_of(action.var2);
+                    Vector*reversed = action.file == 0 ? vec1 : vec2;
+
+                    // Aliases share the vectors with their targets, so
+                    // a vector might have been reversed already
+                    if(vec1->left_idx() != vec2->left_idx()) {
+                        reversed->reverse_range();
+
+                        if(map_cache_)
+                            map_cache_->add_reversed(action.file, reversed);
+                    }
+                }
+                break;
+
+            case MatchAction::RENAMED:
+                renamed(*action.var1, *action.var2);
+                break;
+
+            case MatchAction::LINK:
+                add_link(action.var1, action.var2);
+                break;
+        }
+    }
+
+    // Release the memory early, the hierarchy might be large
+    vector<MatchAction>().swap(match.actions);
+    vector<string>().swap(match.texts);
+}
+
+void Comparator::check_value_changes(bool file1_ok, bool file2_ok,
+        unsigned long end_time, ostream&out, ostream&err, bool async) {
+    // Blocks of value changes are compared without decoding them when both
+    // files are stored in the same way and all linked variables have equal
+    // values. Otherwise the same changes may lead to a difference.
+    // Profiling and the context need all value changes to be decoded
+    bool use_blocks = !test_mode && !profile_count && !history_ && same_idents();
+    set<const Link*> unsynced;
+    unsigned int block_delay = 1, block_backoff = 1;
+
+    TRACE_SCOPE("comparison loop");
+    TraceBatch batch("next_delta");
+    ProgressSlot progress1(file1_, 0), progress2(file2_, 1);
+
+    if(profile_count)
+        link_profile_.resize(links_.size());
+
+    // The regular output is formatted by a separate thread, other reports
+    // need the current state
+    unique_ptr<AsyncOutput> async_out;
+
+    if(async && !test_mode && !intervals_mode && !summary_mode && !db_ && !history_)
+        async_out.reset(new AsyncOutput(out, err));
+
+    // Warnings are ordered with the differences
+    auto warn = [&](const string&text) {
+        if(async_out)
+            async_out->message(text);
+        else
+            err << text << endl;
+    };
+
+    if(intervals_mode)
+        intervals_.assign(links_.size(), MismatchInterval());
+
+    if(summary_mode)
+        link_summary_.resize(links_.size());
+
+    if(use_blocks) {
+        for(const Link*link : links_) {
+            if(link->first()->hash() != link->second()->hash())
+                unsynced.insert(link);
+        }
+    }
 
     while(file1_ok || file2_ok) {
         // If one of the file has finished, set its next timestamp to MAX,
@@ -193,6 +612,61 @@ void Comparator::check_value_changes() {
         unsigned long current_time;
         set<const Link*> changes;
 
+        if(min(next_event1, next_event2) >= end_time)
+            break;
+
+        ++stats_.timestamps;
+        batch.next(min(next_event1, next_event2));
+        progress1.update(min(next_event1, next_event2));
+        progress2.update(min(next_event1, next_event2));
+
+        if(use_blocks && unsynced.empty() && next_event1 == next_event2
+                && file1_ok && file2_ok && --block_delay == 0) {
+            PhaseTimer timer(stats_.parsing);
+            string block1, block2;
+            bool finished1, finished2;
+            bool same = false;
+
+            if(file1_.read_block(block1, finished1)) {
+                if(file2_.read_block(block2, finished2)) {
+                    same = (block1 == block2 && finished1 == finished2);
+
+                    if(!same)
+                        file2_.unread_block();
+                }
+
+                if(!same)
+                    file1_.unread_block();
+            }
+
+            if(same) {
+                file1_ok = !finished1;
+                file2_ok = !finished2;
+                block_delay = block_backoff = 1;
+                continue;
+            }
+
+            // Moving back in a file is costly, so make fewer attempts
+            // if blocks keep differing
+            block_backoff = min(2 * block_backoff, 1024u);
+            block_delay = block_backoff;
+        }
+
+        PhaseTimer parse_timer(stats_.parsing);
+
+        if(use_blocks) {
+            // Bring variables up to date before decoding value changes
+            file1_.apply_blocks(changes);
+            file2_.apply_blocks(changes);
+
+            for(const Link*link : changes) {
+                link->first()->clear_transition();
+                link->second()->clear_transition();
+            }
+
+            changes.clear();
+        }
+
         if(next_event1 == next_event2) {
             file1_ok = file1_.next_delta(changes);
             file2_ok = file2_.next_delta(changes);
@@ -203,8 +677,8 @@ void Comparator::check_value_changes() {
             current_time = next_event2;
 
             if(warn_missing_tstamps) {
-                cerr << "Warning: There is no timestamp #" << current_time
-                    << " in " << file1_.filename() << "." << endl;
+                warn("Warning: There is no timestamp #" + to_string(current_time)
+                        + " in " + file1_.filename() + ".");
             }
 
         } else {    // if(next_event1 < next_event2)
@@ -212,11 +686,13 @@ void Comparator::check_value_changes() {
             current_time = next_event1;
 
             if(warn_missing_tstamps) {
-                cerr << "Warning: There is no timestamp #" << current_time
-                    << " in " << file2_.filename() << "." << endl;
+                warn("Warning: There is no timestamp #" + to_string(current_time)
+                        + " in " + file2_.filename() + ".");
             }
         }
 
+        parse_timer.stop();
+
 #ifdef DEBUG
         file1_.show_state();
         file2_.show_state();
@@ -233,24 +709,112 @@ void Comparator::check_value_changes() {
                 link->second()->clear_transition();
             }
 
-            cout << current_time << ":" << hash << endl;
+            out << current_time << ":" << hash << endl;
 
         } else {
-            bool emitted_diff_header = false;
+            vector<const Link*> diffs;
 
             for(const Link*link : changes) {
-                if(!link->compare()) {
-                    if(!emitted_diff_header) {
-                        cout << "diff #" << current_time << endl;
-                        cout << "==================" << endl;
-                        emitted_diff_header = true;
+                bool equal = link->compare();
+
+                if(intervals_mode) {
+                    // Only the changes of the mismatch status are reported
+                    MismatchInterval&interval = intervals_[link->id()];
+
+                    if(!equal && !interval.open) {
+                        interval.open = true;
+                        interval.start = current_time;
+                        interval.value1 = Link::value_str(link->first());
+                        interval.value2 = Link::value_str(link->second());
+
+                    } else if(equal && interval.open) {
+                        diffs.push_back(link);
+                    }
+
+                } else if(!equal) {
+                    diffs.push_back(link);
+                }
+
+                if(profile_count) {
+                    LinkProfile&profile = link_profile_[link->id()];
+                    ++profile.compares;
+
+                    if(!equal)
+                        ++profile.mismatches;
+                }
+            }
+
+            if(!diffs.empty()) {
+                PhaseTimer timer(stats_.output);
+                TRACE_SCOPE("output");
+                stats_.diffs.add(diffs.size());
+
+                // Use the mapping order, so the output does not depend
+                // on the memory layout
+                sort(diffs.begin(), diffs.end(),
+                        [](const Link*a, const Link*b) { return a->id() < b->id(); });
+
+                if(intervals_mode) {
+                    for(const Link*link : diffs) {
+                        MismatchInterval&interval = intervals_[link->id()];
+                        print_interval(out, *link, interval.start, current_time,
+                                interval.value1, interval.value2);
+                        interval = MismatchInterval();
+                    }
+
+                } else if(summary_mode) {
+                    for(const Link*link : diffs) {
+                        LinkSummary&summary = link_summary_[link->id()];
+
+                        if(summary.add(current_time)) {
+                            summary.value1 = Link::value_str(link->first());
+                            summary.value2 = Link::value_str(link->second());
+                        }
+                    }
+
+                } else if(db_) {
+                    for(const Link*link : diffs) {
+                        db_->add(current_time, link->id(), Link::value_str(link->first()),
+                                Link::value_str(link->second()));
                     }
 
-                    cout << *link << endl;
+                } else if(async_out) {
+                    for(const Link*link : diffs)
+                        async_out->add(current_time, link);
+
+                } else {
+                    out << "diff #" << current_time << endl;
+                    out << "==================" << endl;
+
+                    for(const Link*link : diffs) {
+                        out << *link;
+
+                        if(history_)
+                            history_->print(out, link->id());
+
+                        out << endl;
+                    }
+                }
+            }
+
+            // Recorded after printing, so the context shows the preceding values
+            if(history_) {
+                for(const Link*link : changes) {
+                    history_->add(link->id(), current_time,
+                            link->first()->value_str(), link->second()->value_str());
                 }
             }
         }
 
+        if(use_blocks) {
+            for(const Link*link : changes) {
+                if(link->first()->hash() != link->second()->hash())
+                    unsynced.insert(link);
+                else
+                    unsynced.erase(link);
+            }
+        }
+
         // Clear transitions
         if(!compare_states) {
             for(const Link*link : changes) {
@@ -259,63 +823,738 @@ void Comparator::check_value_changes() {
             }
         }
     }
+
+    if(use_blocks) {
+        // Leave the files in a consistent state
+        set<const Link*> changes;
+        file1_.apply_blocks(changes);
+        file2_.apply_blocks(changes);
+    }
+
+    if(async_out)
+        async_out->finish();
+
+    // Links that still differ
+    for(const Link*link : links_) {
+        if(!intervals_mode || !intervals_[link->id()].open)
+            continue;
+
+        const MismatchInterval&interval = intervals_[link->id()];
+        print_interval(out, *link, interval.start, numeric_limits<unsigned long>::max(),
+                interval.value1, interval.value2);
+        ++stats_.diffs;
+    }
+}
+
+void Comparator::print_interval(ostream&out, const Link&link,
+        unsigned long start, unsigned long end,
+        const string&value1, const string&value2) {
+    out << "mismatch [#" << start << ", ";
+
+    if(end == numeric_limits<unsigned long>::max())
+        out << "end)" << endl;
+    else
+        out << "#" << end << ")" << endl;
+
+    link.print(out, value1, value2);
+    out << endl;
+}
+
+bool Comparator::enforce_mem_limit() {
+    // Degradation starts when the usage gets close to the limit, as
+    // the comparison needs memory on its own
+    const size_t limit = mem_limit * 1024 * 1024;
+    const size_t soft_limit = limit / 4 * 3;
+    size_t used = mem_resident();
+
+    // Unlinked variables are not compared, but they are still updated
+    if(used > soft_limit && !test_mode) {
+        unsigned int dropped = file1_.drop_unlinked() + file2_.drop_unlinked();
+        dropped_unlinked_ = true;
+        malloc_trim(0);
+        used = mem_resident();
+
+        cerr << "Warning: Memory usage close to the limit, dropped " << dropped
+            << " unlinked variables (" << (used >> 20) << " MB used)." << endl;
+    }
+
+    if(used > limit) {
+        cerr << "Error: Memory limit of " << mem_limit << " MB exceeded after "
+            "reading the headers (" << (used >> 20) << " MB used)." << endl;
+        return false;
+    }
+
+    size_t available = used < soft_limit ? soft_limit - used : 0;
+
+    // Each partitioned window keeps its own copy of both files
+    if(partitioned_mode && threads > 1) {
+        unsigned int windows = 1 + available / used;
+
+        if(windows < threads) {
+            cerr << "Warning: Memory limit allows " << windows
+                << " partitioned window(s) instead of " << threads << "." << endl;
+            threads = windows;
+        }
+    }
+
+    // Columnar mode buffers value changes, so they are limited to the
+    // available memory, and if there is too little, the files are streamed
+    if(columnar_mode && !test_mode) {
+        unsigned long available_mb = available >> 20;
+
+        if(available_mb < 16) {
+            cerr << "Warning: Not enough memory for the columnar mode, "
+                "comparing the files sequentially." << endl;
+            columnar_mode = false;
+        } else if(columnar_mem == 0 || columnar_mem > available_mb) {
+            columnar_mem = available_mb;
+        }
+    }
+
+    return true;
+}
+
+int Comparator::compare_digests() {
+    Digest digest1(digest_bucket), digest2(digest_bucket);
+    bool loaded1 = digest1.load(file1_.filename());
+    bool loaded2 = digest2.load(file2_.filename());
+    bool header1_ok = true, header2_ok = true;
+
+    // Both files are digested in parallel
+    thread digester;
+
+    if(!loaded1) {
+        digester = thread([&]() {
+            trace_thread_name("digest");
+            header1_ok = file1_.parse_header();
+
+            if(header1_ok)
+                digest1.compute(file1_, 0);
+        });
+    }
+
+    if(!loaded2) {
+        header2_ok = file2_.parse_header();
+
+        if(header2_ok)
+            digest2.compute(file2_, 1);
+    }
+
+    if(digester.joinable())
+        digester.join();
+
+    if(!header1_ok || !header2_ok)
+        return 2;
+
+    for(int i = 0; i < 2 && digest_save; ++i) {
+        const WaveFile&file = i == 0 ? file1_ : file2_;
+
+        if(!(i == 0 ? loaded1 : loaded2)
+                && !(i == 0 ? digest1 : digest2).save(file.filename())) {
+            cerr << "Warning: Could not save "
+                << Digest::sidecar_name(file.filename()) << "." << endl;
+        }
+    }
+
+    if(digest1.timescale() != digest2.timescale()) {
+        cerr << "Warning: Compared files use different timescales." << endl;
+    }
+
+    Digest::compare(digest1, digest2, file1_.filename(), file2_.filename(), cout, cerr);
+
+    return 0;
+}
+
+void Comparator::missing_scope(const Scope&scope, const WaveFile&other) {
+    if(map_cache_) {
+        map_cache_->add_event(MappingCache::Event::MISSING_SCOPE,
+                &other == &file2_ ? 0 : 1, &scope);
+    }
+
+    if(structure_mode) {
+        const WaveFile&file = (&other == &file2_) ? file1_ : file2_;
+        cout << (&file == &file1_ ? "- " : "+ ") << "scope "
+            << relative_name(scope.full_name(), file) << endl;
+        structure_differs_ = true;
+    } else if(warn_missing_scopes && !quiet_mapping_) {
+        cerr << "Warning: There is no scope '" << scope.full_name()
+            << "' in " << other.filename() << ", skipping." << endl;
+    }
+}
+
+void Comparator::missing_variable(const Variable&var, const WaveFile&other) {
+    if(map_cache_) {
+        map_cache_->add_event(MappingCache::Event::MISSING_VARIABLE,
+                &other == &file2_ ? 0 : 1, &var);
+    }
+
+    if(structure_mode) {
+        const WaveFile&file = (&other == &file2_) ? file1_ : file2_;
+        cout << (&file == &file1_ ? "- " : "+ ") << "variable "
+            << relative_name(var, file) << endl;
+        structure_differs_ = true;
+    } else if(warn_missing_vars && !quiet_mapping_) {
+        cerr << "Warning: There is no variable '" << var
+            << "' in " << other.filename() << "." << endl;
+    }
+}
+
+void Comparator::mismatch(const Variable&var1, const Variable&var2,
+        const string&what, const string&value1, const string&value2) {
+    // Only size and type warnings might be disabled
+    bool warn = (what == "size") ? warn_size_mismatch
+        : (what == "type") ? warn_type_mismatch : true;
+
+    if(map_cache_) {
+        map_cache_->add_event(MappingCache::Event::MISMATCH, 0, &var1, &var2,
+                what, value1, value2);
+    }
+
+    if(structure_mode) {
+        cout << "! " << what << " " << relative_name(var1, file1_) << ": "
+            << value1 << " -> " << value2 << endl;
+        structure_differs_ = true;
+    } else if(warn && !quiet_mapping_) {
+        cerr << "Warning: " << var1 << " and " << var2 << " have different "
+            << what << (what == "index" ? "es" : "s")
+            << ", they are not matched" << endl;
+    }
+}
+
+void Comparator::renamed(const Variable&var1, const Variable&var2) {
+    if(map_cache_)
+        map_cache_->add_event(MappingCache::Event::RENAMED, 0, &var1, &var2);
+
+    // Ranges are skipped, they might be reversed while matching
+    if(structure_mode) {
+        cout << "~ name " << hierarchy_name(var1, file1_) << " -> "
+            << hierarchy_name(var2, file2_) << " (similar, matched)" << endl;
+    } else if(warn_missing_vars && !quiet_mapping_) {
+        cerr << "Warning: Matched " << var1.scope()->full_name() << "." << var1.name()
+            << " and " << var2.scope()->full_name() << "." << var2.name()
+            << ", their names are similar." << endl;
+    }
+}
+
+int Comparator::compare_structure() {
+    bool header1_ok = false, header2_ok;
+
+    thread parser([&]() {
+        trace_thread_name("header");
+        TRACE_SCOPE("parse_header", "\"file\":1");
+        header1_ok = file1_.parse_header();
+    });
+
+    {
+        TRACE_SCOPE("parse_header", "\"file\":2");
+        header2_ok = file2_.parse_header();
+    }
+
+    parser.join();
+
+    if(!header1_ok || !header2_ok)
+        return 2;
+
+    cout << "--- " << file1_.filename() << endl;
+    cout << "+++ " << file2_.filename() << endl;
+
+    if(file1_.timescale() != file2_.timescale()) {
+        cout << "! timescale: 1e" << file1_.timescale() << " s -> 1e"
+            << file2_.timescale() << " s" << endl;
+        structure_differs_ = true;
+    }
+
+    TRACE_SCOPE("map_signals");
+    map_signals(file1_.root_scope(), file2_.root_scope());
+
+    // Renamed and reversed variables are matched, so they do not count
+    return structure_differs_ ? 1 : 0;
+}
+
+bool Comparator::same_idents() const {
+    const VarStringMap&idents1 = file1_.idents();
+    const VarStringMap&idents2 = file2_.idents();
+
+    if(idents1.size() != idents2.size())
+        return false;
+
+    for(VarStringMap::const_iterator it1 = idents1.begin(), it2 = idents2.begin();
+            it1 != idents1.end(); ++it1, ++it2) {
+        const Variable*var1 = it1->second;
+        const Variable*var2 = it2->second;
+
+        if(it1->first != it2->first || var1->size() != var2->size()
+                || var1->index() != var2->index())
+            return false;
+
+        // Value changes have to modify the same link
+        const Link*link1 = var1->parent() ? var1->parent()->link() : NULL;
+        const Link*link2 = var2->parent() ? var2->parent()->link() : NULL;
+
+        if(!link1)
+            link1 = var1->link();
+
+        if(!link2)
+            link2 = var2->link();
+
+        if(link1 != link2 || var1->alias_links() != var2->alias_links())
+            return false;
+
+        // The same bits have to be assigned in both vectors
+        if(var1->is_vector()) {
+            const Vector*vec1 = static_cast<const Vector*>(var1);
+            const Vector*vec2 = static_cast<const Vector*>(var2);
+
+            if(vec1->left_idx() != vec2->left_idx()
+                    || vec1->right_idx() != vec2->right_idx())
+                return false;
+        }
+    }
+
+    return true;
+}
+
+void Comparator::check_value_changes_columnar() {
+    // Memory budget is shared by both files and the found differences
+    unsigned long budget = columnar_mem * 1024 * 1024 / 3;
+    ColumnStore store1(links_.size(), budget), store2(links_.size(), budget);
+    DiffStore diffs(links_.size(), budget);
+
+    // Both files are independent, so they are read in parallel
+    {
+        PhaseTimer timer(stats_.parsing);
+        thread reader(&Comparator::read_columns, this, ref(file1_), true, ref(store1));
+        read_columns(file2_, false, store2);
+        reader.join();
+    }
+
+    // Compare columns, each link is processed by a single thread
+    atomic<unsigned int> next_column(0);
+    atomic<bool> load_error(false);
+    vector<thread> workers;
+
+    if(profile_count)
+        link_profile_.resize(links_.size());
+
+    if(summary_mode)
+        link_summary_.resize(links_.size());
+
+    for(unsigned int i = 0; i < threads; ++i) {
+        workers.push_back(thread([&, i]() {
+            trace_thread_name("worker " + to_string(i + 1));
+            TRACE_SCOPE("compare columns");
+            Column col1, col2;
+            vector<ColumnDiff> column_diffs;
+            unsigned int idx;
+
+            while((idx = next_column++) < diffs.size()) {
+                if(!store1.load(idx, col1) || !store2.load(idx, col2)) {
+                    load_error = true;
+                    break;
+                }
+
+                unsigned int count = compare_columns(col1, col2, column_diffs);
+
+                if(profile_count) {
+                    link_profile_[idx].compares = count;
+                    link_profile_[idx].mismatches = column_diffs.size();
+                }
+
+                diffs.store(idx, column_diffs);
+                column_diffs.clear();
+            }
+        }));
+    }
+
+    for(thread&worker : workers)
+        worker.join();
+
+    if(load_error) {
+        cerr << "Error: Could not read a temporary file." << endl;
+        return;
+    }
+
+    // Merge the per-link differences, ordered by time and link index.
+    // Only the earliest difference of each link is kept in memory.
+    typedef pair<unsigned long, unsigned int> diff_key_t;   // (time, link)
+    priority_queue<diff_key_t, vector<diff_key_t>, greater<diff_key_t> > queue;
+    vector<ColumnDiff> heads(diffs.size());
+    vector<const Link*> links(links_.begin(), links_.end());
+
+    for(unsigned int i = 0; i < diffs.size(); ++i) {
+        if(diffs.next(i, heads[i]))
+            queue.push(make_pair(heads[i].time, i));
+    }
+
+    ColumnStore::TimestampReader tstamps1(store1), tstamps2(store2);
+    PhaseTimer timer(stats_.output);
+    TRACE_SCOPE("output");
+
+    while(tstamps1.valid() || tstamps2.valid()) {
+        unsigned long next_event1 = tstamps1.valid() ?
+            tstamps1.time() : numeric_limits<unsigned long>::max();
+        unsigned long next_event2 = tstamps2.valid() ?
+            tstamps2.time() : numeric_limits<unsigned long>::max();
+        unsigned long current_time = min(next_event1, next_event2);
+
+        ++stats_.timestamps;
+
+        if(next_event1 == next_event2) {
+            tstamps1.next();
+            tstamps2.next();
+
+        } else if(next_event1 > next_event2) {
+            tstamps2.next();
+
+            if(warn_missing_tstamps) {
+                cerr << "Warning: There is no timestamp #" << current_time
+                    << " in " << file1_.filename() << "." << endl;
+            }
+
+        } else {    // if(next_event1 < next_event2)
+            tstamps1.next();
+
+            if(warn_missing_tstamps) {
+                cerr << "Warning: There is no timestamp #" << current_time
+                    << " in " << file2_.filename() << "." << endl;
+            }
+        }
+
+        bool emitted_diff_header = false;
+
+        while(!queue.empty() && queue.top().first == current_time) {
+            unsigned int link_idx = queue.top().second;
+            ColumnDiff diff;
+            swap(diff, heads[link_idx]);
+            queue.pop();
+            ++stats_.diffs;
+
+            if(diffs.next(link_idx, heads[link_idx]))
+                queue.push(make_pair(heads[link_idx].time, link_idx));
+
+            if(intervals_mode) {
+                print_interval(cout, *links[link_idx], diff.start, diff.time,
+                        diff.value1, diff.value2);
+                continue;
+            }
+
+            if(summary_mode) {
+                LinkSummary&summary = link_summary_[link_idx];
+
+                if(summary.add(current_time)) {
+                    summary.value1 = diff.value1;
+                    summary.value2 = diff.value2;
+                }
+
+                continue;
+            }
+
+            if(db_) {
+                db_->add(current_time, link_idx, diff.value1, diff.value2);
+                continue;
+            }
+
+            if(!emitted_diff_header) {
+                cout << "diff #" << current_time << endl;
+                cout << "==================" << endl;
+                emitted_diff_header = true;
+            }
+
+            links[link_idx]->print(cout, diff.value1, diff.value2);
+            cout << diff.context << endl;
+        }
+    }
+
+    // Intervals that last until the end of the files
+    while(!queue.empty()) {
+        unsigned int link_idx = queue.top().second;
+        ColumnDiff diff;
+        swap(diff, heads[link_idx]);
+        queue.pop();
+        ++stats_.diffs;
+
+        print_interval(cout, *links[link_idx], diff.start, diff.time,
+                diff.value1, diff.value2);
+
+        if(diffs.next(link_idx, heads[link_idx]))
+            queue.push(make_pair(heads[link_idx].time, link_idx));
+    }
+
+    if(tstamps1.failed() || tstamps2.failed() || diffs.failed())
+        cerr << "Error: Could not read a temporary file." << endl;
+}
+
+bool Comparator::check_value_changes_partitioned() {
+    // Find checkpoints in both files, several per window
+    vector<WaveFile::Checkpoint> checkpoints1, checkpoints2;
+    bool index1_ok = false, index2_ok;
+
+    thread indexer([&]() {
+        trace_thread_name("indexer");
+        TRACE_SCOPE("build_index", "\"file\":1");
+        index1_ok = file1_.build_index(threads * 4, checkpoints1);
+    });
+
+    {
+        TRACE_SCOPE("build_index", "\"file\":2");
+        index2_ok = file2_.build_index(threads * 4, checkpoints2);
+    }
+
+    indexer.join();
+
+    if(!index1_ok || !index2_ok)
+        return false;
+
+    // Windows start at checkpoints of the first file
+    vector<const WaveFile::Checkpoint*> starts(1, NULL);
+
+    for(unsigned int i = 1; i < threads; ++i) {
+        unsigned int idx = i * checkpoints1.size() / threads;
+
+        if(idx < checkpoints1.size() && starts.back() != &checkpoints1[idx])
+            starts.push_back(&checkpoints1[idx]);
+    }
+
+    // The first window is processed using the already loaded files, the other
+    // ones need separate copies. Warnings have been already displayed.
+    vector<WaveFile*> files;
+    vector<Comparator*> comparators(1, this);
+    bool setup_ok = true;
+
+    // Messages displayed while parsing the headers, the mapping results
+    // are skipped by the window Comparators
+    bool warn_flags[] = { warn_duplicate_vars, warn_unexpected_tokens };
+    warn_duplicate_vars = warn_unexpected_tokens = false;
+
+    TraceScope setup_trace("window setup");
+
+    for(unsigned int i = 1; i < starts.size() && setup_ok; ++i) {
+        WaveFile*file1 = WaveFile::open(file1_.filename().c_str());
+        WaveFile*file2 = WaveFile::open(file2_.filename().c_str());
+        files.push_back(file1);
+        files.push_back(file2);
+
+        setup_ok = file1->valid() && file2->valid()
+            && file1->parse_header() && file2->parse_header();
+
+        if(setup_ok) {
+            Comparator*comp = new Comparator(*file1, *file2);
+            comp->name_mapping_ = name_mapping_;
+            comp->quiet_mapping_ = true;
+            comp->map_signals(file1->root_scope(), file2->root_scope());
+            comparators.push_back(comp);
+
+            if(dropped_unlinked_) {
+                file1->drop_unlinked();
+                file2->drop_unlinked();
+            }
+        }
+    }
+
+    warn_duplicate_vars = warn_flags[0];
+    warn_unexpected_tokens = warn_flags[1];
+
+    setup_trace.end();
+
+    if(setup_ok) {
+        vector<stringstream> outputs(starts.size()), errors(starts.size());
+        vector<thread> workers;
+
+        for(unsigned int i = 0; i < starts.size(); ++i) {
+            unsigned long end_time = (i + 1 < starts.size()) ?
+                starts[i + 1]->time : numeric_limits<unsigned long>::max();
+
+            workers.push_back(thread(&Comparator::check_window, comparators[i],
+                        starts[i], cref(checkpoints2), end_time,
+                        ref(outputs[i]), ref(errors[i])));
+        }
+
+        // Windows do not overlap, so the results are simply concatenated
+        for(unsigned int i = 0; i < starts.size(); ++i) {
+            TraceScope trace("wait for window");
+            workers[i].join();
+            trace.restart("output");
+
+            // Inserting an empty buffer would set failbit in the stream
+            if(outputs[i].tellp() > 0)
+                cout << outputs[i].rdbuf();
+
+            if(db_ && i > 0)
+                db_->append(*comparators[i]->db_);
+
+            // Windows are merged in time order
+            if(summary_mode && i > 0) {
+                for(unsigned int j = 0; j < link_summary_.size(); ++j)
+                    link_summary_[j].merge(comparators[i]->link_summary_[j]);
+            }
+
+            if(errors[i].tellp() > 0)
+                cerr << errors[i].rdbuf();
+
+            outputs[i].str(string());
+            errors[i].str(string());
+        }
+    }
+
+    for(unsigned int i = 1; i < comparators.size(); ++i) {
+        Comparator*comp = comparators[i];
+        Stats window;
+        comp->collect_stats(window);
+        stats_.merge(window);
+
+        if(profile_count) {
+            file1_.merge_profile(comp->file1_);
+            file2_.merge_profile(comp->file2_);
+
+            // Links are created in the same order for all windows
+            for(unsigned int j = 0; j < comp->link_profile_.size(); ++j) {
+                link_profile_[j].compares += comp->link_profile_[j].compares;
+                link_profile_[j].mismatches += comp->link_profile_[j].mismatches;
+            }
+        }
+
+        delete comp;
+    }
+
+    for(WaveFile*file : files)
+        delete file;
+
+    return setup_ok;
+}
+
+void Comparator::check_window(const WaveFile::Checkpoint*start1,
+        const vector<WaveFile::Checkpoint>&checkpoints2,
+        unsigned long end_time, ostream&out, ostream&err) {
+    bool file1_ok = file1_.valid();
+    bool file2_ok = file2_.valid();
+
+    trace_thread_name("window #" + to_string(start1 ? start1->time : 0));
+
+    if(start1) {
+        TRACE_SCOPE("restore");
+        set<const Link*> changes;
+        file1_ok = file1_.restore(*start1, changes);
+
+        // Start from the closest preceding checkpoint in the second file,
+        // and skip the remaining value changes up to the window beginning
+        const WaveFile::Checkpoint*start2 = NULL;
+
+        for(const WaveFile::Checkpoint&checkpoint : checkpoints2) {
+            if(checkpoint.time > start1->time)
+                break;
+
+            start2 = &checkpoint;
+        }
+
+        if(start2)
+            file2_ok = file2_.restore(*start2, changes);
+
+        while(file2_ok && file2_.next_timestamp() < start1->time)
+            file2_ok = file2_.next_delta(changes);
+
+        for(const Link*link : changes) {
+            link->first()->clear_transition();
+            link->second()->clear_transition();
+        }
+
+        // Changes before the window are profiled by the previous one
+        file1_.clear_profile();
+        file2_.clear_profile();
+    }
+
+    check_value_changes(file1_ok, file2_ok, end_time, out, err, false);
 }
 
-bool Comparator::compare_and_match(Variable*var1, Variable*var2) {
+void Comparator::read_columns(WaveFile&file, bool first_file, ColumnStore&store) {
+    if(first_file)
+        trace_thread_name("reader");
+
+    TRACE_SCOPE("read_columns", "\"file\":" + string(first_file ? "1" : "2"));
+    TraceBatch batch("next_delta");
+    ProgressSlot progress(file, first_file ? 0 : 1);
+
+    // Values before the first timestamp
+    for(const Link*link : links_) {
+        const Variable*var = first_file ? link->first() : link->second();
+        store.set_initial(link->id(), var->value_str());
+    }
+
+    bool file_ok = file.valid();
+
+    while(file_ok) {
+        unsigned long current_time = file.next_timestamp();
+        set<const Link*> changes;
+
+        batch.next(current_time);
+        progress.update(current_time);
+        file_ok = file.next_delta(changes);
+        store.add_timestamp(current_time);
+
+        for(const Link*link : changes) {
+            const Variable*var = first_file ? link->first() : link->second();
+            store.append(link->id(), current_time, var->value_str());
+        }
+
+        store.spill_if_needed();
+    }
+}
+
+bool Comparator::compare_and_match(Variable*var1, Variable*var2, ScopeMatch&match) {
     DBG("checking match %s <-> %s",
             var1->full_name().c_str(),
             var2->full_name().c_str());
 
     if(var1->size() != var2->size()) {
-        if(warn_size_mismatch) {
-        cerr << "Warning: " << *var1 << " and " << *var2
-             << " have different sizes, they are not matched" << endl;
-        }
+        match.add(MatchAction::MISMATCH, 0, match.texts.size(), NULL, var1, var2);
+        match.texts.insert(match.texts.end(), { "size",
+                to_string(var1->size()), to_string(var2->size()) });
         return false;
     }
 
     if(!ignore_var_type && var1->type() != var2->type()) {
-        if(warn_type_mismatch) {
-            cerr << "Warning: " << *var1 << " and " << *var2
-                << " have different types, they are not matched" << endl;
-        }
+        match.add(MatchAction::MISMATCH, 0, match.texts.size(), NULL, var1, var2);
+        match.texts.insert(match.texts.end(), { "type",
+                type_name(var1->type()), type_name(var2->type()) });
         return false;
     }
 
     if(!ignore_var_index) {
         if(!var1->is_vector()) {
             if(var1->index() != var2->index()) {
-                cerr << "Warning: " << *var1 << " and " << *var2
-                     << " have different indexes, they are not matched" << endl;
+                match.add(MatchAction::MISMATCH, 0, match.texts.size(), NULL, var1, var2);
+                match.texts.insert(match.texts.end(), { "index",
+                        to_string(var1->index()), to_string(var2->index()) });
                 return false;
             }
 
         } else {    // Vectors
-            Vector*vec1 = static_cast<Vector*>(var1);
-            Vector*vec2 = static_cast<Vector*>(var2);
+            Vector*vec1 = vector_of(var1);
+            Vector*vec2 = vector_of(var2);
 
             if((vec1->min_idx() != vec2->min_idx())
                     || (vec1->max_idx() != vec2->max_idx())) {
-                cerr << "Warning: " << *var1 << " and " << *var2
-                     << " have different ranges, they are not matched" << endl;
+                match.add(MatchAction::MISMATCH, 0, match.texts.size(), NULL, var1, var2);
+                match.texts.insert(match.texts.end(), { "range",
+                        range_str(*vec1), range_str(*vec2) });
                 return false;
             }
 
-            // Detect inverted ranges and fix them
+            // Detect inverted ranges, they are fixed by apply_match(), as
+            // vectors of aliases might be shared with other scope pairs
             if(vec1->left_idx() != vec2->left_idx()
                     || vec1->right_idx() != vec2->right_idx()) {
                 // Prefer descending ranges
-                if(vec1->range_desc())
-                    vec2->reverse_range();
-                else
-                    vec1->reverse_range();
+                match.add(MatchAction::REVERSED, vec1->range_desc() ? 1 : 0,
+                        match.texts.size(), NULL, var1, var2);
+                match.texts.insert(match.texts.end(), { relative_name(*var1, file1_),
+                        range_str(*vec1), range_str(*vec2) });
             }
 
             // Match array elements (vec1 & vec2 ranges are equal)
             for(int i = vec1->min_idx(); i <= vec1->max_idx(); ++i) {
                 DBG("- comparing array elements for %s and %s",
                         vec1->full_name().c_str(), vec2->full_name().c_str())
-                compare_and_match((*vec1)[i], (*vec2)[i]);
+                compare_and_match((*vec1)[i], (*vec2)[i], match);
             }
         }
     }
@@ -323,14 +1562,93 @@ bool Comparator::compare_and_match(Variable*var1, Variable*var2) {
     // Create a link, only if at least one of the variables has an identifier
     // assigned. Otherwise VCD file does not store any value changes
     // for the variable and there is no point in linking it to anything.
-    if(!var1->ident().empty() || !var2->ident().empty()) {
-        Link*link = new Link(var1, var2);
-        var1->set_link(link);
-        var2->set_link(link);
-        links_.push_back(link);
-        DBG("linked");
-    }
+    if(!var1->ident().empty() || !var2->ident().empty())
+        match.add(MatchAction::LINK, 0, 0, NULL, var1, var2);
 
     return true;
 }
 
+// Registers a link with the targets of aliases, so value changes assigned
+// to the targets are reported for the aliases as well
+static void add_alias_links(Variable*var, const Link*link) {
+    if(Alias*alias = dynamic_cast<Alias*>(var)) {
+        alias->target()->add_alias_link(link);
+
+    } else if(Vector*vec = dynamic_cast<Vector*>(var)) {
+        for(int i = vec->min_idx(); i <= vec->max_idx(); ++i)
+            add_alias_links((*vec)[i], link);
+    }
+}
+
+void Comparator::add_link(Variable*var1, Variable*var2) {
+    Link*link = new Link(var1, var2);
+    link->set_id(links_.size());
+    var1->set_link(link);
+    var2->set_link(link);
+    add_alias_links(var1, link);
+    add_alias_links(var2, link);
+    links_.push_back(link);
+    DBG("linked");
+
+    if(map_cache_)
+        map_cache_->add_link(var1, var2);
+}
+
+void Comparator::map_signals_cached() {
+    MappingCache cache(map_cache_dir, file1_, file2_,
+            name_mapping_ ? name_mapping_->fingerprint() : 0);
+
+    if(cache.load()) {
+        // Report the listed names that do not exist, as while mapping
+        if(name_mapping_) {
+            vector<pair<Variable*, Variable*> > pairs;
+            find_listed(file1_.root_scope(), file2_.root_scope(), pairs);
+        }
+
+        // Variables are modified in the same order as during mapping
+        for(const auto&vec : cache.reversed)
+            static_cast<Vector*>(cache.variable(vec.first, vec.second))->reverse_range();
+
+        for(const MappingCache::Event&event : cache.events) {
+            switch(event.type) {
+                case MappingCache::Event::MISSING_SCOPE:
+                    missing_scope(*cache.scope(event.file, event.first),
+                            event.file == 0 ? file2_ : file1_);
+                    break;
+
+                case MappingCache::Event::MISSING_VARIABLE:
+                    missing_variable(*cache.variable(event.file, event.first),
+                            event.file == 0 ? file2_ : file1_);
+                    break;
+
+                case MappingCache::Event::MISMATCH:
+                    mismatch(*cache.variable(0, event.first),
+                            *cache.variable(1, event.second),
+                            event.what, event.value1, event.value2);
+                    break;
+
+                case MappingCache::Event::RENAMED:
+                    renamed(*cache.variable(0, event.first), *cache.variable(1, event.second));
+                    break;
+            }
+        }
+
+        for(const auto&link : cache.links)
+            add_link(cache.variable(0, link.first), cache.variable(1, link.second));
+
+        stats_.unmatched += cache.unmatched;
+        return;
+    }
+
+    unsigned long unmatched = stats_.unmatched;
+    map_cache_ = &cache;
+    map_signals(file1_.root_scope(), file2_.root_scope());
+    map_cache_ = NULL;
+    cache.unmatched = stats_.unmatched - unmatched;
+
+    if(!cache.save()) {
+        cerr << "Warning: Could not save the mapping cache "
+            << cache.path() << "." << endl;
+    }
+}
+
@@ -19,30 +19,302 @@
 #ifndef COMPARATOR_H
 #define COMPARATOR_H
 
+#include <iostream>
 #include <list>
+#include <memory>
+#include <string>
+#include <vector>
 
+#include "profile.h"
+#include "stats.h"
+#include "summary.h"
+#include "wavefile.h"
+
+class ColumnStore;
+class DiffDbWriter;
 class Link;
+class MappingCache;
+class NameMapping;
 class Scope;
+class ValueHistory;
 class Variable;
-class VcdFile;
 
 class Comparator {
 public:
-    Comparator(VcdFile&file1, VcdFile&file2);
+    Comparator(WaveFile&file1, WaveFile&file2);
     ~Comparator();
 
     int compare();
 
 private:
+    ///> Result of matching, applied once all scopes are matched
+    struct MatchAction {
+        enum type_t {
+            SUBSCOPE, MISSING_SCOPE, MISSING_VARIABLE, MISMATCH, REVERSED, RENAMED,
+            LINK
+        };
+
+        type_t type;
+
+        // File containing the missing or reversed object (0 or 1)
+        unsigned int file;
+
+        // SUBSCOPE: position in the list of scope pairs,
+        // MISMATCH and REVERSED: position of the texts in ScopeMatch::texts
+        unsigned int index;
+
+        Scope*scope;
+        Variable*var1, *var2;
+    };
+
+    ///> Pair of scopes with the same name, matched independently of the others
+    struct ScopeMatch {
+        ScopeMatch(Scope*scope1, Scope*scope2)
+            : scope1(scope1), scope2(scope2), unmatched(0) {}
+
+        Scope*scope1, *scope2;
+
+        // Actions in the order of the sequential mapping
+        std::vector<MatchAction> actions;
+
+        // Mismatching properties and values, reversed ranges
+        std::vector<std::string> texts;
+
+        unsigned long unmatched;
+
+        void add(MatchAction::type_t type, unsigned int file, unsigned int index,
+                Scope*scope, Variable*var1, Variable*var2);
+    };
+
+    /**
+     * @brief Links the variables that have the same names in both hierarchies.
+     * Variables of the matched scope pairs are compared in parallel, then the
+     * results are applied in the hierarchy order, so the links and warnings
+     * do not depend on the number of threads.
+     */
     void map_signals(Scope&scope1, Scope&scope2);
 
-    void check_value_changes();
+    /**
+     * @brief Finds the scope pairs with the same names.
+     * @return Position of the scope1 & scope2 pair in the list.
+     */
+    unsigned int map_scopes(Scope&scope1, Scope&scope2,
+            std::vector<ScopeMatch>&matches);
+
+    // Matches the variables of a scope pair, safe to call from many threads
+    void map_variables(ScopeMatch&match);
+
+    // Finds the variables listed in the mapping file, reports the missing ones
+    void find_listed(Scope&root1, Scope&root2,
+            std::vector<std::pair<Variable*, Variable*> >&pairs);
+
+    // Checks if a variable belongs to a mapping file entry whose variables
+    // exist in both files, so it is not matched by name
+    bool is_listed(unsigned int file, const Variable&var, const Scope&root) const;
+
+    // Matches the pairs listed in the mapping file
+    void map_listed(Scope&root1, Scope&root2, ScopeMatch&match);
+
+    ///> Variable without a counterpart of the same name in the other file
+    struct Unmatched {
+        Unmatched(unsigned int file, Variable*var, bool in_missing_scope)
+            : file(file), var(var), in_missing_scope(in_missing_scope) {}
+
+        unsigned int file;
+        Variable*var;
+
+        // Variables of missing scopes are reported with their scopes
+        bool in_missing_scope;
+    };
+
+    /**
+     * @brief Matches variables that have similar names.
+     * @param missing are the variables that do not occur in the other file.
+     * The remaining ones are reported as missing, unless their scopes are.
+     */
+    void map_similar(const std::vector<Unmatched>&missing, ScopeMatch&match);
+
+    // Adds the variables of a missing scope and its subscopes
+    void add_unmatched(unsigned int file, Scope&scope,
+            std::vector<Unmatched>&missing) const;
+
+    /**
+     * @brief Applies the results of a scope pair and its subscopes.
+     * @param missing receives the variables missing in the other file, instead
+     * of reporting them, including the variables of missing scopes. Might be
+     * NULL.
+     */
+    void apply_match(std::vector<ScopeMatch>&matches, unsigned int index,
+            std::vector<Unmatched>*missing);
+
+    /**
+     * @brief Compares value changes in both files, starting from their
+     * current positions.
+     * @param file1_ok and file2_ok tell if there are value changes to read.
+     * @param end_time is the first timestamp that is not processed.
+     * @param out and err receive the differences and warnings, respectively.
+     * @param async enables formatting the differences on a separate thread.
+     */
+    void check_value_changes(bool file1_ok, bool file2_ok,
+            unsigned long end_time, std::ostream&out, std::ostream&err,
+            bool async);
+
+    /**
+     * @brief Alternative to check_value_changes(): splits the simulation time
+     * into windows compared in parallel, each one using its own copy of
+     * the files.
+     * @return false if the files could not be split.
+     */
+    bool check_value_changes_partitioned();
+
+    /**
+     * @brief Compares a single time window.
+     * @param start1 is the checkpoint of the first file where the window
+     * begins, NULL for the beginning of the file.
+     * @param checkpoints2 are the checkpoints of the second file.
+     * @param end_time is the first timestamp of the next window.
+     */
+    void check_window(const WaveFile::Checkpoint*start1,
+            const std::vector<WaveFile::Checkpoint>&checkpoints2,
+            unsigned long end_time, std::ostream&out, std::ostream&err);
+
+    /**
+     * @brief Alternative to check_value_changes(): reads both files into
+     * per-link columns and compares the columns in parallel.
+     */
+    void check_value_changes_columnar();
+
+    /**
+     * @brief Reads all value changes of a file into columns.
+     * @param first_file selects the variables from the links that belong
+     * to the file.
+     */
+    void read_columns(WaveFile&file, bool first_file, ColumnStore&store);
 
-    bool compare_and_match(Variable*var1, Variable*var2);
+    bool compare_and_match(Variable*var1, Variable*var2, ScopeMatch&match);
+
+    /**
+     * @brief Reports a scope that exists only in one of the files.
+     * @param other is the file that does not contain the scope.
+     */
+    void missing_scope(const Scope&scope, const WaveFile&other);
+
+    /**
+     * @brief Reports a variable that exists only in one of the files.
+     * @param other is the file that does not contain the variable.
+     */
+    void missing_variable(const Variable&var, const WaveFile&other);
+
+    /**
+     * @brief Reports variables that could not be matched.
+     * @param what is the mismatching property (size, type, index, range).
+     */
+    void mismatch(const Variable&var1, const Variable&var2,
+            const std::string&what,
+            const std::string&value1, const std::string&value2);
+
+    /**
+     * @brief Reports variables matched despite different names.
+     */
+    void renamed(const Variable&var1, const Variable&var2);
+
+    void add_link(Variable*var1, Variable*var2);
+
+    /**
+     * @brief Loads the mapping from the cache directory, or maps the signals
+     * and stores the result there.
+     */
+    void map_signals_cached();
+
+    /**
+     * @brief Alternative to the regular comparison: reads only the headers
+     * and prints the differences in the hierarchy.
+     */
+    int compare_structure();
+
+    /**
+     * @brief Keeps the memory usage below --mem-limit by dropping unlinked
+     * variables and limiting the comparison modes that buffer data.
+     * @return false if the limit is exceeded anyway.
+     */
+    bool enforce_mem_limit();
+
+    /**
+     * @brief Alternative to the regular comparison: compares per-signal
+     * digests, loaded from sidecar files if they are up to date.
+     */
+    int compare_digests();
+
+    /**
+     * @brief Checks if both files use the same identifiers for the linked
+     * variables, so their value changes might be compared as raw data.
+     */
+    bool same_idents() const;
+
+    /**
+     * @brief Adds statistics of the compared files and the comparison.
+     */
+    void collect_stats(Stats&stats) const;
+
+    ///> Period when a link mismatches, reported with --intervals
+    struct MismatchInterval {
+        MismatchInterval() : open(false), start(0) {}
+
+        bool open;
+        unsigned long start;
+
+        // Values at the beginning of the interval
+        std::string value1, value2;
+    };
+
+    /**
+     * @brief Prints a mismatch interval.
+     * @param end is the time when the values became equal, ULONG_MAX if
+     * they differ until the end of the files.
+     */
+    static void print_interval(std::ostream&out, const Link&link,
+            unsigned long start, unsigned long end,
+            const std::string&value1, const std::string&value2);
 
     std::list<Link*> links_;
-    VcdFile&file1_;
-    VcdFile&file2_;
+    WaveFile&file1_;
+    WaveFile&file2_;
+
+    Stats stats_;
+
+    // Comparison results indexed by Link::id(), collected with --profile
+    std::vector<LinkProfile> link_profile_;
+
+    // Set when unlinked variables have been dropped to save memory
+    bool dropped_unlinked_;
+
+    // Set for the partitioned windows, the main Comparator has already
+    // reported the mapping results
+    bool quiet_mapping_;
+
+    // Set when --structure has reported a difference
+    bool structure_differs_;
+
+    // Records the mapping results when it is going to be cached
+    MappingCache*map_cache_;
+
+    // Pairs read from the mapping file, shared with the partitioned windows
+    std::shared_ptr<const NameMapping> name_mapping_;
+
+    // Mapping file entries with variables found in both files
+    std::vector<bool> listed_;
+
+    // Recent values of the compared links, printed with differences (--context)
+    std::unique_ptr<ValueHistory> history_;
+
+    // Differences saved to the database file instead of printing them (--db)
+    std::unique_ptr<DiffDbWriter> db_;
+
+    // Mismatch intervals indexed by Link::id() (--intervals)
+    std::vector<MismatchInterval> intervals_;
+
+    // Differences counted instead of printing them, indexed by Link::id() (--summary)
+    std::vector<LinkSummary> link_summary_;
 };
 
 #endif /* COMPARATOR_H */
@@ -0,0 +1,496 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "diffdb.h"
+#include "columns.h"
+#include "link.h"
+#include "variable.h"
+#include "wavefile.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const char DIFFDB_MAGIC[8] = { 'V', 'C', 'D', 'I', 'F', 'F', 'D', 'B' };
+static const uint32_t DIFFDB_VERSION = 1;
+
+// File layout: header, records, signals, index, values, strings. Sections
+// are aligned to 8 bytes, strings are referred to by their offsets in
+// the strings section.
+struct DiffDbReader::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+
+    // Differences sorted by time, in the order they would be printed
+    uint64_t records, records_offset;
+
+    // Signals sorted by name
+    uint64_t signals, signals_offset;
+
+    // Record numbers grouped by signal, sorted within each group
+    uint64_t index_offset;
+
+    // Offsets of the value pairs in the strings section
+    uint64_t values, values_offset;
+
+    uint64_t strings_size, strings_offset;
+};
+
+struct DiffDbReader::Signal {
+    // Name without the file, names as printed for both files
+    uint64_t key, name1, name2;
+
+    // Range of the signal records in the index
+    uint64_t first, count;
+};
+
+struct DiffDbReader::Record {
+    uint64_t time;
+    uint32_t signal;
+    uint32_t value;
+};
+
+static inline uint64_t align8(uint64_t offset) {
+    return (offset + 7) & ~7ULL;
+}
+
+// Number of records kept in memory before they are moved to a temporary file
+static const unsigned int RECORD_BUFFER = 65536;
+
+DiffDbWriter::DiffDbWriter()
+    : spill_file_(NULL), spilled_(0), in_memory_(false), failed_(false) {
+}
+
+DiffDbWriter::~DiffDbWriter() {
+    if(spill_file_)
+        fclose(spill_file_);
+}
+
+uint32_t DiffDbWriter::value_index(const string&values) {
+    auto res = value_indexes_.insert(make_pair(values, (uint32_t) values_.size()));
+
+    if(res.second)
+        values_.push_back(&res.first->first);
+
+    return res.first->second;
+}
+
+void DiffDbWriter::add(unsigned long time, unsigned int link,
+        const string&value1, const string&value2) {
+    string values(value1);
+    values += '\0';
+    values += value2;
+    values += '\0';
+
+    Record record;
+    record.time = time;
+    record.link = link;
+    record.value = value_index(values);
+    add_record(record);
+}
+
+void DiffDbWriter::append(const DiffDbWriter&other) {
+    vector<uint32_t> remap(other.values_.size());
+
+    for(unsigned int i = 0; i < other.values_.size(); ++i)
+        remap[i] = value_index(*other.values_[i]);
+
+    bool ok = other.for_each_record([this, &remap](const Record&record) {
+            Record copy = record;
+            copy.value = remap[record.value];
+            add_record(copy);
+        });
+
+    if(!ok || other.failed_)
+        failed_ = true;
+}
+
+void DiffDbWriter::add_record(const Record&record) {
+    if(record.link >= counts_.size())
+        counts_.resize(record.link + 1, 0);
+
+    ++counts_[record.link];
+    records_.push_back(record);
+
+    if(records_.size() >= RECORD_BUFFER && !in_memory_)
+        spill();
+}
+
+void DiffDbWriter::spill() {
+    if(!spill_file_) {
+        int fd = open_temp_file();
+
+        if(fd >= 0 && !(spill_file_ = fdopen(fd, "w+b")))
+            close(fd);
+    }
+
+    // Reading the records moves the file position. Records that could not
+    // be written are not counted, so they are never read back.
+    if(!spill_file_ || fseek(spill_file_, 0, SEEK_END) != 0
+            || fwrite(records_.data(), sizeof(Record), records_.size(),
+                spill_file_) != records_.size()) {
+        cerr << "Warning: Could not write a temporary file, "
+            "differences are kept in memory." << endl;
+
+        // Do not try again
+        in_memory_ = true;
+        return;
+    }
+
+    spilled_ += records_.size();
+    records_.clear();
+}
+
+bool DiffDbWriter::for_each_record(const function<void(const Record&)>&func) const {
+    if(spill_file_) {
+        vector<Record> buffer(RECORD_BUFFER);
+
+        if(fflush(spill_file_) != 0 || fseek(spill_file_, 0, SEEK_SET) != 0)
+            return false;
+
+        for(uint64_t left = spilled_; left > 0; ) {
+            size_t count = min<uint64_t>(left, buffer.size());
+
+            if(fread(buffer.data(), sizeof(Record), count, spill_file_) != count)
+                return false;
+
+            for(size_t i = 0; i < count; ++i)
+                func(buffer[i]);
+
+            left -= count;
+        }
+    }
+
+    for(const Record&record : records_)
+        func(record);
+
+    return true;
+}
+
+bool DiffDbWriter::save(const string&path, const list<Link*>&links,
+        const WaveFile&file1, const WaveFile&file2) const {
+    typedef DiffDbReader::Header Header;
+    typedef DiffDbReader::Signal Signal;
+    typedef DiffDbReader::Record FileRecord;
+
+    const uint64_t total = spilled_ + records_.size();
+
+    if(failed_ || total > UINT32_MAX)
+        return false;
+
+    // Only signals that have differences are stored
+    struct SignalInfo {
+        string key, name1, name2;
+        unsigned int link;
+    };
+
+    vector<SignalInfo> infos;
+    const string root_prefix = file1.root_scope().full_name() + ".";
+
+    for(const Link*link : links) {
+        if(link->id() >= counts_.size() || counts_[link->id()] == 0)
+            continue;
+
+        stringstream name1, name2;
+        name1 << *link->first();
+        name2 << *link->second();
+
+        SignalInfo info;
+        info.name1 = name1.str();
+        info.name2 = name2.str();
+        info.key = info.name1.compare(0, root_prefix.size(), root_prefix) == 0
+            ? info.name1.substr(root_prefix.size()) : info.name1;
+        info.link = link->id();
+        infos.push_back(info);
+    }
+
+    sort(infos.begin(), infos.end(), [](const SignalInfo&a, const SignalInfo&b) {
+            return a.key != b.key ? a.key < b.key : a.link < b.link;
+        });
+
+    // Strings, signals and their positions in the index
+    string strings;
+    vector<Signal> signals(infos.size());
+    vector<uint32_t> signal_idx(counts_.size(), 0);
+    uint64_t first = 0;
+
+    auto add_string = [&strings](const string&str) {
+        uint64_t offset = strings.size();
+        strings.append(str);
+        strings += '\0';
+        return offset;
+    };
+
+    for(unsigned int i = 0; i < infos.size(); ++i) {
+        Signal&signal = signals[i];
+        signal.key = add_string(infos[i].key);
+        signal.name1 = add_string(infos[i].name1);
+        signal.name2 = add_string(infos[i].name2);
+        signal.first = first;
+        signal.count = counts_[infos[i].link];
+        first += signal.count;
+        signal_idx[infos[i].link] = i;
+    }
+
+    if(first != total)
+        return false;       // differences of unknown links
+
+    vector<uint64_t> values(values_.size());
+
+    for(unsigned int i = 0; i < values_.size(); ++i) {
+        values[i] = strings.size();
+        strings.append(*values_[i]);
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DIFFDB_MAGIC, sizeof(header.magic));
+    header.version = DIFFDB_VERSION;
+    header.records = total;
+    header.records_offset = align8(sizeof(Header));
+    header.signals = signals.size();
+    header.signals_offset = align8(header.records_offset + total * sizeof(FileRecord));
+    header.index_offset = align8(header.signals_offset + signals.size() * sizeof(Signal));
+    header.values = values.size();
+    header.values_offset = align8(header.index_offset + total * sizeof(uint32_t));
+    header.strings_size = strings.size();
+    header.strings_offset = align8(header.values_offset + values.size() * sizeof(uint64_t));
+
+    // Records are read back one chunk at a time, but the index is filled
+    // in a random order, so the file is written through a memory mapping
+    const uint64_t size = align8(header.strings_offset + strings.size());
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+
+    if(fd < 0)
+        return false;
+
+    // Allocating the space up front avoids SIGBUS when the disk is full
+    if(posix_fallocate(fd, 0, size) != 0) {
+        close(fd);
+        return false;
+    }
+
+    void*mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(mapped == MAP_FAILED)
+        return false;
+
+    char*data = (char*) mapped;
+    memcpy(data, &header, sizeof(header));
+    memcpy(data + header.signals_offset, signals.data(), signals.size() * sizeof(Signal));
+    memcpy(data + header.values_offset, values.data(), values.size() * sizeof(uint64_t));
+    memcpy(data + header.strings_offset, strings.data(), strings.size());
+
+    // Records and the per-signal index
+    FileRecord*records = (FileRecord*) (data + header.records_offset);
+    uint32_t*index = (uint32_t*) (data + header.index_offset);
+    vector<uint64_t> fill(signals.size());
+    uint32_t idx = 0;
+
+    for(unsigned int i = 0; i < signals.size(); ++i)
+        fill[i] = signals[i].first;
+
+    bool ok = for_each_record([&](const Record&record) {
+            uint32_t signal = signal_idx[record.link];
+            records[idx].time = record.time;
+            records[idx].signal = signal;
+            records[idx].value = record.value;
+            index[fill[signal]++] = idx++;
+        });
+
+    return (munmap(mapped, size) == 0) && ok;
+}
+
+DiffDbReader::DiffDbReader()
+    : data_(NULL), size_(0), header_(NULL), signals_(NULL), records_(NULL),
+    index_(NULL), values_(NULL) {
+}
+
+DiffDbReader::~DiffDbReader() {
+    if(data_)
+        munmap((void*) data_, size_);
+}
+
+bool DiffDbReader::open(const string&path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+
+    if(fd < 0)
+        return false;
+
+    if(fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(Header)) {
+        close(fd);
+        return false;
+    }
+
+    void*data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(data == MAP_FAILED)
+        return false;
+
+    data_ = (const char*) data;
+    size_ = st.st_size;
+    header_ = (const Header*) data_;
+
+    if(memcmp(header_->magic, DIFFDB_MAGIC, sizeof(DIFFDB_MAGIC)) != 0
+            || header_->version != DIFFDB_VERSION)
+        return false;
+
+    // Sections have to be within the file, strings have to be terminated
+    const uint64_t ends[] = {
+        header_->records_offset + header_->records * sizeof(Record),
+        header_->signals_offset + header_->signals * sizeof(Signal),
+        header_->index_offset + header_->records * sizeof(uint32_t),
+        header_->values_offset + header_->values * sizeof(uint64_t),
+        header_->strings_offset + header_->strings_size
+    };
+
+    for(uint64_t end : ends) {
+        if(end > size_)
+            return false;
+    }
+
+    if(header_->strings_size > 0 && data_[header_->strings_offset
+            + header_->strings_size - 1] != '\0')
+        return false;
+
+    records_ = (const Record*) (data_ + header_->records_offset);
+    signals_ = (const Signal*) (data_ + header_->signals_offset);
+    index_ = (const uint32_t*) (data_ + header_->index_offset);
+    values_ = (const uint64_t*) (data_ + header_->values_offset);
+
+    return true;
+}
+
+const char*DiffDbReader::string_at(uint64_t offset) const {
+    return offset < header_->strings_size ?
+        data_ + header_->strings_offset + offset : "";
+}
+
+vector<uint64_t> DiffDbReader::find_signals(const string&signal,
+        const string&scope) const {
+    vector<uint64_t> found;
+    const Signal*begin = signals_;
+    const Signal*end = signals_ + header_->signals;
+
+    if(!signal.empty() && !scope.empty()
+            && signal.compare(0, scope.size() + 1, scope + ".") != 0)
+        return found;
+
+    // Names sharing a prefix (variables in a scope, a variable with
+    // different ranges) are stored next to each other
+    const string prefix = signal.empty() ? scope + "." : signal;
+    const Signal*it = lower_bound(begin, end, prefix,
+            [this](const Signal&s, const string&key) {
+                return strcmp(string_at(s.key), key.c_str()) < 0;
+            });
+
+    for(; it != end; ++it) {
+        const char*name = string_at(it->key);
+
+        if(strncmp(name, prefix.c_str(), prefix.size()) != 0)
+            break;
+
+        // A name without the range matches the name with any range
+        if(signal.empty() || name[prefix.size()] == '\0' || name[prefix.size()] == '[')
+            found.push_back(it - begin);
+    }
+
+    return found;
+}
+
+bool DiffDbReader::contains(const string&signal) const {
+    return !find_signals(signal, string()).empty();
+}
+
+unsigned long DiffDbReader::query(const string&signal, const string&scope,
+        unsigned long from, unsigned long to, ostream&out) const {
+    vector<uint32_t> found;
+
+    auto time_less = [this](uint32_t idx, unsigned long time) {
+        return records_[idx].time < time;
+    };
+
+    if(signal.empty() && scope.empty()) {
+        // Records are sorted by time
+        const Record*end = records_ + header_->records;
+        const Record*it = lower_bound(records_, end, from,
+                [](const Record&r, unsigned long time) { return r.time < time; });
+
+        for(; it != end && it->time <= to; ++it)
+            found.push_back(it - records_);
+
+    } else {
+        for(uint64_t i : find_signals(signal, scope)) {
+            const Signal&s = signals_[i];
+
+            if(s.first + s.count > header_->records)
+                continue;
+
+            const uint32_t*end = index_ + s.first + s.count;
+            const uint32_t*it = lower_bound(index_ + s.first, end, from, time_less);
+
+            for(; it != end && *it < header_->records && records_[*it].time <= to; ++it)
+                found.push_back(*it);
+        }
+
+        // Restore the output order
+        sort(found.begin(), found.end());
+    }
+
+    bool header = false;
+    unsigned long last_time = 0;
+
+    for(uint32_t idx : found) {
+        const Record&record = records_[idx];
+
+        if(record.signal >= header_->signals || record.value >= header_->values)
+            continue;
+
+        if(!header || record.time != last_time) {
+            out << "diff #" << record.time << endl;
+            out << "==================" << endl;
+            last_time = record.time;
+            header = true;
+        }
+
+        const Signal&s = signals_[record.signal];
+        // Both values are stored one after another
+        uint64_t offset = values_[record.value];
+        const char*value1 = string_at(offset);
+        const char*value2 = string_at(offset + strlen(value1) + 1);
+
+        Link::print(out, string_at(s.name1), string_at(s.name2), value1, value2);
+        out << endl;
+    }
+
+    return found.size();
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DIFFDB_H
+#define DIFFDB_H
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <list>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Link;
+class WaveFile;
+
+/**
+ * @brief Collects the differences and saves them in a binary file (--db),
+ * indexed by signals and time, so they might be queried with DiffDbReader.
+ *
+ * Differences are stored in the order they would be printed. Each one
+ * refers to a pair of formatted values, which are shared by all differences
+ * with the same values. Only a limited number of differences is kept in
+ * memory, the rest are moved to a temporary file until the database is saved.
+ */
+class DiffDbWriter {
+public:
+    DiffDbWriter();
+    ~DiffDbWriter();
+
+    /**
+     * @param link is the link index (see Link::id()).
+     * @param value1 and value2 are formatted as in the regular output.
+     */
+    void add(unsigned long time, unsigned int link,
+            const std::string&value1, const std::string&value2);
+
+    /**
+     * @brief Appends differences collected by another writer, using
+     * the same link indexes.
+     */
+    void append(const DiffDbWriter&other);
+
+    /**
+     * @brief Writes the database file.
+     * @param links are the compared links, used to name the signals.
+     */
+    bool save(const std::string&path, const std::list<Link*>&links,
+            const WaveFile&file1, const WaveFile&file2) const;
+
+private:
+    struct Record {
+        uint64_t time;
+        uint32_t link;
+        uint32_t value;
+    };
+
+    // Returns the index of a pair of values, adding it if needed
+    uint32_t value_index(const std::string&values);
+
+    void add_record(const Record&record);
+
+    // Moves the buffered records to the temporary file
+    void spill();
+
+    // Calls a function for every record, in the order they were added
+    bool for_each_record(const std::function<void(const Record&)>&func) const;
+
+    // Records not moved to the temporary file yet
+    std::vector<Record> records_;
+
+    // Temporary file with the records added first
+    FILE*spill_file_;
+    uint64_t spilled_;
+
+    // Set if the temporary file could not be written or read
+    bool in_memory_, failed_;
+
+    // Number of records for each link
+    std::vector<uint64_t> counts_;
+
+    // Pairs of values stored as "value1\0value2\0"
+    std::unordered_map<std::string, uint32_t> value_indexes_;
+    std::vector<const std::string*> values_;
+};
+
+/**
+ * @brief Answers queries on a file saved by DiffDbWriter. The file is mapped
+ * to memory, so only the parts of indexes needed by a query are read.
+ */
+class DiffDbReader {
+public:
+    DiffDbReader();
+    ~DiffDbReader();
+
+    /**
+     * @return false if the file cannot be read or it is not a database.
+     */
+    bool open(const std::string&path);
+
+    /**
+     * @brief Checks if there are differences stored for a variable.
+     * @param signal is the name of a variable, as accepted by query().
+     */
+    bool contains(const std::string&signal) const;
+
+    /**
+     * @brief Prints the differences in the same format as the regular output.
+     * @param signal is the hierarchical name of a variable in the first file
+     * (e.g. top.uut.cnt), empty to accept all variables. The range may be
+     * omitted, then the name matches all variables with any range.
+     * @param scope accepts only variables in a scope and its subscopes, empty
+     * to accept all variables.
+     * @param from and to limit the time range (inclusive).
+     * @return Number of printed differences.
+     */
+    unsigned long query(const std::string&signal, const std::string&scope,
+            unsigned long from, unsigned long to, std::ostream&out) const;
+
+private:
+    // Returns indexes of the signals matching the filters
+    std::vector<uint64_t> find_signals(const std::string&signal,
+            const std::string&scope) const;
+
+    // Returns a NUL-terminated string stored in the file
+    const char*string_at(uint64_t offset) const;
+
+    const char*data_;
+    size_t size_;
+
+    // File layout, shared with the writer
+    friend class DiffDbWriter;
+    struct Header;
+    struct Signal;
+    struct Record;
+
+    const Header*header_;
+    const Signal*signals_;
+    const Record*records_;
+    const uint32_t*index_;
+    const uint64_t*values_;
+};
+
+#endif /* DIFFDB_H */
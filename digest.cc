@@ -0,0 +1,375 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "digest.h"
+#include "link.h"
+#include "options.h"
+#include "progress.h"
+#include "rewrite.h"
+#include "scope.h"
+#include "trace.h"
+#include "wavefile.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <unordered_map>
+
+#include <sys/stat.h>
+
+using namespace std;
+
+static const char DIGEST_MAGIC[] = "vcdiff-digest 2";
+
+// Mixes a value into a hash (splitmix64 finalizer)
+static inline uint64_t mix(uint64_t hash, uint64_t value) {
+    hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+    return hash;
+}
+
+// FNV-1a, the result has to be the same in every run
+static uint64_t string_hash(const string&str) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for(char c : str) {
+        hash ^= (unsigned char) c;
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+Digest::Digest(unsigned long bucket)
+    : bucket_(bucket), timescale_(0) {
+}
+
+uint64_t Digest::Signal::root() const {
+    return levels.empty() ? 0 : levels.back()[0].second;
+}
+
+uint64_t Digest::Signal::node(unsigned int level, uint64_t index) const {
+    // Levels above the root repeat it, so trees of different heights
+    // might be compared
+    if(level >= levels.size())
+        return index == 0 ? root() : 0;
+
+    const Level&nodes = levels[level];
+    Level::const_iterator it = lower_bound(nodes.begin(), nodes.end(),
+            make_pair(index, (uint64_t) 0));
+
+    return (it != nodes.end() && it->first == index) ? it->second : 0;
+}
+
+void Digest::Signal::build_tree() {
+    levels.resize(1);
+
+    if(levels[0].empty()) {
+        levels.clear();
+        return;
+    }
+
+    // Buckets without changes are skipped, a node with a single left child
+    // has the same hash as the child
+    while(levels.back().size() > 1 || levels.back()[0].first != 0) {
+        const Level&children = levels.back();
+        Level parents;
+
+        for(unsigned int i = 0; i < children.size(); ++i) {
+            uint64_t index = children[i].first / 2;
+            uint64_t left = 0, right = 0;
+
+            if(children[i].first % 2 == 0) {
+                left = children[i].second;
+
+                if(i + 1 < children.size() && children[i + 1].first == children[i].first + 1)
+                    right = children[++i].second;
+            } else {
+                right = children[i].second;
+            }
+
+            parents.push_back(make_pair(index, right ? mix(mix(0, left), right) : left));
+        }
+
+        levels.push_back(parents);
+    }
+}
+
+void Digest::add_signal(Variable*var, const string&prefix, NamedVars&vars) {
+    // Value changes are reported for variables with identifiers
+    if(!var->ident().empty()) {
+        // Aliases share the value changes with their targets
+        Alias*alias = dynamic_cast<Alias*>(var);
+        vars.push_back(make_pair(prefix + var->full_name(),
+                    alias ? alias->target() : var));
+
+    } else if(Vector*vec = dynamic_cast<Vector*>(var)) {
+        for(int i = vec->min_idx(); i <= vec->max_idx(); ++i)
+            add_signal((*vec)[i], prefix, vars);
+    }
+}
+
+void Digest::add_signals(Scope&scope, const string&prefix, NamedVars&vars) {
+    for(auto&subscope : scope.scopes())
+        add_signals(*subscope.second, prefix + *subscope.first + ".", vars);
+
+    for(auto&var : scope.variables())
+        add_signal(var.second, prefix, vars);
+}
+
+void Digest::compute(WaveFile&file, unsigned int index) {
+    TRACE_SCOPE("digest", "\"file\":\"" + file.filename() + "\"");
+
+    NamedVars named;
+    add_signals(file.root_scope(), "", named);
+    timescale_ = file.timescale();
+
+    // Each variable is linked once, even if it is a target of many aliases
+    vector<Variable*> vars;
+    vector<unsigned int> var_ids;
+    unordered_map<const Variable*, unsigned int> ids;
+
+    for(const auto&entry : named) {
+        auto res = ids.insert(make_pair(entry.second, (unsigned int) vars.size()));
+
+        if(res.second)
+            vars.push_back(entry.second);
+
+        var_ids.push_back(res.first->second);
+    }
+
+    // Links to the variables themselves make the file report the changes
+    vector<unique_ptr<Link> > links;
+    vector<uint64_t> last_values;
+    vector<Level> leaves(vars.size());
+
+    for(unsigned int i = 0; i < vars.size(); ++i) {
+        Variable*var = vars[i];
+        links.push_back(unique_ptr<Link>(new Link(var, var)));
+        links.back()->set_id(i);
+        var->set_link(links.back().get());
+        last_values.push_back(string_hash(var->value_str()));
+    }
+
+    ProgressSlot progress(file, index);
+    bool file_ok = file.valid();
+
+    while(file_ok) {
+        unsigned long current_time = file.next_timestamp();
+        uint64_t bucket = current_time / bucket_;
+        set<const Link*> changes;
+
+        progress.update(current_time);
+        file_ok = file.next_delta(changes);
+
+        for(const Link*link : changes) {
+            Variable*var = link->first();
+            uint64_t value = string_hash(var->value_str());
+            var->clear_transition();
+
+            // Repeated values are not changes
+            if(value == last_values[link->id()])
+                continue;
+
+            last_values[link->id()] = value;
+            Level&var_leaves = leaves[link->id()];
+
+            if(var_leaves.empty() || var_leaves.back().first != bucket)
+                var_leaves.push_back(make_pair(bucket, (uint64_t) 0));
+
+            var_leaves.back().second = mix(var_leaves.back().second,
+                    mix(current_time, value));
+        }
+    }
+
+    for(unsigned int i = 0; i < named.size(); ++i) {
+        Signal&signal = signals_[named[i].first];
+        signal.levels.assign(1, leaves[var_ids[i]]);
+        signal.build_tree();
+    }
+}
+
+uint64_t Digest::names_key() {
+    string options;
+
+    options += ignore_case ? 'c' : '-';
+    options += skip_module ? 'm' : '-';
+    options += skip_function ? 'f' : '-';
+    options += skip_task ? 't' : '-';
+
+    for(const auto&rule : rewrite_rules.rules()) {
+        options += '\0' + rule.first;
+        options += '\0' + rule.second;
+    }
+
+    return string_hash(options);
+}
+
+bool Digest::file_id(const string&dump, unsigned long&size, unsigned long&mtime) {
+    struct stat st;
+
+    if(stat(dump.c_str(), &st) != 0)
+        return false;
+
+    size = st.st_size;
+    mtime = st.st_mtime;
+    return true;
+}
+
+bool Digest::load(const string&dump) {
+    ifstream file(sidecar_name(dump));
+    unsigned long size, mtime, stored_size, stored_mtime, bucket, count;
+    uint64_t key;
+    string line;
+
+    if(!file_id(dump, size, mtime) || !getline(file, line) || line != DIGEST_MAGIC)
+        return false;
+
+    if(!(file >> stored_size >> stored_mtime >> bucket >> hex >> key >> dec
+                >> timescale_ >> count)
+            || stored_size != size || stored_mtime != mtime || bucket != bucket_
+            || key != names_key())
+        return false;
+
+    signals_.clear();
+
+    for(unsigned long i = 0; i < count; ++i) {
+        unsigned long leaves;
+        string name;
+
+        if(!(file >> leaves) || !getline(file >> ws, name))
+            return false;
+
+        Signal&signal = signals_[name];
+        signal.levels.resize(1);
+
+        for(unsigned long j = 0; j < leaves; ++j) {
+            uint64_t index, hash;
+
+            if(!(file >> index >> hex >> hash >> dec))
+                return false;
+
+            signal.levels[0].push_back(make_pair(index, hash));
+        }
+
+        signal.build_tree();
+    }
+
+    return true;
+}
+
+bool Digest::save(const string&dump) const {
+    unsigned long size, mtime;
+
+    if(!file_id(dump, size, mtime))
+        return false;
+
+    FILE*file = fopen(sidecar_name(dump).c_str(), "w");
+
+    if(!file)
+        return false;
+
+    fprintf(file, "%s\n%lu %lu %lu %" PRIx64 " %d %lu\n", DIGEST_MAGIC, size,
+            mtime, bucket_, names_key(), timescale_, (unsigned long) signals_.size());
+
+    for(const auto&signal : signals_) {
+        const Level*leaves = signal.second.levels.empty() ? NULL : &signal.second.levels[0];
+
+        fprintf(file, "%lu %s\n", leaves ? (unsigned long) leaves->size() : 0,
+                signal.first.c_str());
+
+        if(leaves) {
+            for(const auto&leaf : *leaves)
+                fprintf(file, "%" PRIu64 " %" PRIx64 "\n", leaf.first, leaf.second);
+        }
+    }
+
+    return fclose(file) == 0;
+}
+
+uint64_t Digest::bisect(const Signal&signal1, const Signal&signal2) {
+    unsigned int level = max(signal1.levels.size(), signal2.levels.size());
+    uint64_t index = 0;
+
+    // Descend to the left child if it differs, otherwise the right one does
+    while(level-- > 1) {
+        uint64_t left = 2 * index;
+        index = (signal1.node(level - 1, left) != signal2.node(level - 1, left))
+            ? left : left + 1;
+    }
+
+    return index;
+}
+
+unsigned int Digest::compare(const Digest&digest1, const Digest&digest2,
+        const string&file1, const string&file2, ostream&out, ostream&err) {
+    map<string, Signal>::const_iterator it1 = digest1.signals_.begin();
+    map<string, Signal>::const_iterator it2 = digest2.signals_.begin();
+    unsigned int mismatches = 0;
+
+    while(it1 != digest1.signals_.end() || it2 != digest2.signals_.end()) {
+        int comp_name;
+
+        if(it1 == digest1.signals_.end())
+            comp_name = 1;
+        else if(it2 == digest2.signals_.end())
+            comp_name = -1;
+        else
+            comp_name = it1->first.compare(it2->first);
+
+        if(comp_name < 0) {
+            if(warn_missing_vars) {
+                err << "Warning: There is no variable '" << it1->first
+                    << "' in " << file2 << "." << endl;
+            }
+
+            ++it1;
+            continue;
+        }
+
+        if(comp_name > 0) {
+            if(warn_missing_vars) {
+                err << "Warning: There is no variable '" << it2->first
+                    << "' in " << file1 << "." << endl;
+            }
+
+            ++it2;
+            continue;
+        }
+
+        if(it1->second.root() != it2->second.root()) {
+            uint64_t bucket = bisect(it1->second, it2->second);
+
+            out << it1->first << ": first difference between #"
+                << bucket * digest1.bucket_ << " and #"
+                << (bucket + 1) * digest1.bucket_ - 1 << endl;
+            ++mismatches;
+        }
+
+        ++it1;
+        ++it2;
+    }
+
+    return mismatches;
+}
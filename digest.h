@@ -0,0 +1,121 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DIGEST_H
+#define DIGEST_H
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Scope;
+class Variable;
+class WaveFile;
+
+/**
+ * @brief Per-signal hashes of value changes, organised as a tree of time
+ * buckets. Digests of two files are compared signal by signal and the
+ * mismatching ones are bisected down to the first differing bucket.
+ *
+ * Digests depend only on the (time, value) changes, so they might be
+ * stored in sidecar files and reused as long as the dump and the options
+ * that modify signal names do not change. Aliases get the digests of their
+ * targets.
+ */
+class Digest {
+public:
+    /**
+     * @param bucket is the width of the leaf time buckets.
+     */
+    Digest(unsigned long bucket);
+
+    /**
+     * @brief Reads all value changes of a file with parsed header. The file
+     * cannot be compared in the regular way afterwards.
+     * @param index is the file number used in progress reports.
+     */
+    void compute(WaveFile&file, unsigned int index);
+
+    /**
+     * @brief Loads a digest from the sidecar file of a dump.
+     * @return false if there is no sidecar or it is out of date.
+     */
+    bool load(const std::string&dump);
+
+    /**
+     * @brief Saves the digest to the sidecar file of a dump.
+     */
+    bool save(const std::string&dump) const;
+
+    static inline std::string sidecar_name(const std::string&dump) {
+        return dump + ".digest";
+    }
+
+    inline int timescale() const {
+        return timescale_;
+    }
+
+    /**
+     * @brief Compares two digests, prints the mismatching signals together
+     * with the time range containing their first difference.
+     * @return Number of mismatching signals.
+     */
+    static unsigned int compare(const Digest&digest1, const Digest&digest2,
+            const std::string&file1, const std::string&file2,
+            std::ostream&out, std::ostream&err);
+
+private:
+    ///> Tree nodes of a level, pairs of (node index, hash) sorted by index
+    typedef std::vector<std::pair<uint64_t, uint64_t> > Level;
+
+    struct Signal {
+        // Level 0 stores the leaf buckets, the last one stores the root
+        std::vector<Level> levels;
+
+        uint64_t root() const;
+        uint64_t node(unsigned int level, uint64_t index) const;
+
+        void build_tree();
+    };
+
+    // Pairs of (signal name, variable reporting its value changes)
+    typedef std::vector<std::pair<std::string, Variable*> > NamedVars;
+
+    void add_signals(Scope&scope, const std::string&prefix, NamedVars&vars);
+    void add_signal(Variable*var, const std::string&prefix, NamedVars&vars);
+
+    // Size and modification time of the dump, to detect outdated sidecars
+    static bool file_id(const std::string&dump,
+            unsigned long&size, unsigned long&mtime);
+
+    // Hash of the options that modify signal names (case, skipped scopes,
+    // rewrite rules), sidecars made with other options are outdated
+    static uint64_t names_key();
+
+    // Returns the first leaf bucket that differs
+    static uint64_t bisect(const Signal&signal1, const Signal&signal2);
+
+    unsigned long bucket_;
+    int timescale_;
+    std::map<std::string, Signal> signals_;
+};
+
+#endif /* DIGEST_H */
@@ -0,0 +1,216 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "fuzzy.h"
+#include "options.h"
+#include "variable.h"
+
+#include <algorithm>
+#include <cctype>
+#include <tuple>
+
+using namespace std;
+
+// Minimal similarity (Dice coefficient of the trigram sets) of paired names
+static const double MIN_SIMILARITY = 0.6;
+
+// Number of index entries visited per name, the rarest trigrams come first
+static const unsigned int SCAN_LIMIT = 4096;
+
+// Number of names sharing the most trigrams that are compared exactly
+static const unsigned int BEST_CANDIDATES = 8;
+
+static inline uint64_t posting_key(unsigned int group, uint32_t trigram) {
+    return ((uint64_t) group << 24) | trigram;
+}
+
+// Dice coefficient of sorted sets
+static double similarity(const vector<uint32_t>&a, const vector<uint32_t>&b) {
+    unsigned int common = 0;
+    auto it_a = a.begin(), it_b = b.begin();
+
+    while(it_a != a.end() && it_b != b.end()) {
+        if(*it_a < *it_b) {
+            ++it_a;
+        } else if(*it_b < *it_a) {
+            ++it_b;
+        } else {
+            ++common;
+            ++it_a;
+            ++it_b;
+        }
+    }
+
+    return a.empty() && b.empty() ? 1.0 : 2.0 * common / (a.size() + b.size());
+}
+
+unsigned int FuzzyMatcher::group(const Variable*var) {
+    auto key = make_pair(var->size(), ignore_var_type ? -1 : (int) var->type());
+    auto res = groups_.insert(make_pair(key, groups_.size()));
+
+    return res.first->second;
+}
+
+void FuzzyMatcher::add(unsigned int file, Variable*var, const string&name) {
+    Candidate cand;
+    cand.var = var;
+    cand.group = group(var);
+
+    for(char c : name) {
+        if(c != '_')
+            cand.name += tolower(c);
+    }
+
+    // Padding marks the beginning and the end of the name
+    string padded = "\x01\x01" + cand.name + "\x02";
+
+    for(unsigned int i = 0; i + 2 < padded.size(); ++i) {
+        cand.trigrams.push_back(((unsigned char) padded[i] << 16)
+                | ((unsigned char) padded[i + 1] << 8) | (unsigned char) padded[i + 2]);
+    }
+
+    sort(cand.trigrams.begin(), cand.trigrams.end());
+    cand.trigrams.erase(unique(cand.trigrams.begin(), cand.trigrams.end()),
+            cand.trigrams.end());
+
+    candidates_[file].push_back(cand);
+}
+
+bool FuzzyMatcher::find_similar(const Candidate&cand, unsigned int&index, double&score) {
+    vector<const vector<unsigned int>*> lists;
+    vector<unsigned int> touched;
+
+    for(uint32_t trigram : cand.trigrams) {
+        auto it = postings_.find(posting_key(cand.group, trigram));
+
+        if(it != postings_.end())
+            lists.push_back(&it->second);
+    }
+
+    // Rare trigrams tell more about the similarity, common ones are
+    // visited only if the limit allows
+    sort(lists.begin(), lists.end(),
+            [](const vector<unsigned int>*a, const vector<unsigned int>*b) {
+                return a->size() < b->size();
+            });
+
+    unsigned int scanned = 0;
+
+    for(const vector<unsigned int>*list : lists) {
+        for(unsigned int idx : *list) {
+            if(shared_[idx]++ == 0)
+                touched.push_back(idx);
+
+            if(++scanned == SCAN_LIMIT)
+                break;
+        }
+
+        if(scanned == SCAN_LIMIT)
+            break;
+    }
+
+    // Names sharing the most trigrams are compared exactly
+    auto more_shared = [&](unsigned int a, unsigned int b) {
+        return shared_[a] != shared_[b] ? shared_[a] > shared_[b] : a < b;
+    };
+    unsigned int best_count = min<size_t>(BEST_CANDIDATES, touched.size());
+    partial_sort(touched.begin(), touched.begin() + best_count, touched.end(), more_shared);
+
+    score = 0.0;
+
+    for(unsigned int i = 0; i < best_count; ++i) {
+        double sim = similarity(cand.trigrams, candidates_[1][touched[i]].trigrams);
+
+        if(sim > score) {
+            score = sim;
+            index = touched[i];
+        }
+    }
+
+    for(unsigned int idx : touched)
+        shared_[idx] = 0;
+
+    return score >= MIN_SIMILARITY;
+}
+
+vector<pair<Variable*, Variable*> > FuzzyMatcher::match() {
+    vector<Candidate>&cands1 = candidates_[0];
+    vector<Candidate>&cands2 = candidates_[1];
+    vector<bool> paired1(cands1.size()), paired2(cands2.size());
+    vector<pair<unsigned int, unsigned int> > pairs;
+
+    // Equal normalized names, the variables are paired in the file order
+    unordered_map<string, vector<unsigned int> > names2;
+
+    for(unsigned int i = cands2.size(); i-- > 0;)
+        names2[to_string(cands2[i].group) + ":" + cands2[i].name].push_back(i);
+
+    for(unsigned int i = 0; i < cands1.size(); ++i) {
+        auto it = names2.find(to_string(cands1[i].group) + ":" + cands1[i].name);
+
+        if(it == names2.end() || it->second.empty())
+            continue;
+
+        pairs.push_back(make_pair(i, it->second.back()));
+        paired1[i] = paired2[it->second.back()] = true;
+        it->second.pop_back();
+    }
+
+    // Index trigrams of the remaining names
+    for(unsigned int i = 0; i < cands2.size(); ++i) {
+        if(paired2[i])
+            continue;
+
+        for(uint32_t trigram : cands2[i].trigrams)
+            postings_[posting_key(cands2[i].group, trigram)].push_back(i);
+    }
+
+    shared_.assign(cands2.size(), 0);
+
+    // The most similar pairs are taken first: (-similarity, index1, index2)
+    vector<tuple<double, unsigned int, unsigned int> > proposals;
+
+    for(unsigned int i = 0; i < cands1.size(); ++i) {
+        unsigned int index;
+        double score;
+
+        if(!paired1[i] && find_similar(cands1[i], index, score))
+            proposals.push_back(make_tuple(-score, i, index));
+    }
+
+    sort(proposals.begin(), proposals.end());
+
+    for(const auto&proposal : proposals) {
+        unsigned int i1 = get<1>(proposal), i2 = get<2>(proposal);
+
+        if(paired1[i1] || paired2[i2])
+            continue;
+
+        pairs.push_back(make_pair(i1, i2));
+        paired1[i1] = paired2[i2] = true;
+    }
+
+    sort(pairs.begin(), pairs.end());
+
+    vector<pair<Variable*, Variable*> > result;
+
+    for(const auto&p : pairs)
+        result.push_back(make_pair(cands1[p.first].var, cands2[p.second].var));
+
+    return result;
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FUZZY_H
+#define FUZZY_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class Variable;
+
+/**
+ * @brief Pairs variables that have similar names, used for the ones left
+ * unmatched by the exact name matching. Only variables with the same size
+ * (and type, unless -rtype is given) might be paired.
+ *
+ * Names are normalized first (lower case, no underscores) and paired if
+ * they are equal. The remaining ones are compared by trigrams: an inverted
+ * index finds names sharing the least common trigrams, so the cost does not
+ * grow with the square of the number of variables.
+ */
+class FuzzyMatcher {
+public:
+    /**
+     * @brief Adds a variable to be matched.
+     * @param file is the file number (0 or 1).
+     * @param name is the variable name including the scope hierarchy.
+     */
+    void add(unsigned int file, Variable*var, const std::string&name);
+
+    /**
+     * @brief Pairs the variables, each one is used at most once.
+     * @return Pairs ordered by the position of the first file variables.
+     */
+    std::vector<std::pair<Variable*, Variable*> > match();
+
+private:
+    struct Candidate {
+        Variable*var;
+
+        // Normalized name
+        std::string name;
+
+        // Variables of the same size and type share the group
+        unsigned int group;
+
+        // Sorted unique trigrams of the normalized name
+        std::vector<uint32_t> trigrams;
+    };
+
+    // Finds the most similar unpaired variable from the second file
+    // using the trigram index
+    bool find_similar(const Candidate&cand, unsigned int&index, double&score);
+
+    unsigned int group(const Variable*var);
+
+    std::vector<Candidate> candidates_[2];
+
+    // Groups indexed by (size, type)
+    std::map<std::pair<unsigned int, int>, unsigned int> groups_;
+
+    // Second file candidates indexed by (group, trigram)
+    std::unordered_map<uint64_t, std::vector<unsigned int> > postings_;
+
+    // Number of trigrams shared with the queried name, indexed by candidates
+    std::vector<unsigned int> shared_;
+};
+
+#endif /* FUZZY_H */
@@ -0,0 +1,1341 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ghwfile.h"
+#include "options.h"
+#include "rewrite.h"
+#include "debug.h"
+
+#include <algorithm>
+#include <sstream>
+#include <cstring>
+
+using namespace std;
+
+static const char GHW_MAGIC[] = "GHDLwave\n";
+
+// std_ulogic values converted to the four states known to VCD files
+static const char STD_ULOGIC_MAP[] = "XX01ZX01X";
+
+unsigned int GhwFile::Range::length() const {
+    int64_t len = downto ? left - right + 1 : right - left + 1;
+
+    return len > 0 ? len : 0;
+}
+
+GhwFile::Type::Type(int kind_)
+    : kind(kind_), wkt(WKT_UNKNOWN), base(NULL), el(NULL), dims(0),
+    nbr_scalars(1) {
+}
+
+GhwFile::GhwFile(const char*filename)
+    : WaveFile(filename), file_(filename, ios::binary), offset_(0),
+    version_(0), big_endian_(false), section_(END), cycle_time_(0)
+{
+    // GHDL stores time in femtoseconds
+    timescale_ = -15;
+}
+
+GhwFile::~GhwFile() {
+    for(Type*type : types_)
+        delete type;
+
+    for(Type*type : anon_types_)
+        delete type;
+}
+
+bool GhwFile::is_ghw(const char*data, unsigned int size) {
+    return size >= strlen(GHW_MAGIC)
+        && !memcmp(data, GHW_MAGIC, strlen(GHW_MAGIC));
+}
+
+bool GhwFile::parse_header() {
+    assert(valid());
+
+    unsigned char hdr[16];
+
+    if(!read_bytes((char*) hdr, sizeof(hdr))
+            || !is_ghw((const char*) hdr, sizeof(hdr))) {
+        PARSE_ERROR("not a GHW file");
+        return false;
+    }
+
+    if(hdr[9] != 16 || hdr[10] != 0 || hdr[11] > 1) {
+        PARSE_ERROR("unsupported GHW version");
+        return false;
+    }
+
+    version_ = hdr[11];
+
+    if(hdr[12] == 1) {
+        big_endian_ = false;
+    } else if(hdr[12] == 2) {
+        big_endian_ = true;
+    } else {
+        PARSE_ERROR("invalid byte order");
+        return false;
+    }
+
+    if(hdr[15] != 0) {
+        PARSE_ERROR("invalid header");
+        return false;
+    }
+
+    while(true) {
+        char section[4];
+        bool result;
+
+        if(!read_bytes(section, sizeof(section))) {
+            PARSE_ERROR("unexpected end of file");
+            return false;
+        }
+
+        if(!memcmp(section, "STR", 4)) {
+            result = read_strings();
+
+        } else if(!memcmp(section, "TYP", 4)) {
+            result = read_types();
+
+        } else if(!memcmp(section, "WKT", 4)) {
+            result = read_well_known_types();
+
+        } else if(!memcmp(section, "HIR", 4)) {
+            result = read_hierarchy();
+
+        } else if(!memcmp(section, "EOH", 4)) {
+            // Finished processing the header, find the first time step
+            DBG("%s: header correct", filename_.c_str());
+            root_.freeze();
+            return read_next_section();
+
+        } else {
+            PARSE_ERROR("unexpected section: %.3s", section);
+            result = false;
+        }
+
+        if(!result)
+            return false;
+    }
+
+    return false;
+}
+
+bool GhwFile::next_delta(set<const Link*>&changes) {
+    if(section_ == END) {
+        DBG("file %s finished", filename_.c_str());
+        return false;
+    }
+
+    const unsigned long tstamp = next_timestamp_;
+
+    // Process all sections that refer to the same time step (e.g.
+    // a snapshot stored right after a cycle)
+    while(section_ != END && next_timestamp_ == tstamp) {
+        bool result = (section_ == SNAPSHOT) ? read_snapshot() : read_cycle();
+
+        if(!result) {
+            section_ = END;
+            break;
+        }
+    }
+
+    flush_targets(changes);
+    cur_timestamp_ = tstamp;
+    DBG("%s: timestamp %lu", filename_.c_str(), cur_timestamp_);
+
+    return section_ != END;
+}
+
+bool GhwFile::read_strings() {
+    unsigned char hdr[12];
+
+    if(!read_bytes((char*) hdr, sizeof(hdr)))
+        return false;
+
+    int nbr_str = get_i32(&hdr[4]) + 1;
+
+    // String 0 is reserved for anonymous objects
+    strings_.reserve(nbr_str);
+    strings_.push_back("");
+
+    // Strings are stored with a prefix shared with the previous string
+    unsigned int prev_len = 0;
+
+    for(int i = 1; i < nbr_str; ++i) {
+        string str(strings_.back(), 0, prev_len);
+        int c;
+
+        while(true) {
+            if(!read_byte(c))
+                return false;
+
+            if((c >= 0 && c <= 31) || (c >= 128 && c <= 159))
+                break;
+
+            str.push_back(c);
+        }
+
+        prev_len = c & 0x1f;
+        int shift = 5;
+
+        while(c >= 128) {
+            if(!read_byte(c))
+                return false;
+
+            prev_len |= (c & 0x1f) << shift;
+            shift += 5;
+        }
+
+        strings_.push_back(str);
+    }
+
+    if(!expect_tag("EOS")) {
+        PARSE_ERROR("invalid string table");
+        return false;
+    }
+
+    return true;
+}
+
+bool GhwFile::read_types() {
+    unsigned char hdr[8];
+
+    if(!read_bytes((char*) hdr, sizeof(hdr)))
+        return false;
+
+    int nbr_types = get_i32(&hdr[4]);
+    types_.reserve(nbr_types);
+
+    for(int i = 0; i < nbr_types; ++i) {
+        int kind;
+        Type*type = NULL;
+
+        if(!read_byte(kind))
+            return false;
+
+        switch(kind) {
+            case TYPE_B2:
+            case TYPE_E8:
+            {
+                uint32_t nbr_lits;
+                string lit;
+
+                type = new Type(kind);
+                types_.push_back(type);
+
+                if(!read_strid(type->name) || !read_uleb128(nbr_lits))
+                    return false;
+
+                for(uint32_t j = 0; j < nbr_lits; ++j) {
+                    if(!read_strid(lit))
+                        return false;
+                }
+                break;
+            }
+
+            case TYPE_I32:
+            case TYPE_I64:
+            case TYPE_F64:
+                type = new Type(kind);
+                types_.push_back(type);
+
+                if(!read_strid(type->name))
+                    return false;
+                break;
+
+            case TYPE_P32:
+            case TYPE_P64:
+            {
+                uint32_t nbr_units = 0;
+                string unit;
+                int64_t val;
+
+                type = new Type(kind);
+                types_.push_back(type);
+
+                if(!read_strid(type->name))
+                    return false;
+
+                // Units are stored since version 1
+                if(version_ > 0 && !read_uleb128(nbr_units))
+                    return false;
+
+                for(uint32_t j = 0; j < nbr_units; ++j) {
+                    if(!read_strid(unit) || !read_lsleb128(val))
+                        return false;
+                }
+                break;
+            }
+
+            case SUBTYPE_SCALAR:
+            {
+                Range range;
+
+                type = new Type(kind);
+                types_.push_back(type);
+
+                if(!read_strid(type->name))
+                    return false;
+
+                type->base = read_typeid();
+
+                if(!type->base || !read_range(range))
+                    return false;
+
+                type->ranges.push_back(range);
+                break;
+            }
+
+            case TYPE_ARRAY:
+            {
+                type = new Type(kind);
+                types_.push_back(type);
+                type->nbr_scalars = -1;
+
+                if(!read_strid(type->name))
+                    return false;
+
+                type->el = read_typeid();
+
+                if(!type->el || !read_uleb128(type->dims))
+                    return false;
+
+                // Index types are not needed, ranges come with subtypes
+                for(unsigned int j = 0; j < type->dims; ++j) {
+                    if(!read_typeid())
+                        return false;
+                }
+                break;
+            }
+
+            case SUBTYPE_ARRAY:
+            {
+                string name;
+
+                if(!read_strid(name))
+                    return false;
+
+                const Type*base = read_typeid();
+
+                if(!base || !(type = read_array_subtype(base)))
+                    return false;
+
+                // The subtype has been stored as the last anonymous type,
+                // move it to the type table
+                anon_types_.pop_back();
+                types_.push_back(type);
+                type->name = name;
+                break;
+            }
+
+            case TYPE_RECORD:
+            {
+                uint32_t nbr_fields;
+
+                type = new Type(kind);
+                types_.push_back(type);
+                type->nbr_scalars = 0;
+
+                if(!read_strid(type->name) || !read_uleb128(nbr_fields))
+                    return false;
+
+                for(uint32_t j = 0; j < nbr_fields; ++j) {
+                    Field field;
+
+                    if(!read_strid(field.name)
+                            || !(field.type = read_typeid()))
+                        return false;
+
+                    int field_scalars = nbr_elements(field.type);
+
+                    if(field_scalars < 0 || type->nbr_scalars < 0)
+                        type->nbr_scalars = -1;
+                    else
+                        type->nbr_scalars += field_scalars;
+
+                    type->fields.push_back(field);
+                }
+                break;
+            }
+
+            case SUBTYPE_RECORD:
+            {
+                string name;
+
+                if(!read_strid(name))
+                    return false;
+
+                const Type*base = read_typeid();
+
+                if(!base || !(type = read_record_subtype(base)))
+                    return false;
+
+                anon_types_.pop_back();
+                types_.push_back(type);
+                type->name = name;
+                break;
+            }
+
+            case SUBTYPE_UNBOUNDED_ARRAY:
+            case SUBTYPE_UNBOUNDED_RECORD:
+                type = new Type(kind);
+                types_.push_back(type);
+                type->nbr_scalars = -1;
+
+                if(!read_strid(type->name) || !(type->base = read_typeid()))
+                    return false;
+                break;
+
+            default:
+                PARSE_ERROR("unknown type kind %d", kind);
+                return false;
+        }
+    }
+
+    int end;
+
+    if(!read_byte(end) || end != 0) {
+        PARSE_ERROR("invalid type table");
+        return false;
+    }
+
+    return true;
+}
+
+bool GhwFile::read_well_known_types() {
+    char hdr[4];
+
+    if(!read_bytes(hdr, sizeof(hdr)))
+        return false;
+
+    while(true) {
+        int wkt;
+
+        if(!read_byte(wkt))
+            return false;
+
+        if(wkt == 0)
+            break;
+
+        const Type*type = read_typeid();
+
+        if(!type)
+            return false;
+
+        if(type->kind == TYPE_B2 || type->kind == TYPE_E8)
+            const_cast<Type*>(type)->wkt = wkt;
+    }
+
+    return true;
+}
+
+bool GhwFile::read_hierarchy() {
+    unsigned char hdr[16];
+
+    if(!read_bytes((char*) hdr, sizeof(hdr)))
+        return false;
+
+    // Number of basic signals, index 0 is not used
+    signals_.resize(get_i32(&hdr[12]) + 1);
+
+    // Keeps track of blocks that have been converted to scopes
+    vector<bool> pushed;
+
+    while(true) {
+        int kind;
+
+        if(!read_byte(kind))
+            return false;
+
+        if(kind == HIE_EOH)
+            break;
+
+        if(kind == HIE_EOS) {
+            if(pushed.empty()) {
+                PARSE_ERROR("unexpected end of scope");
+                return false;
+            }
+
+            if(pushed.back())
+                pop_scope();
+
+            pushed.pop_back();
+            continue;
+        }
+
+        string name;
+
+        if(!read_strid(name))
+            return false;
+
+        switch(kind) {
+            case HIE_PROCESS:
+                // Processes do not contain signals
+                break;
+
+            case HIE_BLOCK:
+            case HIE_GENERATE_IF:
+            case HIE_GENERATE_FOR:
+            case HIE_INSTANCE:
+            case HIE_GENERIC:
+            case HIE_PACKAGE:
+            {
+                Scope::scope_type_t type =
+                    (kind == HIE_INSTANCE || kind == HIE_PACKAGE)
+                    ? Scope::MODULE : Scope::BEGIN;
+
+                if(kind == HIE_GENERATE_FOR) {
+                    // Generate statements are named after the iterator value
+                    const Type*iter_type = read_typeid();
+                    string iter_value;
+
+                    if(!iter_type || !read_index(iter_type, iter_value))
+                        return false;
+
+                    name += "(" + iter_value + ")";
+                }
+
+                bool ignore = (type == Scope::MODULE && skip_module);
+
+                if(!ignore) {
+                    string scope_name = rewrite_rules.apply(name.c_str());
+
+                    if(!ignore_case)
+                        to_lower_case(&scope_name[0]);
+
+                    push_scope(type, scope_name.c_str());
+                }
+
+                pushed.push_back(!ignore);
+                break;
+            }
+
+            case HIE_SIGNAL:
+            case HIE_PORT_IN:
+            case HIE_PORT_OUT:
+            case HIE_PORT_INOUT:
+            case HIE_PORT_BUFFER:
+            case HIE_PORT_LINKAGE:
+            {
+                const Type*type = read_typeid();
+
+                if(!type)
+                    return false;
+
+                int nbr_el = nbr_elements(type);
+
+                if(nbr_el < 0) {
+                    PARSE_ERROR("unbounded signal %s", name.c_str());
+                    return false;
+                }
+
+                vector<unsigned int> sigs(nbr_el + 1, 0);
+
+                if(!read_signal(type, &sigs[0]))
+                    return false;
+
+                if(find(pushed.begin(), pushed.end(), false) == pushed.end()) {
+                    name = rewrite_rules.apply(name.c_str());
+
+                    if(!ignore_case)
+                        transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+                    map_signal(name, type, &sigs[0]);
+                }
+
+                if(!check_mem_limit())
+                    return false;
+                break;
+            }
+
+            default:
+                PARSE_ERROR("unexpected hierarchy entry %d", kind);
+                return false;
+        }
+    }
+
+    return true;
+}
+
+bool GhwFile::read_snapshot() {
+    // The header has been already read by read_next_section()
+    for(unsigned int i = 1; i < signals_.size(); ++i) {
+        if(signals_[i].type && !read_signal_value(i))
+            return false;
+    }
+
+    if(!expect_tag("ESN")) {
+        PARSE_ERROR("invalid snapshot");
+        return false;
+    }
+
+    return read_next_section();
+}
+
+bool GhwFile::read_cycle() {
+    unsigned int sig_idx = 0;
+
+    while(true) {
+        uint32_t delta;
+
+        if(!read_uleb128(delta))
+            return false;
+
+        if(delta == 0)
+            break;
+
+        // Deltas count only signals that are stored in the file
+        while(delta > 0) {
+            ++sig_idx;
+
+            if(sig_idx >= signals_.size()) {
+                PARSE_ERROR("invalid signal index");
+                return false;
+            }
+
+            if(signals_[sig_idx].type)
+                --delta;
+        }
+
+        if(!read_signal_value(sig_idx))
+            return false;
+    }
+
+    int64_t time_delta;
+
+    if(!read_lsleb128(time_delta))
+        return false;
+
+    if(time_delta != -1) {
+        cycle_time_ += time_delta;
+        next_timestamp_ = cycle_time_;
+        return true;
+    }
+
+    if(!expect_tag("ECY")) {
+        PARSE_ERROR("invalid cycle");
+        return false;
+    }
+
+    return read_next_section();
+}
+
+bool GhwFile::read_next_section() {
+    char section[4];
+
+    if(!read_bytes(section, sizeof(section))) {
+        // No tailer, but all the data has been read
+        section_ = END;
+        return true;
+    }
+
+    if(!memcmp(section, "SNP", 4)) {
+        unsigned char hdr[12];
+
+        if(!read_bytes((char*) hdr, sizeof(hdr)))
+            return false;
+
+        section_ = SNAPSHOT;
+        cycle_time_ = get_i64(&hdr[4]);
+
+    } else if(!memcmp(section, "CYC", 4)) {
+        unsigned char hdr[8];
+
+        if(!read_bytes((char*) hdr, sizeof(hdr)))
+            return false;
+
+        section_ = CYCLE;
+        cycle_time_ = get_i64(hdr);
+
+    } else if(!memcmp(section, "DIR", 4) || !memcmp(section, "TAI", 4)) {
+        // Directory and tailer are stored at the end of file
+        section_ = END;
+        return true;
+
+    } else {
+        PARSE_ERROR("unexpected section: %.3s", section);
+        return false;
+    }
+
+    next_timestamp_ = cycle_time_;
+
+    return true;
+}
+
+const GhwFile::Type*GhwFile::read_typeid() {
+    uint32_t id;
+
+    if(!read_uleb128(id))
+        return NULL;
+
+    if(id == 0 || id > types_.size()) {
+        PARSE_ERROR("invalid type identifier %u", id);
+        return NULL;
+    }
+
+    return types_[id - 1];
+}
+
+bool GhwFile::read_range(Range&range) {
+    int kind;
+
+    if(!read_byte(kind))
+        return false;
+
+    range.kind = kind & 0x7f;
+    range.downto = (kind & 0x80) != 0;
+
+    switch(range.kind) {
+        case TYPE_B2:
+        case TYPE_E8:
+        {
+            int left, right;
+
+            if(!read_byte(left) || !read_byte(right))
+                return false;
+
+            range.left = left;
+            range.right = right;
+            return true;
+        }
+
+        case TYPE_I32:
+        case TYPE_P32:
+        {
+            int32_t left, right;
+
+            if(!read_sleb128(left) || !read_sleb128(right))
+                return false;
+
+            range.left = left;
+            range.right = right;
+            return true;
+        }
+
+        case TYPE_I64:
+        case TYPE_P64:
+            return read_lsleb128(range.left) && read_lsleb128(range.right);
+
+        case TYPE_F64:
+        {
+            double left, right;
+
+            // Real ranges are not used for indexing
+            range.left = range.right = 0;
+            return read_f64(left) && read_f64(right);
+        }
+    }
+
+    PARSE_ERROR("unknown range kind %d", range.kind);
+    return false;
+}
+
+GhwFile::Type*GhwFile::read_array_subtype(const Type*base) {
+    const Type*arr = base_type(base);
+
+    if(arr->kind != TYPE_ARRAY) {
+        PARSE_ERROR("invalid array subtype");
+        return NULL;
+    }
+
+    Type*type = new Type(SUBTYPE_ARRAY);
+    type->base = base;
+
+    int nbr_scalars = 1;
+
+    for(unsigned int i = 0; i < arr->dims; ++i) {
+        Range range;
+
+        if(!read_range(range)) {
+            delete type;
+            return NULL;
+        }
+
+        type->ranges.push_back(range);
+        nbr_scalars *= range.length();
+    }
+
+    if(nbr_elements(arr->el) >= 0) {
+        // Element type is bounded
+        type->el = arr->el;
+    } else {
+        // Read bounds for the elements
+        type->el = read_type_bounds(arr->el);
+
+        if(!type->el) {
+            delete type;
+            return NULL;
+        }
+    }
+
+    type->nbr_scalars = nbr_scalars * nbr_elements(type->el);
+    anon_types_.push_back(type);
+
+    return type;
+}
+
+GhwFile::Type*GhwFile::read_record_subtype(const Type*base) {
+    const Type*rec = base_type(base);
+
+    if(rec->kind != TYPE_RECORD) {
+        PARSE_ERROR("invalid record subtype");
+        return NULL;
+    }
+
+    Type*type = new Type(SUBTYPE_RECORD);
+    type->base = base;
+
+    if(rec->nbr_scalars >= 0) {
+        // Record base type is bounded
+        type->fields = rec->fields;
+        type->nbr_scalars = rec->nbr_scalars;
+    } else {
+        type->nbr_scalars = 0;
+
+        for(const Field&field : rec->fields) {
+            Field bounded = field;
+
+            if(nbr_elements(field.type) < 0) {
+                bounded.type = read_type_bounds(field.type);
+
+                if(!bounded.type) {
+                    delete type;
+                    return NULL;
+                }
+            }
+
+            type->nbr_scalars += nbr_elements(bounded.type);
+            type->fields.push_back(bounded);
+        }
+    }
+
+    anon_types_.push_back(type);
+
+    return type;
+}
+
+GhwFile::Type*GhwFile::read_type_bounds(const Type*base) {
+    switch(base->kind) {
+        case TYPE_ARRAY:
+        case SUBTYPE_UNBOUNDED_ARRAY:
+            return read_array_subtype(base);
+
+        case TYPE_RECORD:
+        case SUBTYPE_UNBOUNDED_RECORD:
+            return read_record_subtype(base);
+    }
+
+    PARSE_ERROR("unexpected unbounded type %d", base->kind);
+    return NULL;
+}
+
+bool GhwFile::read_signal(const Type*type, unsigned int*sigs) {
+    switch(type->kind) {
+        case TYPE_B2:
+        case TYPE_E8:
+        case TYPE_E32:
+        case TYPE_I32:
+        case TYPE_I64:
+        case TYPE_F64:
+        case TYPE_P32:
+        case TYPE_P64:
+        case SUBTYPE_SCALAR:
+        {
+            uint32_t sig_idx;
+
+            if(!read_uleb128(sig_idx))
+                return false;
+
+            if(sig_idx == 0 || sig_idx >= signals_.size()) {
+                PARSE_ERROR("invalid signal index %u", sig_idx);
+                return false;
+            }
+
+            *sigs = sig_idx;
+
+            if(!signals_[sig_idx].type)
+                signals_[sig_idx].type = base_type(type);
+
+            return true;
+        }
+
+        case SUBTYPE_ARRAY:
+        {
+            int len = type->nbr_scalars;
+            int stride = nbr_elements(type->el);
+
+            for(int i = 0; i < len; i += stride) {
+                if(!read_signal(type->el, &sigs[i]))
+                    return false;
+            }
+
+            return true;
+        }
+
+        case TYPE_RECORD:
+        case SUBTYPE_RECORD:
+        {
+            int off = 0;
+
+            for(const Field&field : type->fields) {
+                if(!read_signal(field.type, &sigs[off]))
+                    return false;
+
+                off += nbr_elements(field.type);
+            }
+
+            return true;
+        }
+    }
+
+    PARSE_ERROR("unexpected signal type %d", type->kind);
+    return false;
+}
+
+bool GhwFile::read_signal_value(unsigned int sig_idx) {
+    Signal&sig = signals_[sig_idx];
+    string value;
+
+    if(!read_value(sig.type, value))
+        return false;
+
+    for(const pair<unsigned int, unsigned int>&t : sig.targets) {
+        Target&target = targets_[t.first];
+
+        if(target.data_type == Value::REAL) {
+            target.bits = value;
+        } else {
+            assert(t.second + value.size() <= target.bits.size());
+            target.bits.replace(t.second, value.size(), value);
+        }
+
+        if(!target.dirty) {
+            target.dirty = true;
+            dirty_targets_.push_back(t.first);
+        }
+    }
+
+    return true;
+}
+
+bool GhwFile::read_value(const Type*type, string&value) {
+    const Type*base = base_type(type);
+
+    switch(base->kind) {
+        case TYPE_B2:
+        case TYPE_E8:
+        {
+            int v;
+
+            if(!read_byte(v))
+                return false;
+
+            if(base->wkt == WKT_STD_ULOGIC)
+                value = (v >= 0 && v < 9) ? STD_ULOGIC_MAP[v] : 'X';
+            else if(base->kind == TYPE_B2 || base->wkt != WKT_UNKNOWN)
+                value = (v ? '1' : '0');
+            else
+                value = to_string(v);   // enumeration position, not a bit
+
+            return true;
+        }
+
+        case TYPE_I32:
+        case TYPE_P32:
+        {
+            int32_t v;
+
+            if(!read_sleb128(v))
+                return false;
+
+            value.resize(32);
+            for(int i = 0; i < 32; ++i)
+                value[31 - i] = ((uint32_t) v >> i) & 1 ? '1' : '0';
+
+            return true;
+        }
+
+        case TYPE_I64:
+        case TYPE_P64:
+        {
+            int64_t v;
+
+            if(!read_lsleb128(v))
+                return false;
+
+            value.resize(64);
+            for(int i = 0; i < 64; ++i)
+                value[63 - i] = ((uint64_t) v >> i) & 1 ? '1' : '0';
+
+            return true;
+        }
+
+        case TYPE_F64:
+        {
+            double v;
+
+            if(!read_f64(v))
+                return false;
+
+            stringstream s;
+            s << v;
+            value = s.str();
+
+            return true;
+        }
+    }
+
+    PARSE_ERROR("unsupported value type %d", base->kind);
+    return false;
+}
+
+bool GhwFile::read_index(const Type*type, string&value) {
+    const Type*base = base_type(type);
+    int32_t v;
+
+    if(base->kind != TYPE_I32)
+        return read_value(type, value);
+
+    if(!read_sleb128(v))
+        return false;
+
+    value = to_string(v);
+    return true;
+}
+
+void GhwFile::map_signal(const string&name, const Type*type,
+        const unsigned int*sigs, bool word) {
+    const Type*base = base_type(type);
+    Variable::var_type_t var_type = Variable::REG;
+    Value::data_type_t data_type = Value::VECTOR;
+    unsigned int size = 0;
+    string var_name = name;
+
+    switch(base->kind) {
+        case TYPE_B2:
+        case TYPE_E8:
+            if(!is_bit_type(base)) {
+                DBG("%s: skipping enumeration signal %s",
+                        filename_.c_str(), name.c_str());
+                return;
+            }
+
+            data_type = Value::BIT;
+            size = 1;
+            break;
+
+        case TYPE_I32:
+        case TYPE_P32:
+            var_type = Variable::INTEGER;
+            size = 32;
+            break;
+
+        case TYPE_I64:
+            var_type = Variable::INTEGER;
+            size = 64;
+            break;
+
+        case TYPE_P64:
+            var_type = Variable::TIME;
+            size = 64;
+            break;
+
+        case TYPE_F64:
+            var_type = Variable::REAL;
+            data_type = Value::REAL;
+            size = 1;
+            break;
+
+        case TYPE_ARRAY:
+        {
+            if(type->ranges.size() != 1 || type->ranges.front().left < 0
+                    || type->ranges.front().right < 0) {
+                DBG("%s: skipping array signal %s",
+                        filename_.c_str(), name.c_str());
+                return;
+            }
+
+            const Range&range = type->ranges.front();
+            const Type*el_base = base_type(type->el);
+
+            if(is_bit_type(el_base)) {
+                // Bit vector
+                if(!word) {
+                    stringstream s;
+                    s << name << "[" << range.left << ":" << range.right << "]";
+                    var_name = s.str();
+                }
+
+                size = range.length();
+                break;
+            }
+
+            // Array of other types, map each element separately
+            int stride = nbr_elements(type->el);
+            int idx = range.left;
+
+            for(unsigned int i = 0; i < range.length(); ++i) {
+                stringstream s;
+                s << name << "[" << idx << "]";
+
+                // Words of a memory are named mem[x], as in VCD files
+                map_signal(s.str(), type->el, &sigs[i * stride], true);
+                idx += range.downto ? -1 : 1;
+            }
+            return;
+        }
+
+        case TYPE_RECORD:
+        {
+            int off = 0;
+
+            for(const Field&field : type->fields) {
+                string field_name = field.name;
+
+                if(!ignore_case)
+                    transform(field_name.begin(), field_name.end(),
+                            field_name.begin(), ::tolower);
+
+                map_signal(name + "." + field_name, field.type, &sigs[off]);
+                off += nbr_elements(field.type);
+            }
+            return;
+        }
+
+        default:
+            DBG("%s: skipping signal %s", filename_.c_str(), name.c_str());
+            return;
+    }
+
+    stringstream ident;
+    ident << "g" << sigs[0] << "_" << size;
+
+    // Aliases (e.g. ports connected to signals) are detected by the
+    // identifier, so they do not need separate targets
+    bool alias = var_idents_.count(ident.str());
+
+    add_variable(var_name.c_str(), ident.str().c_str(), size, var_type);
+
+    if(alias)
+        return;
+
+    Target target(var_idents_[ident.str()], data_type);
+
+    if(data_type == Value::REAL)
+        target.bits = "0";
+    else
+        target.bits.assign(size, Value::UNINITIALIZED);
+
+    unsigned int target_idx = targets_.size();
+    targets_.push_back(target);
+
+    // Scalar signals that are not bit types occupy multiple bits
+    unsigned int bits_per_sig = (size > 1 && base->kind != TYPE_ARRAY) ? size : 1;
+    unsigned int nbr_sigs = (base->kind == TYPE_ARRAY) ? size : 1;
+
+    for(unsigned int i = 0; i < nbr_sigs; ++i) {
+        signals_[sigs[i]].targets.push_back(
+                make_pair(target_idx, i * bits_per_sig));
+    }
+}
+
+void GhwFile::forget_variables(const set<const Variable*>&vars) {
+    WaveFile::forget_variables(vars);
+
+    // Signals keep updating the targets, but they are not applied
+    for(Target&target : targets_) {
+        if(vars.count(target.var))
+            target.var = NULL;
+    }
+}
+
+void GhwFile::flush_targets(set<const Link*>&changes) {
+    for(unsigned int idx : dirty_targets_) {
+        Target&target = targets_[idx];
+        target.dirty = false;
+
+        // Dropped variable
+        if(!target.var)
+            continue;
+
+        switch(target.data_type) {
+            case Value::BIT:
+                set_value(target.var, Value(target.bits[0]), changes);
+                break;
+
+            case Value::REAL:
+                set_value(target.var, Value((float) ::atof(target.bits.c_str())),
+                        changes);
+                break;
+
+            default:
+                set_value(target.var, Value(target.bits), changes);
+                break;
+        }
+    }
+
+    dirty_targets_.clear();
+}
+
+bool GhwFile::read_byte(int&byte) {
+    byte = file_.get();
+
+    if(!file_.good()) {
+        PARSE_ERROR("unexpected end of file");
+        return false;
+    }
+
+    ++offset_;
+    return true;
+}
+
+bool GhwFile::read_bytes(char*dest, unsigned int size) {
+    if(!file_.read(dest, size))
+        return false;
+
+    offset_ += size;
+    return true;
+}
+
+bool GhwFile::read_uleb128(uint32_t&res) {
+    int shift = 0;
+    int v;
+
+    res = 0;
+
+    do {
+        if(!read_byte(v))
+            return false;
+
+        res |= (uint32_t) (v & 0x7f) << shift;
+        shift += 7;
+    } while(v & 0x80);
+
+    return true;
+}
+
+bool GhwFile::read_sleb128(int32_t&res) {
+    uint32_t r = 0;
+    int shift = 0;
+    int v;
+
+    do {
+        if(!read_byte(v))
+            return false;
+
+        r |= (uint32_t) (v & 0x7f) << shift;
+        shift += 7;
+    } while(v & 0x80);
+
+    // Sign extension
+    if((v & 0x40) && shift < 32)
+        r |= ~0U << shift;
+
+    res = r;
+    return true;
+}
+
+bool GhwFile::read_lsleb128(int64_t&res) {
+    uint64_t r = 0;
+    int shift = 0;
+    int v;
+
+    do {
+        if(!read_byte(v))
+            return false;
+
+        r |= (uint64_t) (v & 0x7f) << shift;
+        shift += 7;
+    } while(v & 0x80);
+
+    // Sign extension
+    if((v & 0x40) && shift < 64)
+        r |= ~0ULL << shift;
+
+    res = r;
+    return true;
+}
+
+bool GhwFile::read_f64(double&res) {
+    // Doubles are stored in the host byte order
+    return read_bytes((char*) &res, sizeof(res));
+}
+
+bool GhwFile::read_strid(string&res) {
+    uint32_t id;
+
+    if(!read_uleb128(id))
+        return false;
+
+    if(id >= strings_.size()) {
+        PARSE_ERROR("invalid string identifier %u", id);
+        return false;
+    }
+
+    res = strings_[id];
+    return true;
+}
+
+bool GhwFile::expect_tag(const char*tag) {
+    char data[4];
+
+    return read_bytes(data, sizeof(data)) && !memcmp(data, tag, 4);
+}
+
+int32_t GhwFile::get_i32(const unsigned char*data) const {
+    if(big_endian_)
+        return (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+    else
+        return (data[3] << 24) | (data[2] << 16) | (data[1] << 8) | data[0];
+}
+
+int64_t GhwFile::get_i64(const unsigned char*data) const {
+    if(big_endian_)
+        return ((int64_t) get_i32(data) << 32) | (uint32_t) get_i32(data + 4);
+    else
+        return ((int64_t) get_i32(data + 4) << 32) | (uint32_t) get_i32(data);
+}
+
+const GhwFile::Type*GhwFile::base_type(const Type*type) {
+    switch(type->kind) {
+        case SUBTYPE_SCALAR:
+        case SUBTYPE_ARRAY:
+        case SUBTYPE_UNBOUNDED_ARRAY:
+        case SUBTYPE_RECORD:
+        case SUBTYPE_UNBOUNDED_RECORD:
+            return base_type(type->base);
+    }
+
+    return type;
+}
+
+int GhwFile::nbr_elements(const Type*type) {
+    switch(type->kind) {
+        case TYPE_ARRAY:
+        case SUBTYPE_UNBOUNDED_ARRAY:
+        case SUBTYPE_UNBOUNDED_RECORD:
+            return -1;
+    }
+
+    return type->nbr_scalars;
+}
+
+bool GhwFile::is_bit_type(const Type*type) {
+    return type->kind == TYPE_B2
+        || (type->kind == TYPE_E8 && type->wkt != WKT_UNKNOWN);
+}
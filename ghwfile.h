@@ -0,0 +1,249 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GHWFILE_H
+#define GHWFILE_H
+
+#include <fstream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include "wavefile.h"
+
+// GHW format description: libghw.c in GHDL sources
+// https://github.com/ghdl/ghdl/blob/master/ghw/libghw.c
+
+/**
+ * @brief Reader for GHDL native waveform files. The VHDL signals are
+ * converted to the same Scope/Variable hierarchy as the one built for VCD
+ * files, so both formats might be compared with each other.
+ */
+class GhwFile : public WaveFile {
+public:
+    GhwFile(const char*filename);
+    ~GhwFile();
+
+    /**
+     * @brief Checks if a memory block starts with the GHW magic string.
+     */
+    static bool is_ghw(const char*data, unsigned int size);
+
+    inline bool valid() const {
+        return file_.good();
+    }
+
+    bool parse_header();
+
+    bool next_delta(std::set<const Link*>&changes);
+
+    /**
+     * @brief GHW files are binary, so the byte offset is used for messages.
+     */
+    unsigned long line_number() const {
+        return offset_;
+    }
+
+    unsigned long position() const {
+        return offset_;
+    }
+
+    void collect_stats(Stats&stats) const {
+        WaveFile::collect_stats(stats);
+        stats.bytes.add(offset_);
+    }
+
+protected:
+    void forget_variables(const std::set<const Variable*>&vars);
+
+private:
+    ///> Type kinds as stored in GHW files (ghdl_rtik)
+    enum rtik_t {
+        TYPE_B2 = 22, TYPE_E8 = 23, TYPE_E32 = 24, TYPE_I32 = 25,
+        TYPE_I64 = 26, TYPE_F64 = 27, TYPE_P32 = 28, TYPE_P64 = 29,
+        TYPE_ARRAY = 31, TYPE_RECORD = 32, SUBTYPE_SCALAR = 34,
+        SUBTYPE_ARRAY = 35, SUBTYPE_UNBOUNDED_ARRAY = 37,
+        SUBTYPE_RECORD = 38, SUBTYPE_UNBOUNDED_RECORD = 39
+    };
+
+    ///> Hierarchy entry kinds
+    enum hie_t {
+        HIE_EOH = 0, HIE_DESIGN = 1, HIE_BLOCK = 3, HIE_GENERATE_IF = 4,
+        HIE_GENERATE_FOR = 5, HIE_INSTANCE = 6, HIE_PACKAGE = 7,
+        HIE_PROCESS = 13, HIE_GENERIC = 14, HIE_EOS = 15, HIE_SIGNAL = 16,
+        HIE_PORT_IN = 17, HIE_PORT_OUT = 18, HIE_PORT_INOUT = 19,
+        HIE_PORT_BUFFER = 20, HIE_PORT_LINKAGE = 21
+    };
+
+    ///> Well known types
+    enum wkt_t {
+        WKT_UNKNOWN = 0, WKT_BOOLEAN = 1, WKT_BIT = 2, WKT_STD_ULOGIC = 3
+    };
+
+    ///> Discrete range (enumeration positions or integers)
+    struct Range {
+        int kind;
+        bool downto;
+        int64_t left, right;
+
+        unsigned int length() const;
+    };
+
+    struct Type;
+
+    ///> Record field
+    struct Field {
+        std::string name;
+        const Type*type;
+    };
+
+    ///> Type description, fields are used depending on the kind
+    struct Type {
+        Type(int kind_);
+
+        int kind;
+        std::string name;
+        int wkt;
+
+        // Subtypes: base type, arrays: element type
+        const Type*base;
+        const Type*el;
+
+        // Unbounded arrays: number of dimensions
+        unsigned int dims;
+
+        // Bounded arrays and scalar subtypes
+        std::vector<Range> ranges;
+
+        // Records
+        std::vector<Field> fields;
+
+        // Number of scalar signals for the type, -1 if unbounded
+        int nbr_scalars;
+    };
+
+    ///> Variable that collects values of basic signals
+    struct Target {
+        Target(Variable*var_, Value::data_type_t data_type_)
+            : var(var_), data_type(data_type_), dirty(false) {}
+
+        Variable*var;
+        std::string bits;
+        Value::data_type_t data_type;
+        bool dirty;
+    };
+
+    ///> Basic (scalar) signal stored in the file
+    struct Signal {
+        Signal() : type(NULL) {}
+
+        // Base type, NULL if the signal is not used
+        const Type*type;
+
+        // Targets updated by the signal, pairs of (target index, bit index)
+        std::vector<std::pair<unsigned int, unsigned int> > targets;
+    };
+
+    ///> Section that will be processed by the next call to next_delta()
+    enum section_t { SNAPSHOT, CYCLE, END };
+
+    // Section readers
+    bool read_strings();
+    bool read_types();
+    bool read_well_known_types();
+    bool read_hierarchy();
+    bool read_snapshot();
+    bool read_cycle();
+    bool read_next_section();
+
+    // Type readers
+    const Type*read_typeid();
+    bool read_range(Range&range);
+    Type*read_array_subtype(const Type*base);
+    Type*read_record_subtype(const Type*base);
+    Type*read_type_bounds(const Type*base);
+
+    // Reads a signal declaration and stores indexes of its basic signals
+    bool read_signal(const Type*type, unsigned int*sigs);
+
+    // Reads a value of a basic signal and updates the variables it drives
+    bool read_signal_value(unsigned int sig_idx);
+
+    // Reads a value of a scalar type, converted to a string
+    bool read_value(const Type*type, std::string&value);
+
+    // Reads a for-generate index, integers are converted to decimal numbers
+    bool read_index(const Type*type, std::string&value);
+
+    // Converts a signal to variables in the current scope, words of
+    // memories are not named with their index range
+    void map_signal(const std::string&name, const Type*type,
+                    const unsigned int*sigs, bool word = false);
+
+    // Assigns the collected values to variables
+    void flush_targets(std::set<const Link*>&changes);
+
+    // Low level readers
+    bool read_byte(int&byte);
+    bool read_bytes(char*dest, unsigned int size);
+    bool read_uleb128(uint32_t&res);
+    bool read_sleb128(int32_t&res);
+    bool read_lsleb128(int64_t&res);
+    bool read_f64(double&res);
+    bool read_strid(std::string&res);
+    bool expect_tag(const char*tag);
+    int32_t get_i32(const unsigned char*data) const;
+    int64_t get_i64(const unsigned char*data) const;
+
+    static const Type*base_type(const Type*type);
+    static int nbr_elements(const Type*type);
+    static bool is_bit_type(const Type*type);
+
+    // Handle to the processed file
+    std::ifstream file_;
+
+    // Current position in the file
+    unsigned long offset_;
+
+    // GHW format version
+    int version_;
+
+    // Is the file stored as big endian?
+    bool big_endian_;
+
+    std::vector<std::string> strings_;
+    std::vector<Type*> types_;
+
+    // Types that are not declared in the type table (anonymous subtypes)
+    std::vector<Type*> anon_types_;
+
+    std::vector<Signal> signals_;
+    std::vector<Target> targets_;
+
+    // Indexes of targets modified in the current time step
+    std::vector<unsigned int> dirty_targets_;
+
+    section_t section_;
+
+    // Time of the currently processed cycle (in femtoseconds)
+    int64_t cycle_time_;
+};
+
+#endif /* GHWFILE_H */
@@ -0,0 +1,198 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "history.h"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstring>
+
+using namespace std;
+
+const unsigned int ValueHistory::NONE = UINT_MAX;
+
+// Characters stored as bits, the index is the stored code
+static const char BIT_CHARS[] = "01XZ?";
+static const unsigned int BIT_CODES = sizeof(BIT_CHARS) - 1;
+
+// Values that are not bits are stored with their length (single byte)
+static const unsigned int RAW_MIN_WIDTH = 16;
+static const unsigned int RAW_MAX_WIDTH = UCHAR_MAX;
+
+static inline int bit_code(char c) {
+    const char*pos = (const char*) memchr(BIT_CHARS, c, BIT_CODES);
+    return pos ? pos - BIT_CHARS : -1;
+}
+
+static bool is_bits(const string&value) {
+    for(char c : value) {
+        if(bit_code(c) < 0)
+            return false;
+    }
+
+    return !value.empty();
+}
+
+ValueHistory::ValueHistory(unsigned int depth)
+    : depth_(depth) {
+    assert(depth > 0);
+}
+
+unsigned int ValueHistory::Ring::value_size(unsigned int side) const {
+    return packed[side] ? (width[side] + 1) / 2 : width[side] + 1;
+}
+
+unsigned int ValueHistory::Ring::entry_size() const {
+    return sizeof(unsigned long) + value_size(0) + value_size(1);
+}
+
+void ValueHistory::add(unsigned int id, unsigned long time,
+        const string&value1, const string&value2) {
+    if(id >= index_.size())
+        index_.resize(id + 1, NONE);
+
+    if(index_[id] == NONE) {
+        index_[id] = rings_.size();
+        rings_.push_back(Ring());
+        allocate(rings_.back(), value1, value2);
+    }
+
+    Ring&ring = rings_[index_[id]];
+
+    if(!fits(ring, 0, value1))
+        grow(ring, 0, value1);
+
+    if(!fits(ring, 1, value2))
+        grow(ring, 1, value2);
+
+    unsigned char*dst = &data_[ring.offset + ring.next * ring.entry_size()];
+    memcpy(dst, &time, sizeof(time));
+    dst += sizeof(time);
+    encode(ring, 0, dst, value1);
+    encode(ring, 1, dst + ring.value_size(0), value2);
+
+    ring.next = (ring.next + 1) % depth_;
+    ring.count = min(ring.count + 1, depth_);
+}
+
+void ValueHistory::print(ostream&out, unsigned int id) const {
+    if(id >= index_.size() || index_[id] == NONE)
+        return;
+
+    const Ring&ring = rings_[index_[id]];
+
+    for(unsigned int i = 0; i < ring.count; ++i) {
+        const unsigned char*src = entry(ring, i);
+        unsigned long time;
+
+        memcpy(&time, src, sizeof(time));
+        src += sizeof(time);
+
+        out << "  #" << time << "\t" << decode(ring, 0, src) << " | "
+            << decode(ring, 1, src + ring.value_size(0)) << endl;
+    }
+}
+
+void ValueHistory::allocate(Ring&ring, const string&value1, const string&value2) {
+    const string*values[2] = { &value1, &value2 };
+
+    for(unsigned int side = 0; side < 2; ++side) {
+        const string&value = *values[side];
+        ring.packed[side] = is_bits(value);
+        ring.width[side] = ring.packed[side] ? value.size()
+            : min<unsigned int>(max<unsigned int>(value.size(), RAW_MIN_WIDTH), RAW_MAX_WIDTH);
+    }
+
+    ring.next = ring.count = 0;
+    ring.offset = data_.size();
+    data_.resize(data_.size() + depth_ * ring.entry_size());
+}
+
+bool ValueHistory::fits(const Ring&ring, unsigned int side, const string&value) {
+    if(!ring.packed[side])
+        return value.size() <= ring.width[side] || ring.width[side] == RAW_MAX_WIDTH;
+
+    return value.size() == ring.width[side] && is_bits(value);
+}
+
+void ValueHistory::grow(Ring&ring, unsigned int side, const string&value) {
+    // Decode the stored entries, they are encoded again using the new layout
+    vector<unsigned long> times(ring.count);
+    vector<string> values[2];
+
+    for(unsigned int i = 0; i < ring.count; ++i) {
+        const unsigned char*src = entry(ring, i);
+        memcpy(&times[i], src, sizeof(unsigned long));
+        src += sizeof(unsigned long);
+        values[0].push_back(decode(ring, 0, src));
+        values[1].push_back(decode(ring, 1, src + ring.value_size(0)));
+    }
+
+    // Values that do not fit are rare (e.g. a bit variable assigned a string),
+    // so the old space is not reused
+    ring.packed[side] = false;
+    ring.width[side] = min<unsigned int>(RAW_MAX_WIDTH,
+            max(max<unsigned int>(ring.width[side], value.size()), RAW_MIN_WIDTH));
+    ring.offset = data_.size();
+    data_.resize(data_.size() + depth_ * ring.entry_size());
+
+    for(unsigned int i = 0; i < ring.count; ++i) {
+        unsigned char*dst = &data_[ring.offset + i * ring.entry_size()];
+        memcpy(dst, &times[i], sizeof(unsigned long));
+        dst += sizeof(unsigned long);
+        encode(ring, 0, dst, values[0][i]);
+        encode(ring, 1, dst + ring.value_size(0), values[1][i]);
+    }
+
+    ring.next = ring.count % depth_;
+}
+
+void ValueHistory::encode(const Ring&ring, unsigned int side, unsigned char*dst,
+        const string&value) const {
+    if(ring.packed[side]) {
+        memset(dst, 0, ring.value_size(side));
+
+        for(unsigned int i = 0; i < value.size(); ++i)
+            dst[i / 2] |= bit_code(value[i]) << (4 * (i % 2));
+
+    } else {
+        unsigned int len = min<unsigned int>(value.size(), ring.width[side]);
+        dst[0] = len;
+        memcpy(dst + 1, value.data(), len);
+    }
+}
+
+string ValueHistory::decode(const Ring&ring, unsigned int side,
+        const unsigned char*src) const {
+    if(!ring.packed[side])
+        return string((const char*) src + 1, src[0]);
+
+    string value(ring.width[side], ' ');
+
+    for(unsigned int i = 0; i < value.size(); ++i)
+        value[i] = BIT_CHARS[(src[i / 2] >> (4 * (i % 2))) & 0xf];
+
+    return value;
+}
+
+const unsigned char*ValueHistory::entry(const Ring&ring, unsigned int idx) const {
+    // Once the ring is full, the oldest entry is the next one to overwrite
+    unsigned int first = ring.count < depth_ ? 0 : ring.next;
+    return &data_[ring.offset + (first + idx) % depth_ * ring.entry_size()];
+}
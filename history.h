@@ -0,0 +1,112 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Recent values of linked variables, kept in a ring buffer of fixed
+ * depth for each link. Buffers are allocated when a link records its first
+ * value, so the memory usage depends only on the links that are compared.
+ *
+ * Entries are stored packed in a single buffer: bit values take 4 bits
+ * per character, other values are stored as characters.
+ */
+class ValueHistory {
+public:
+    /**
+     * @param depth is the number of entries kept for each link.
+     */
+    ValueHistory(unsigned int depth);
+
+    /**
+     * @brief Records values of both linked variables, replacing the oldest
+     * entry if the buffer is full.
+     * @param id is the link index (see Link::id()).
+     */
+    void add(unsigned int id, unsigned long time,
+            const std::string&value1, const std::string&value2);
+
+    /**
+     * @brief Prints entries recorded for a link, starting from the oldest.
+     */
+    void print(std::ostream&out, unsigned int id) const;
+
+    /**
+     * @brief Returns the number of bytes allocated for the entries.
+     */
+    inline unsigned long usage() const {
+        return data_.capacity() + rings_.capacity() * sizeof(Ring)
+            + index_.capacity() * sizeof(unsigned int);
+    }
+
+private:
+    struct Ring {
+        // Beginning of the ring in data_
+        unsigned long offset;
+
+        // Number of characters that fit in each value
+        unsigned int width[2];
+
+        // Set if the values are stored as bits, 4 bits per character
+        bool packed[2];
+
+        // Next entry to overwrite and the number of stored entries
+        unsigned int next, count;
+
+        // Size of an entry (in bytes)
+        unsigned int entry_size() const;
+
+        // Size of a value (in bytes)
+        unsigned int value_size(unsigned int side) const;
+    };
+
+    // Allocates a ring able to store the values
+    void allocate(Ring&ring, const std::string&value1, const std::string&value2);
+
+    // Checks if a value fits the ring layout
+    static bool fits(const Ring&ring, unsigned int side, const std::string&value);
+
+    // Moves a ring to a new layout, so it may store the value
+    void grow(Ring&ring, unsigned int side, const std::string&value);
+
+    void encode(const Ring&ring, unsigned int side, unsigned char*dst,
+            const std::string&value) const;
+    std::string decode(const Ring&ring, unsigned int side,
+            const unsigned char*src) const;
+
+    // Returns the beginning of an entry (0 is the oldest one)
+    const unsigned char*entry(const Ring&ring, unsigned int idx) const;
+
+    const unsigned int depth_;
+
+    // Indexes in rings_ for each link id, NONE if nothing has been recorded
+    std::vector<unsigned int> index_;
+    std::vector<Ring> rings_;
+
+    // Packed entries of all rings
+    std::vector<unsigned char> data_;
+
+    static const unsigned int NONE;
+};
+
+#endif /* HISTORY_H */
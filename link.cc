@@ -20,13 +20,12 @@
 #include "variable.h"
 #include "options.h"
 
-#include <iomanip>
 #include <sstream>
 
 using namespace std;
 
 Link::Link(Variable*first, Variable*second)
-    : first_(first), second_(second) {
+    : first_(first), second_(second), id_(0) {
     assert(first && second);
     assert(first_->size() == second_->size());
 }
@@ -43,41 +42,50 @@ size_t Link::hash() const {
     return (first + 1) * (second + 1);
 }
 
-ostream&operator<<(ostream&out, const Link&link) {
+void Link::print(ostream&out, const string&value1,
+        const string&value2) const {
     stringstream s1, s2;
-    const Variable*var1 = link.first();
-    const Variable*var2 = link.second();
 
-    s1 << *var1;
-    s2 << *var2;
+    s1 << *first_;
+    s2 << *second_;
 
-    // Align scope names
-    int len1 = s1.str().length();
-    int len2 = s2.str().length();
+    print(out, s1.str(), s2.str(), value1, value2);
+}
 
-    if(len1 > len2) {
-        s2 << setw(len1 - len2) << " ";
-    } else if(len2 > len1) {
-        s1 << setw(len2 - len1) << " ";
+void Link::print(ostream&out, const string&name1, const string&name2,
+        const string&value1, const string&value2) {
+    string line1(name1), line2(name2);
+
+    // Align scope names
+    if(line1.length() > line2.length()) {
+        line2.append(line1.length() - line2.length(), ' ');
+    } else if(line2.length() > line1.length()) {
+        line1.append(line2.length() - line1.length(), ' ');
     }
 
-    s1 << "\t= ";
-    s2 << "\t= ";
+    line1 += "\t= " + value1;
+    line2 += "\t= " + value2;
 
-    if(!compare_states && var1->changed())
-        s1 << var1->prev_value_str() << " -> ";
+    out << line1 << endl;
+    out << line2 << endl;
+}
 
-    s1 << var1->value_str();
+string Link::value_str(const string&prev, const string&cur, bool changed) {
+    if(!compare_states && changed)
+        return prev + " -> " + cur;
 
+    return cur;
+}
 
-    if(!compare_states && var2->changed())
-        s2 << var2->prev_value_str() << " -> ";
+string Link::value_str(const Variable*var) {
+    if(!compare_states && var->changed())
+        return var->prev_value_str() + " -> " + var->value_str();
 
-    s2 << var2->value_str();
+    return var->value_str();
+}
 
-    out << s1.str() << endl;
-    out << s2.str() << endl;
+ostream&operator<<(ostream&out, const Link&link) {
+    link.print(out, Link::value_str(link.first()), Link::value_str(link.second()));
 
     return out;
 }
-
@@ -20,6 +20,7 @@
 #define LINK_H
 
 #include <ostream>
+#include <string>
 
 class Variable;
 
@@ -27,6 +28,17 @@ class Link {
 public:
     Link(Variable*first, Variable*second);
 
+    /*
+     * Index of the link, unique among the links created by a Comparator.
+     */
+    inline unsigned int id() const {
+        return id_;
+    }
+
+    inline void set_id(unsigned int id) {
+        id_ = id;
+    }
+
     inline Variable*first() const {
         return first_;
     }
@@ -45,9 +57,37 @@ public:
      */
     size_t hash() const;
 
+    /*
+     * Prints names of the linked variables together with the provided
+     * values, aligned the same way as operator<< does.
+     */
+    void print(std::ostream&out, const std::string&value1,
+            const std::string&value2) const;
+
+    /*
+     * Prints a pair of variable names together with their values, the names
+     * are aligned.
+     */
+    static void print(std::ostream&out, const std::string&name1,
+            const std::string&name2, const std::string&value1,
+            const std::string&value2);
+
+    /*
+     * Formats a value, showing the transition if the value has changed
+     * and transitions are compared.
+     */
+    static std::string value_str(const std::string&prev,
+            const std::string&cur, bool changed);
+
+    /*
+     * Formats the current value of a variable, including the transition.
+     */
+    static std::string value_str(const Variable*var);
+
 private:
     Variable*first_;
     Variable*second_;
+    unsigned int id_;
 };
 
 std::ostream&operator<<(std::ostream&out, const Link&link);
@@ -19,16 +19,24 @@
 // VCD format description:
 // http://web.archive.org/web/20120323132708/http://www.beyondttl.com/vcd.php
 
-// TODO generating a list of unmatched signals and manual matching
-// by providing a file with list of names that match
 // TODO genereating a vcd file containing both signals
 // TODO debug levels
 
 #include "comparator.h"
-#include "vcdfile.h"
+#include "diffdb.h"
+#include "options.h"
+#include "progress.h"
+#include "rewrite.h"
+#include "trace.h"
+#include "wavefile.h"
+
+#include <algorithm>
+#include <limits>
 
 #include <cstdlib>
 #include <cstring>
+#include <getopt.h>
+#include <thread>
 #include <unistd.h>
 
 #define VERSION "1.1"
@@ -41,10 +49,7 @@ struct option_t {
     const char*desc;
 };
 
-// Options
-bool ignore_case        = false;
-bool ignore_var_type    = false;
-bool ignore_var_index   = false;
+// Options (the variables are defined in options.cc)
 option_t ignore_options[] = {
     { "case",   &ignore_case,
         "Case-insensitive variable matching (e.g. variable to VaRiAbLe)." },
@@ -55,22 +60,12 @@ option_t ignore_options[] = {
     { NULL, NULL }
 };
 
-bool skip_module        = false;
-bool skip_function      = false;
-bool skip_task          = false;
 option_t skip_options[] = {
     { "module",     &skip_module,   "\tSkip module scopes." },
     { "function",   &skip_function, "Skip function scopes." },
     { "task",       &skip_task,     "\tSkip task scopes." }
 };
 
-bool warn_missing_scopes    = true;
-bool warn_missing_vars      = true;
-bool warn_missing_tstamps   = true;
-bool warn_duplicate_vars    = true;
-bool warn_unexpected_tokens = true;
-bool warn_size_mismatch     = true;
-bool warn_type_mismatch     = true;
 option_t warn_options[] = {
     { "no-missing-scope",  &warn_missing_scopes,
         "Do not warn about scopes that do not occur in one of the files." },
@@ -89,8 +84,54 @@ option_t warn_options[] = {
     { NULL, NULL }
 };
 
-bool compare_states = false;
-bool test_mode = false;
+// Options that do not have a short version
+enum {
+    OPT_COLUMNAR = 256,
+    OPT_COLUMNAR_MEM,
+    OPT_PARTITIONED,
+    OPT_STATS,
+    OPT_TRACE,
+    OPT_PROGRESS,
+    OPT_PROFILE,
+    OPT_MEM_REPORT,
+    OPT_MEM_LIMIT,
+    OPT_DIGEST,
+    OPT_DIGEST_SAVE,
+    OPT_STRUCTURE,
+    OPT_MAP_CACHE,
+    OPT_MAP_FILE,
+    OPT_FUZZY,
+    OPT_REWRITE,
+    OPT_CONTEXT,
+    OPT_DB,
+    OPT_INTERVALS,
+    OPT_SUMMARY
+};
+
+static const struct option long_options[] = {
+    { "columnar",   no_argument,        NULL, OPT_COLUMNAR },
+    { "columnar-mem", required_argument, NULL, OPT_COLUMNAR_MEM },
+    { "partitioned", no_argument,       NULL, OPT_PARTITIONED },
+    { "stats",      no_argument,        NULL, OPT_STATS },
+    { "trace",      required_argument,  NULL, OPT_TRACE },
+    { "progress",   optional_argument,  NULL, OPT_PROGRESS },
+    { "profile",    optional_argument,  NULL, OPT_PROFILE },
+    { "mem-report", optional_argument,  NULL, OPT_MEM_REPORT },
+    { "mem-limit",  required_argument,  NULL, OPT_MEM_LIMIT },
+    { "digest",     optional_argument,  NULL, OPT_DIGEST },
+    { "digest-save", no_argument,       NULL, OPT_DIGEST_SAVE },
+    { "structure",  no_argument,        NULL, OPT_STRUCTURE },
+    { "map-cache",  required_argument,  NULL, OPT_MAP_CACHE },
+    { "map-file",   required_argument,  NULL, OPT_MAP_FILE },
+    { "fuzzy",      no_argument,        NULL, OPT_FUZZY },
+    { "rewrite",    required_argument,  NULL, OPT_REWRITE },
+    { "context",    required_argument,  NULL, OPT_CONTEXT },
+    { "db",         required_argument,  NULL, OPT_DB },
+    { "intervals",  no_argument,        NULL, OPT_INTERVALS },
+    { "summary",    no_argument,        NULL, OPT_SUMMARY },
+    { "threads",    required_argument,  NULL, 'j' },
+    { NULL, 0, NULL, 0 }
+};
 
 //bool show_unmatched_vars = false;    // TODO
 //bool match_individual_scalars = false; // TODO
@@ -107,19 +148,137 @@ static void enable_all(option_t* options) {
     }
 }
 
+// Options of the query subcommand
+enum {
+    QUERY_SIGNAL = 256,
+    QUERY_SCOPE,
+    QUERY_FROM,
+    QUERY_TO
+};
+
+static const struct option query_options[] = {
+    { "signal",     required_argument,  NULL, QUERY_SIGNAL },
+    { "scope",      required_argument,  NULL, QUERY_SCOPE },
+    { "from",       required_argument,  NULL, QUERY_FROM },
+    { "to",         required_argument,  NULL, QUERY_TO },
+    { NULL, 0, NULL, 0 }
+};
+
+// Prints differences stored with --db
+static int query(int argc, char*argv[]) {
+    string signal, scope;
+    unsigned long from = 0, to = numeric_limits<unsigned long>::max();
+    int opt;
+
+    while((opt = getopt_long(argc, argv, "", query_options, NULL)) != -1) {
+        switch(opt) {
+            case QUERY_SIGNAL:
+                signal = optarg;
+                break;
+
+            case QUERY_SCOPE:
+                scope = optarg;
+                break;
+
+            case QUERY_FROM:
+                from = strtoul(optarg, NULL, 10);
+                break;
+
+            case QUERY_TO:
+                to = strtoul(optarg, NULL, 10);
+                break;
+
+            default:
+                return 1;
+        }
+    }
+
+    if(optind != argc - 1) {
+        cerr << "Usage: vcdiff query [--signal=<name>] [--scope=<name>] "
+            "[--from=<t>] [--to=<t>] file.db" << endl;
+        return 1;
+    }
+
+    DiffDbReader db;
+
+    if(!db.open(argv[optind])) {
+        cerr << "Error: Could not read database " << argv[optind] << endl;
+        return 1;
+    }
+
+    if(!signal.empty() && !db.contains(signal)) {
+        cerr << "Warning: No differences of signal " << signal
+            << " in database " << argv[optind] << endl;
+    }
+
+    db.query(signal, scope, from, to, cout);
+
+    return 0;
+}
+
 int main(int argc, char*argv[]) {
     option_t*opt_ptr = NULL;
     int opt;
 
+    if(argc > 1 && !strcmp(argv[1], "query"))
+        return query(argc - 1, argv + 1);
+
     if(argc < 3 || !strcmp(argv[1], "--help")) {
         cerr << "vcdiff " << VERSION << " by Maciej Suminski <maciej.suminski@cern.ch>" << endl;
         cerr << "(c) CERN 2016" << endl;
         cerr << "Usage: vcdiff [options] file1.vcd file2.vcd" << endl;
+        cerr << "       vcdiff query [--signal=<name>] [--scope=<name>] "
+            "[--from=<t>] [--to=<t>] file.db" << endl;
+        cerr << "GHDL waveform files (.ghw) are accepted as well." << endl;
         cerr << endl;
 
         cerr << "Options: " << endl;
 
         cerr << "-s\t\t\t\tCompares states instead of transitions." << endl;
+        cerr << "--intervals\t\t\tReports periods when variables differ, with "
+            "the first differing values, instead of each difference (implies -s)." << endl;
+        cerr << "--summary\t\t\tReports the number of differences, the first "
+            "and last one for each signal and scope instead of each difference." << endl;
+        cerr << "--columnar\t\t\tStores value changes per variable and compares "
+            "variables in parallel." << endl;
+        cerr << "--columnar-mem=<MB>\t\tMemory used to store value changes and differences in the "
+            "columnar mode, the rest is moved to temporary files (default: no limit)." << endl;
+        cerr << "--partitioned\t\t\tSplits the simulation time into windows compared "
+            "in parallel (VCD files only)." << endl;
+        cerr << "--stats\t\t\t\tReports time spent in each phase, "
+            "event counters and memory usage." << endl;
+        cerr << "--trace=<file>\t\t\tSaves a timeline of the internal phases "
+            "in Chrome trace format (e.g. for Perfetto)." << endl;
+        cerr << "--progress[=<s>]\t\tReports progress every <s> seconds "
+            "(default: 10, 0 disables periodic reports) and on SIGUSR1." << endl;
+        cerr << "--profile[=<n>]\t\t\tReports <n> most active signals, scopes and "
+            "links with the most mismatches (default: 20)." << endl;
+        cerr << "--mem-report[=<n>]\t\tReports estimated memory used by each kind of "
+            "objects and <n> largest scope subtrees (default: 20)." << endl;
+        cerr << "--mem-limit=<MB>\t\tMemory limit, when it is close unlinked variables "
+            "are dropped and fewer data is buffered; if it is exceeded anyway, "
+            "vcdiff stops with an error." << endl;
+        cerr << "--digest[=<t>]\t\t\tCompares per-signal digests and reports the first "
+            "time bucket of <t> time units that differs (default: 1000000)." << endl;
+        cerr << "--digest-save\t\t\tSaves digests to <file>.digest sidecar files, "
+            "reused while the dumps do not change (implies --digest)." << endl;
+        cerr << "--structure\t\t\tCompares only the hierarchy: scopes, variables, "
+            "sizes, types and ranges (value changes are not read), exits with 1 "
+            "if they differ." << endl;
+        cerr << "--map-cache=<dir>\t\tStores the signal mapping in <dir> and reuses it "
+            "for files with the same headers." << endl;
+        cerr << "--map-file=<file>\t\tMatches variables listed in <file>, each line "
+            "contains a pair of names (e.g. 'tb.uut.cnt tb.dut.counter')." << endl;
+        cerr << "--fuzzy\t\t\t\tMatches the remaining variables that have similar "
+            "names, the same size and type." << endl;
+        cerr << "--rewrite=<from>=<to>\t\tReplaces <from> with <to> in scope and variable "
+            "names (e.g. '(=[' and ')=]'), might be repeated." << endl;
+        cerr << "--context=<n>\t\t\tPrints <n> previous values of the variables "
+            "together with each reported difference." << endl;
+        cerr << "--db=<file>\t\t\tSaves the differences to an indexed database "
+            "instead of printing them, see 'vcdiff query'." << endl;
+        cerr << "-j<n>, --threads=<n>\t\tNumber of threads used for signal mapping "
+            "and comparison (default: number of cores)." << endl;
 
         cerr << endl;
         cerr << "-r<flag>\t\t\tModifies rules when mapping variables between files, "
@@ -143,7 +302,7 @@ int main(int argc, char*argv[]) {
         return 0;
     }
 
-    while((opt = getopt(argc, argv, "r:S:W:s")) != -1) {
+    while((opt = getopt_long(argc, argv, "r:S:W:sj:", long_options, NULL)) != -1) {
         switch(opt) {
             case 'r':
                 for(opt_ptr = ignore_options; opt_ptr->name; ++opt_ptr) {
@@ -183,31 +342,151 @@ int main(int argc, char*argv[]) {
             case 's':
                 compare_states = true;
                 break;
+
+            case 'j':
+                threads = atoi(optarg);
+                break;
+
+            case OPT_COLUMNAR:
+                columnar_mode = true;
+                break;
+
+            case OPT_PARTITIONED:
+                partitioned_mode = true;
+                break;
+
+            case OPT_STATS:
+                stats_mode = true;
+                break;
+
+            case OPT_TRACE:
+                trace_file = optarg;
+                break;
+
+            case OPT_PROGRESS:
+                progress_interval = optarg ? atoi(optarg) : 10;
+                break;
+
+            case OPT_PROFILE:
+                profile_count = optarg ? atoi(optarg) : 20;
+                break;
+
+            case OPT_MEM_REPORT:
+                mem_report_count = optarg ? atoi(optarg) : 20;
+                break;
+
+            case OPT_DIGEST:
+                digest_bucket = optarg ? strtoul(optarg, NULL, 10) : 1000000;
+                break;
+
+            case OPT_DIGEST_SAVE:
+                digest_save = true;
+                break;
+
+            case OPT_STRUCTURE:
+                structure_mode = true;
+                break;
+
+            case OPT_MAP_CACHE:
+                map_cache_dir = optarg;
+                break;
+
+            case OPT_MAP_FILE:
+                map_file = optarg;
+                break;
+
+            case OPT_FUZZY:
+                fuzzy_match = true;
+                break;
+
+            case OPT_REWRITE:
+                if(!rewrite_rules.add(optarg)) {
+                    cerr << "Error: Invalid rewrite rule '" << optarg
+                        << "', expected <from>=<to>." << endl;
+                    return 1;
+                }
+                break;
+
+            case OPT_CONTEXT:
+                context_depth = strtoul(optarg, NULL, 10);
+                break;
+
+            case OPT_DB:
+                db_file = optarg;
+                break;
+
+            case OPT_INTERVALS:
+                intervals_mode = true;
+                compare_states = true;
+                break;
+
+            case OPT_SUMMARY:
+                summary_mode = true;
+                break;
+
+            case OPT_MEM_LIMIT:
+                mem_limit = strtoul(optarg, NULL, 10);
+                break;
+
+            case OPT_COLUMNAR_MEM:
+                columnar_mem = strtoul(optarg, NULL, 10);
+                break;
         }
     }
 
+    // Differences are reported in a single way
+    if(intervals_mode + summary_mode + (db_file != NULL) + (context_depth > 0) > 1) {
+        cerr << "Error: Only one of --intervals, --summary, --db and --context "
+            "might be used." << endl;
+        return 1;
+    }
+
+    if(threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    rewrite_rules.compile();
+
+    if(digest_save && digest_bucket == 0)
+        digest_bucket = 1000000;
+
+    if(trace_file && !trace_start(trace_file)) {
+        std::cerr << "Error: Could not create file " << trace_file << std::endl;
+        return 1;
+    }
+
     if(getenv("TEST_VCDIFF")) {
         disable_all(warn_options);
         test_mode = true;
     }
 
-    VcdFile file1(argv[argc - 2]);
+    WaveFile*file1 = WaveFile::open(argv[argc - 2]);
 
-    if(!file1.valid()) {
-        std::cerr << "Error: Could not open file " << file1.filename() << std::endl;
+    if(!file1->valid()) {
+        std::cerr << "Error: Could not open file " << file1->filename() << std::endl;
+        delete file1;
         return 1;
     }
 
-    VcdFile file2(argv[argc - 1]);
+    WaveFile*file2 = WaveFile::open(argv[argc - 1]);
 
-    if(!file2.valid()) {
-        std::cerr << "Error: Could not open file " << file2.filename() << std::endl;
+    if(!file2->valid()) {
+        std::cerr << "Error: Could not open file " << file2->filename() << std::endl;
+        delete file1;
+        delete file2;
         return 1;
     }
 
-    Comparator comp(file1, file2);
-    comp.compare();
+    if(progress_interval >= 0)
+        progress_start(file1->filename(), file2->filename(), progress_interval);
 
-    return 0;
+    Comparator*comp = new Comparator(*file1, *file2);
+    int res = comp->compare();
+    progress_stop();
+
+    delete comp;
+    delete file1;
+    delete file2;
+
+    return res;
 }
 
@@ -0,0 +1,278 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mapcache.h"
+#include "options.h"
+#include "wavefile.h"
+
+#include <cstdio>
+#include <fstream>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const char MAPCACHE_MAGIC[] = "vcdiff-map 1";
+
+// FNV-1a, the result has to be the same in every run
+static inline void hash_add(uint64_t&hash, const string&str) {
+    for(char c : str) {
+        hash ^= (unsigned char) c;
+        hash *= 0x100000001b3ULL;
+    }
+
+    // Separator, so ("ab", "c") differs from ("a", "bc")
+    hash ^= 0xff;
+    hash *= 0x100000001b3ULL;
+}
+
+static inline void hash_add(uint64_t&hash, long value) {
+    hash_add(hash, to_string(value));
+}
+
+// Empty strings are stored as "-"
+static inline string encode(const string&str) {
+    return str.empty() ? "-" : str;
+}
+
+static inline string decode(const string&str) {
+    return str == "-" ? "" : str;
+}
+
+MappingCache::MappingCache(const string&dir, WaveFile&file1, WaveFile&file2,
+        uint64_t rules)
+    : unmatched(0) {
+    uint64_t hash1 = 0xcbf29ce484222325ULL, hash2 = hash1;
+    char name[96];
+
+    index_file(0, file1.root_scope(), hash1);
+    index_file(1, file2.root_scope(), hash2);
+
+    // Options that change the mapping are a part of the key
+    snprintf(name, sizeof(name), "/%016lx-%016lx-%d%d%d-%016lx.map",
+            (unsigned long) hash1, (unsigned long) hash2,
+            ignore_var_type, ignore_var_index, fuzzy_match, (unsigned long) rules);
+    path_ = dir + name;
+}
+
+void MappingCache::index_file(unsigned int file, Scope&scope, uint64_t&hash) {
+    // The root scope is named after the file, so its name is skipped
+    if(scope.parent())
+        hash_add(hash, "S" + scope.name());
+
+    indexes_[file][&scope] = scopes_[file].size();
+    scopes_[file].push_back(&scope);
+
+    for(auto&subscope : scope.scopes())
+        index_file(file, *subscope.second, hash);
+
+    hash_add(hash, "U");
+
+    // Vector elements follow their vectors
+    vector<Variable*> stack;
+
+    for(auto it = scope.variables().rbegin(); it != scope.variables().rend(); ++it)
+        stack.push_back(it->second);
+
+    while(!stack.empty()) {
+        Variable*var = stack.back();
+        stack.pop_back();
+
+        indexes_[file][var] = vars_[file].size();
+        vars_[file].push_back(var);
+
+        hash_add(hash, (dynamic_cast<Alias*>(var) ? "A" : "V") + var->full_name());
+        hash_add(hash, var->ident());
+        hash_add(hash, var->type());
+        hash_add(hash, var->size());
+        hash_add(hash, var->index());
+
+        if(Vector*vec = dynamic_cast<Vector*>(var)) {
+            hash_add(hash, vec->left_idx());
+            hash_add(hash, vec->right_idx());
+
+            for(int i = vec->min_idx(); i <= vec->max_idx(); ++i)
+                stack.push_back((*vec)[vec->max_idx() + vec->min_idx() - i]);
+        }
+    }
+}
+
+void MappingCache::add_link(const Variable*var1, const Variable*var2) {
+    links.push_back(make_pair(indexes_[0][var1], indexes_[1][var2]));
+}
+
+void MappingCache::add_reversed(unsigned int file, const Vector*vec) {
+    reversed.push_back(make_pair(file, indexes_[file][vec]));
+}
+
+void MappingCache::add_event(Event::type_t type, unsigned int file,
+        const void*first, const void*second, const string&what,
+        const string&value1, const string&value2) {
+    Event event;
+    event.type = type;
+    event.file = file;
+
+    if(type == Event::MISMATCH || type == Event::RENAMED) {
+        event.first = indexes_[0][first];
+        event.second = indexes_[1][second];
+    } else {
+        event.first = indexes_[file][first];
+        event.second = 0;
+    }
+
+    event.what = what;
+    event.value1 = value1;
+    event.value2 = value2;
+    events.push_back(event);
+}
+
+bool MappingCache::load() {
+    ifstream file(path_);
+    string line, label;
+    unsigned long count;
+
+    if(!getline(file, line) || line != MAPCACHE_MAGIC)
+        return false;
+
+    if(!(file >> label >> unmatched) || label != "unmatched")
+        return false;
+
+    if(!(file >> label >> count) || label != "links")
+        return false;
+
+    links.resize(count);
+
+    for(auto&link : links) {
+        if(!(file >> link.first >> link.second))
+            return false;
+    }
+
+    if(!(file >> label >> count) || label != "reversed")
+        return false;
+
+    reversed.resize(count);
+
+    for(auto&vec : reversed) {
+        if(!(file >> vec.first >> vec.second))
+            return false;
+    }
+
+    if(!(file >> label >> count) || label != "events")
+        return false;
+
+    events.resize(count);
+
+    for(Event&event : events) {
+        int type;
+
+        if(!(file >> type >> event.file >> event.first >> event.second
+                    >> event.what >> event.value1 >> event.value2))
+            return false;
+
+        event.type = static_cast<Event::type_t>(type);
+        event.what = decode(event.what);
+        event.value1 = decode(event.value1);
+        event.value2 = decode(event.value2);
+    }
+
+    return validate();
+}
+
+bool MappingCache::validate() const {
+    vector<bool> linked[2] = { vector<bool>(vars_[0].size()),
+        vector<bool>(vars_[1].size()) };
+
+    for(const auto&link : links) {
+        if(link.first >= vars_[0].size() || link.second >= vars_[1].size()
+                || linked[0][link.first] || linked[1][link.second])
+            return false;
+
+        linked[0][link.first] = linked[1][link.second] = true;
+    }
+
+    for(const auto&vec : reversed) {
+        if(vec.first > 1 || vec.second >= vars_[vec.first].size()
+                || !dynamic_cast<Vector*>(vars_[vec.first][vec.second]))
+            return false;
+    }
+
+    for(const Event&event : events) {
+        switch(event.type) {
+            case Event::MISSING_SCOPE:
+                if(event.file > 1 || event.first >= scopes_[event.file].size())
+                    return false;
+                break;
+
+            case Event::MISSING_VARIABLE:
+                if(event.file > 1 || event.first >= vars_[event.file].size())
+                    return false;
+                break;
+
+            case Event::MISMATCH:
+            case Event::RENAMED:
+                if(event.first >= vars_[0].size() || event.second >= vars_[1].size())
+                    return false;
+                break;
+
+            default:
+                return false;
+        }
+    }
+
+    return true;
+}
+
+bool MappingCache::save() const {
+    string dir = path_.substr(0, path_.rfind('/'));
+    mkdir(dir.c_str(), 0755);
+
+    // Written to a temporary file first, so concurrent runs do not read
+    // an incomplete entry
+    string tmp_path = path_ + "." + to_string(getpid());
+    FILE*file = fopen(tmp_path.c_str(), "w");
+
+    if(!file)
+        return false;
+
+    fprintf(file, "%s\nunmatched %lu\nlinks %lu\n", MAPCACHE_MAGIC, unmatched,
+            (unsigned long) links.size());
+
+    for(const auto&link : links)
+        fprintf(file, "%lu %lu\n", link.first, link.second);
+
+    fprintf(file, "reversed %lu\n", (unsigned long) reversed.size());
+
+    for(const auto&vec : reversed)
+        fprintf(file, "%u %lu\n", vec.first, vec.second);
+
+    fprintf(file, "events %lu\n", (unsigned long) events.size());
+
+    for(const Event&event : events) {
+        fprintf(file, "%d %u %lu %lu %s %s %s\n", event.type, event.file,
+                event.first, event.second, encode(event.what).c_str(),
+                encode(event.value1).c_str(), encode(event.value2).c_str());
+    }
+
+    if(fclose(file) != 0 || rename(tmp_path.c_str(), path_.c_str()) != 0) {
+        unlink(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
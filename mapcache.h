@@ -0,0 +1,120 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAPCACHE_H
+#define MAPCACHE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class Scope;
+class Variable;
+class Vector;
+class WaveFile;
+
+/**
+ * @brief Results of Comparator::map_signals() stored in a cache directory.
+ * Entries are keyed by fingerprints of both headers, and variables are
+ * referred to by their position in the hierarchy, so a cached mapping
+ * is valid for any pair of files with the same headers.
+ */
+class MappingCache {
+public:
+    ///> Message reported while mapping, replayed when the cache is loaded
+    struct Event {
+        enum type_t { MISSING_SCOPE, MISSING_VARIABLE, MISMATCH, RENAMED };
+
+        type_t type;
+
+        // File that contains the missing scope or variable (0 or 1)
+        unsigned int file;
+
+        // Missing scope or variable, mismatching or renamed variables
+        unsigned long first, second;
+
+        // Mismatching property and its values
+        std::string what, value1, value2;
+    };
+
+    /**
+     * @param rules is a fingerprint of the explicitly listed pairs.
+     */
+    MappingCache(const std::string&dir, WaveFile&file1, WaveFile&file2,
+            uint64_t rules);
+
+    /**
+     * @brief Loads the cached mapping for the files.
+     * @return false if there is no valid entry.
+     */
+    bool load();
+
+    /**
+     * @brief Stores the recorded mapping.
+     */
+    bool save() const;
+
+    inline const std::string&path() const {
+        return path_;
+    }
+
+    // Recording
+    void add_link(const Variable*var1, const Variable*var2);
+    void add_reversed(unsigned int file, const Vector*vec);
+    void add_event(Event::type_t type, unsigned int file,
+            const void*first, const void*second = NULL,
+            const std::string&what = "", const std::string&value1 = "",
+            const std::string&value2 = "");
+
+    inline Scope*scope(unsigned int file, unsigned long index) const {
+        return scopes_[file][index];
+    }
+
+    inline Variable*variable(unsigned int file, unsigned long index) const {
+        return vars_[file][index];
+    }
+
+    ///> Number of variables that could not be matched
+    unsigned long unmatched;
+
+    ///> Linked variables (first file, second file) ordered by link ids
+    std::vector<std::pair<unsigned long, unsigned long> > links;
+
+    ///> Vectors with reversed ranges (file, variable)
+    std::vector<std::pair<unsigned int, unsigned long> > reversed;
+
+    std::vector<Event> events;
+
+private:
+    // Lists scopes and variables (including vector elements) in a fixed
+    // order and computes the header fingerprint
+    void index_file(unsigned int file, Scope&scope, uint64_t&hash);
+
+    // Checks if the loaded indexes refer to existing objects
+    bool validate() const;
+
+    std::string path_;
+
+    std::vector<Scope*> scopes_[2];
+    std::vector<Variable*> vars_[2];
+    std::unordered_map<const void*, unsigned long> indexes_[2];
+};
+
+#endif /* MAPCACHE_H */
@@ -0,0 +1,192 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "memusage.h"
+#include "link.h"
+#include "scope.h"
+#include "wavefile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace std;
+
+MemUsage::MemUsage() {
+    for(unsigned int i = 0; i < KINDS; ++i) {
+        bytes[i] = 0;
+        objects[i] = 0;
+    }
+}
+
+void MemUsage::merge(const MemUsage&other) {
+    for(unsigned int i = 0; i < KINDS; ++i) {
+        bytes[i] += other.bytes[i];
+        objects[i] += other.objects[i];
+    }
+}
+
+size_t MemUsage::total() const {
+    size_t res = 0;
+
+    for(unsigned int i = 0; i < KINDS; ++i)
+        res += bytes[i];
+
+    return res;
+}
+
+const char*MemUsage::kind_name(kind_t kind) {
+    switch(kind) {
+        case SCOPES:    return "scopes";
+        case SCALARS:   return "scalars";
+        case VECTORS:   return "vectors";
+        case ALIASES:   return "aliases";
+        case NAMES:     return "names";
+        case VALUES:    return "values";
+        case LINKS:     return "links";
+        case IDENTS:    return "identifier maps";
+        default:        return "unknown";
+    }
+}
+
+size_t MemUsage::alloc_size(size_t size) {
+    // Typical malloc() implementation: 8 bytes of header, 16 bytes
+    // alignment and 32 bytes the smallest chunk
+    size_t chunk = (size + 8 + 15) & ~15;
+    return max(chunk, (size_t) 32);
+}
+
+size_t MemUsage::string_size(const string&str) {
+    // Short strings are stored in the object itself
+    const char*data = str.data();
+    const char*object = reinterpret_cast<const char*>(&str);
+
+    if(data >= object && data < object + sizeof(str))
+        return 0;
+
+    return alloc_size(str.capacity() + 1);
+}
+
+size_t mem_resident() {
+    unsigned long size, resident = 0;
+    FILE*statm = fopen("/proc/self/statm", "r");
+
+    if(statm) {
+        if(fscanf(statm, "%lu %lu", &size, &resident) != 2)
+            resident = 0;
+
+        fclose(statm);
+    }
+
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+///> Memory used by a scope subtree
+struct ScopeUsage {
+    const Scope*scope;
+    MemUsage usage;
+};
+
+// Computes memory used by a scope and its subscopes, the results for
+// all subtrees are appended to a list
+static MemUsage scope_usage(const Scope&scope, vector<ScopeUsage>&results) {
+    MemUsage usage;
+    scope.mem_usage(usage);
+
+    for(const auto&subscope : scope.scopes())
+        usage.merge(scope_usage(*subscope.second, results));
+
+    ScopeUsage res;
+    res.scope = &scope;
+    res.usage = usage;
+    results.push_back(res);
+
+    return usage;
+}
+
+static void print_line(ostream&out, const char*name, unsigned long objects,
+        size_t bytes) {
+    char line[128];
+    snprintf(line, sizeof(line), "  %-20s %12lu %14lu", name, objects, (unsigned long) bytes);
+    out << line << endl;
+}
+
+void print_mem_report(ostream&out, unsigned int count,
+        WaveFile&file1, WaveFile&file2, const list<Link*>&links) {
+    vector<ScopeUsage> scopes;
+    MemUsage total;
+
+    for(WaveFile*file : { &file1, &file2 }) {
+        total.merge(scope_usage(file->root_scope(), scopes));
+
+        for(const auto&entry : file->idents()) {
+            total.add(MemUsage::IDENTS,
+                    MemUsage::tree_node_size<VarStringMap::value_type>()
+                    + MemUsage::string_size(entry.first));
+        }
+    }
+
+    // Names shared by both files
+    interned_names_usage(total);
+
+    // Link objects and the list nodes
+    total.add(MemUsage::LINKS, links.size() * (MemUsage::alloc_size(sizeof(Link))
+                + MemUsage::alloc_size(2 * sizeof(void*) + sizeof(Link*))), links.size());
+
+    out << "Estimated memory usage:" << endl;
+    char line[128];
+    snprintf(line, sizeof(line), "  %-20s %12s %14s", "kind", "objects", "bytes");
+    out << line << endl;
+
+    unsigned long objects = 0;
+
+    for(unsigned int i = 0; i < MemUsage::KINDS; ++i) {
+        MemUsage::kind_t kind = static_cast<MemUsage::kind_t>(i);
+        print_line(out, MemUsage::kind_name(kind), total.objects[i], total.bytes[i]);
+        objects += total.objects[i];
+    }
+
+    print_line(out, "total", objects, total.total());
+    out << endl;
+
+    sort(scopes.begin(), scopes.end(), [](const ScopeUsage&a, const ScopeUsage&b) {
+            if(a.usage.total() != b.usage.total())
+                return a.usage.total() > b.usage.total();
+
+            return a.scope->full_name() < b.scope->full_name();
+        });
+
+    out << "Scope subtrees using the most memory:" << endl;
+    snprintf(line, sizeof(line), "  %14s %14s %14s %14s  ", "bytes", "variables",
+            "names", "values");
+    out << line << "scope" << endl;
+
+    for(unsigned int i = 0; i < scopes.size() && i < count; ++i) {
+        const MemUsage&usage = scopes[i].usage;
+        size_t vars = usage.bytes[MemUsage::SCALARS] + usage.bytes[MemUsage::VECTORS]
+            + usage.bytes[MemUsage::ALIASES];
+
+        snprintf(line, sizeof(line), "  %14lu %14lu %14lu %14lu  ",
+                (unsigned long) usage.total(), (unsigned long) vars,
+                (unsigned long) usage.bytes[MemUsage::NAMES],
+                (unsigned long) usage.bytes[MemUsage::VALUES]);
+        out << line << scopes[i].scope->full_name() << endl;
+    }
+}
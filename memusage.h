@@ -0,0 +1,111 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MEMUSAGE_H
+#define MEMUSAGE_H
+
+#include <cstddef>
+#include <list>
+#include <ostream>
+#include <string>
+#include <utility>
+
+#include "value.h"
+
+class Link;
+class WaveFile;
+
+/**
+ * @brief Estimated heap memory used by objects, split by their kind.
+ * Sizes include the typical allocator overhead, so they are close to
+ * the real memory usage, but they are not exact.
+ */
+class MemUsage {
+public:
+    enum kind_t {
+        SCOPES, SCALARS, VECTORS, ALIASES, NAMES, VALUES, LINKS, IDENTS, KINDS
+    };
+
+    MemUsage();
+
+    inline void add(kind_t kind, size_t size, unsigned long count = 1) {
+        bytes[kind] += size;
+        objects[kind] += count;
+    }
+
+    /**
+     * @brief Adds a name, only strings stored on the heap are counted.
+     */
+    inline void add_name(const std::string&str) {
+        size_t size = string_size(str);
+
+        if(size > 0)
+            add(NAMES, size);
+    }
+
+    void merge(const MemUsage&other);
+
+    size_t total() const;
+
+    static const char*kind_name(kind_t kind);
+
+    /**
+     * @brief Returns the memory used by a heap block of the given size.
+     */
+    static size_t alloc_size(size_t size);
+
+    /**
+     * @brief Returns the heap memory used by a string, 0 if the string
+     * is stored in the object itself.
+     */
+    static size_t string_size(const std::string&str);
+
+    /**
+     * @brief Returns the heap memory used by a Value buffer.
+     */
+    static inline size_t value_size(const Value&value) {
+        return value.type == Value::VECTOR ? alloc_size(value.size) : 0;
+    }
+
+    /**
+     * @brief Returns the memory used by a std::map or std::set node.
+     */
+    template<typename T>
+    static inline size_t tree_node_size() {
+        // Color and three pointers precede the stored value
+        return alloc_size(4 * sizeof(void*) + sizeof(T));
+    }
+
+    size_t bytes[KINDS];
+    unsigned long objects[KINDS];
+};
+
+/**
+ * @brief Returns the resident memory size of the process in bytes.
+ */
+size_t mem_resident();
+
+/**
+ * @brief Prints memory usage of both files per object kind and the scope
+ * subtrees using the most memory.
+ * @param count is the number of listed scopes.
+ */
+void print_mem_report(std::ostream&out, unsigned int count,
+        WaveFile&file1, WaveFile&file2, const std::list<Link*>&links);
+
+#endif /* MEMUSAGE_H */
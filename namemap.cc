@@ -0,0 +1,209 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "namemap.h"
+#include "options.h"
+#include "rewrite.h"
+#include "scope.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+// FNV-1a, the result has to be the same in every run
+static inline void hash_add(uint64_t&hash, const string&str) {
+    for(char c : str) {
+        hash ^= (unsigned char) c;
+        hash *= 0x100000001b3ULL;
+    }
+
+    hash ^= 0xff;
+    hash *= 0x100000001b3ULL;
+}
+
+// Splits a hierarchical name on the dots outside of brackets, so indexed
+// scope names (e.g. 'gen_blk[3]') stay in one piece
+static vector<string> split_name(const string&name) {
+    vector<string> parts(1);
+    int depth = 0;
+
+    for(char c : name) {
+        if(c == '[' || c == '(')
+            ++depth;
+        else if((c == ']' || c == ')') && depth > 0)
+            --depth;
+
+        if(c == '.' && depth == 0)
+            parts.push_back(string());
+        else
+            parts.back() += c;
+    }
+
+    return parts;
+}
+
+string NameMapping::normalize(const string&name) {
+    vector<string> parts = split_name(name);
+    string result;
+
+    // Names are stored the same way as while parsing the files
+    for(string&part : parts) {
+        part = rewrite_rules.apply(part.c_str());
+
+        if(!ignore_case)
+            transform(part.begin(), part.end(), part.begin(), ::tolower);
+    }
+
+    // A range denotes the whole vector, it is not a part of the stored name
+    string&last = parts.back();
+    size_t bracket = last.rfind('[');
+    int left, right;
+
+    if(bracket != string::npos
+            && sscanf(last.c_str() + bracket, "[%d:%d]", &left, &right) == 2)
+        last.erase(bracket);
+
+    for(const string&part : parts) {
+        if(!result.empty())
+            result += '.';
+
+        result += part;
+    }
+
+    return result;
+}
+
+bool NameMapping::load(const string&path) {
+    ifstream file(path);
+    string line;
+    unsigned int line_number = 0;
+
+    path_ = path;
+    entries_.clear();
+    index_[0].clear();
+    index_[1].clear();
+    fingerprint_ = 0xcbf29ce484222325ULL;
+
+    if(!file) {
+        cerr << "Error: Could not open mapping file " << path << "." << endl;
+        return false;
+    }
+
+    while(getline(file, line)) {
+        istringstream fields(line);
+        Entry entry;
+        string extra;
+
+        ++line_number;
+
+        if(!(fields >> entry.name1) || entry.name1[0] == '#')
+            continue;
+
+        if(!(fields >> entry.name2) || (fields >> extra)) {
+            cerr << "Error: " << path << ":" << line_number
+                << ": expected a pair of variable names." << endl;
+            return false;
+        }
+
+        entry.name1 = normalize(entry.name1);
+        entry.name2 = normalize(entry.name2);
+
+        // A variable might be linked only once
+        bool listed1 = index_[0].count(entry.name1);
+
+        if(listed1 || index_[1].count(entry.name2)) {
+            cerr << "Warning: " << path << ":" << line_number << ": '"
+                << (listed1 ? entry.name1 : entry.name2)
+                << "' is already mapped, skipping." << endl;
+            continue;
+        }
+
+        entry.line = line_number;
+        index_[0][entry.name1] = entries_.size();
+        index_[1][entry.name2] = entries_.size();
+        entries_.push_back(entry);
+
+        hash_add(fingerprint_, entry.name1);
+        hash_add(fingerprint_, entry.name2);
+    }
+
+    return true;
+}
+
+int NameMapping::find(unsigned int file, const Variable&var,
+        const Scope&root) const {
+    const auto&index = index_[file];
+
+    if(index.empty())
+        return -1;
+
+    // Name relative to the root scope, as in the mapping file
+    const string&scope_name = var.scope()->full_name();
+    size_t root_length = root.full_name().size();
+    string name;
+
+    if(scope_name.size() > root_length)
+        name = scope_name.substr(root_length + 1) + ".";
+
+    name += var.name();
+
+    auto it = index.find(name);
+
+    return it != index.end() ? (int) it->second : -1;
+}
+
+Variable*NameMapping::find_variable(Scope&root, const string&name) {
+    vector<string> parts = split_name(name);
+    Scope*scope = &root;
+
+    // Scope names are separated with dots, the last part is the variable
+    for(unsigned int i = 0; i < parts.size() - 1; ++i) {
+        scope = scope->get_scope(parts[i]);
+
+        if(!scope)
+            return NULL;
+    }
+
+    // Indexes select bits or words of a vector, as in the parsed files
+    const string&last = parts.back();
+    size_t bracket = last.find('[');
+    Variable*var = scope->get_variable(last.substr(0, bracket));
+
+    while(var && bracket != string::npos) {
+        int idx;
+
+        if(sscanf(last.c_str() + bracket, "[%d]", &idx) != 1)
+            return NULL;
+
+        if(Alias*alias = dynamic_cast<Alias*>(var))
+            var = alias->target();
+
+        if(!var->is_vector() || !static_cast<Vector*>(var)->is_valid_idx(idx))
+            return NULL;
+
+        var = (*static_cast<Vector*>(var))[idx];
+        bracket = last.find('[', bracket + 1);
+    }
+
+    return var;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NAMEMAP_H
+#define NAMEMAP_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Scope;
+class Variable;
+
+/**
+ * @brief Explicit pairs of variable names, read from a mapping file.
+ * Each line contains a variable name from the first file and the name of
+ * the matching variable from the second file, separated with whitespace.
+ * Names include the scope hierarchy without the root scope, e.g.
+ * 'tb.uut.counter'. Indexes select bits or words of vectors (e.g.
+ * 'tb.gen_blk[3].data[0]'). Names are folded and rewritten the same way as
+ * the names read from the files. Empty lines and lines starting with '#'
+ * are skipped.
+ */
+class NameMapping {
+public:
+    struct Entry {
+        std::string name1, name2;
+
+        // Line in the mapping file
+        unsigned int line;
+    };
+
+    /**
+     * @brief Reads a mapping file, errors are reported to stderr.
+     */
+    bool load(const std::string&path);
+
+    inline const std::string&path() const {
+        return path_;
+    }
+
+    ///> Pairs in the file order
+    inline const std::vector<Entry>&entries() const {
+        return entries_;
+    }
+
+    ///> Hash of the pairs, used to key cached mappings
+    inline uint64_t fingerprint() const {
+        return fingerprint_;
+    }
+
+    /**
+     * @brief Finds the entry that lists a variable.
+     * @param file is 0 for the first file, 1 for the second one.
+     * @param root is the root scope of the file.
+     * @return Index of the entry or -1 if the variable is not listed.
+     */
+    int find(unsigned int file, const Variable&var, const Scope&root) const;
+
+    /**
+     * @brief Finds a variable by its normalized name relative to the root
+     * scope.
+     * @return NULL if there is no such variable.
+     */
+    static Variable*find_variable(Scope&root, const std::string&name);
+
+    /**
+     * @brief Applies the case folding and rewrite rules used for the names
+     * read from the files, drops a range that denotes the whole vector.
+     */
+    static std::string normalize(const std::string&name);
+
+private:
+    std::string path_;
+    std::vector<Entry> entries_;
+
+    // Listed names of both files, pointing to the entries
+    std::unordered_map<std::string, unsigned int> index_[2];
+
+    uint64_t fingerprint_;
+};
+
+#endif /* NAMEMAP_H */
@@ -0,0 +1,65 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "options.h"
+
+#include <cstddef>
+
+// Variable matching rules
+bool ignore_case        = false;
+bool ignore_var_type    = false;
+bool ignore_var_index   = false;
+
+// Skipped scopes
+bool skip_module        = false;
+bool skip_function      = false;
+bool skip_task          = false;
+
+// Warnings
+bool warn_missing_scopes    = true;
+bool warn_missing_vars      = true;
+bool warn_missing_tstamps   = true;
+bool warn_duplicate_vars    = true;
+bool warn_unexpected_tokens = true;
+bool warn_size_mismatch     = true;
+bool warn_type_mismatch     = true;
+
+bool compare_states = false;
+bool intervals_mode = false;
+bool summary_mode = false;
+bool test_mode = false;
+
+bool columnar_mode = false;
+unsigned int threads = 0;
+unsigned long columnar_mem = 0;
+bool partitioned_mode = false;
+
+bool stats_mode = false;
+const char*trace_file = NULL;
+int progress_interval = -1;
+unsigned int profile_count = 0;
+unsigned int mem_report_count = 0;
+unsigned long mem_limit = 0;
+unsigned long digest_bucket = 0;
+bool digest_save = false;
+bool structure_mode = false;
+const char*map_cache_dir = NULL;
+const char*map_file = NULL;
+bool fuzzy_match = false;
+unsigned int context_depth = 0;
+const char*db_file = NULL;
@@ -36,8 +36,30 @@ extern bool warn_size_mismatch;
 extern bool warn_type_mismatch;
 
 extern bool compare_states;
+extern bool intervals_mode;
+extern bool summary_mode;
 
 extern bool test_mode;
 
+extern bool columnar_mode;
+extern unsigned int threads;
+extern unsigned long columnar_mem;
+extern bool partitioned_mode;
+
+extern bool stats_mode;
+extern const char*trace_file;
+extern int progress_interval;
+extern unsigned int profile_count;
+extern unsigned int mem_report_count;
+extern unsigned long mem_limit;
+extern unsigned long digest_bucket;
+extern bool digest_save;
+extern bool structure_mode;
+extern const char*map_cache_dir;
+extern const char*map_file;
+extern bool fuzzy_match;
+extern unsigned int context_depth;
+extern const char*db_file;
+
 #endif /* OPTIONS_H */
 
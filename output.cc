@@ -0,0 +1,251 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "output.h"
+#include "link.h"
+#include "options.h"
+#include "trace.h"
+#include "variable.h"
+
+#include <cstring>
+#include <sstream>
+
+using namespace std;
+
+// Batches are passed to the writer when they reach this size (in bytes)
+static const unsigned int BATCH_SIZE = 256 * 1024;
+
+// Number of batches waiting for the writer, the comparison waits above it
+static const unsigned int MAX_QUEUE = 16;
+
+// Formatted output is written in chunks of this size (in bytes)
+static const unsigned int BUFFER_SIZE = 4 * 1024 * 1024;
+
+AsyncOutput::AsyncOutput(ostream&out, ostream&err)
+    : out_(out), err_(err), finished_(false), current_(new Batch),
+    header_(false), last_time_(0) {
+    thread_ = thread(&AsyncOutput::writer, this);
+}
+
+AsyncOutput::~AsyncOutput() {
+    finish();
+
+    delete current_;
+
+    for(Batch*batch : free_)
+        delete batch;
+}
+
+void AsyncOutput::append_string(string&dst, const char*str, unsigned int len) {
+    dst.append((const char*) &len, sizeof(len));
+    dst.append(str, len);
+}
+
+void AsyncOutput::append_value(string&dst, const Variable*var, bool prev) {
+    // The length is filled in when the value is appended
+    size_t pos = dst.size();
+    dst.append(sizeof(unsigned int), '\0');
+    var->append_value_str(dst, prev);
+
+    unsigned int len = dst.size() - pos - sizeof(unsigned int);
+    memcpy(&dst[pos], &len, sizeof(len));
+}
+
+const char*AsyncOutput::read_string(const char*src, string&dst) {
+    unsigned int len;
+    memcpy(&len, src, sizeof(len));
+    src += sizeof(len);
+    dst.append(src, len);
+
+    return src + len;
+}
+
+void AsyncOutput::add(unsigned long time, const Link*link) {
+    Entry entry;
+    entry.time = time;
+    entry.link = link;
+    entry.offset = current_->values.size();
+    current_->entries.push_back(entry);
+
+    for(const Variable*var : { link->first(), link->second() }) {
+        // Transitions are shown as in Link::value_str()
+        bool changed = !compare_states && var->changed();
+        current_->values += (char) changed;
+
+        if(changed)
+            append_value(current_->values, var, true);
+
+        append_value(current_->values, var, false);
+    }
+
+    if(current_->values.size() >= BATCH_SIZE)
+        submit();
+}
+
+void AsyncOutput::message(const string&text) {
+    Entry entry;
+    entry.time = 0;
+    entry.link = NULL;
+    entry.offset = current_->values.size();
+    current_->entries.push_back(entry);
+    append_string(current_->values, text.data(), text.size());
+
+    // Messages are rare, keep them close to the time they are reported
+    submit();
+}
+
+void AsyncOutput::submit() {
+    unique_lock<mutex> lock(mutex_);
+    cond_.wait(lock, [this]() { return queue_.size() < MAX_QUEUE; });
+    queue_.push_back(current_);
+
+    if(free_.empty()) {
+        current_ = new Batch;
+    } else {
+        current_ = free_.back();
+        free_.pop_back();
+    }
+
+    cond_.notify_all();
+}
+
+void AsyncOutput::finish() {
+    if(!thread_.joinable())
+        return;
+
+    if(!current_->entries.empty())
+        submit();
+
+    {
+        lock_guard<mutex> lock(mutex_);
+        finished_ = true;
+    }
+
+    cond_.notify_all();
+    thread_.join();
+}
+
+void AsyncOutput::writer() {
+    trace_thread_name("writer");
+    string buffer;
+
+    while(true) {
+        Batch*batch;
+
+        {
+            unique_lock<mutex> lock(mutex_);
+            cond_.wait(lock, [this]() { return !queue_.empty() || finished_; });
+
+            if(queue_.empty())
+                break;
+
+            batch = queue_.front();
+            queue_.pop_front();
+        }
+
+        // The comparison might wait for a free place in the queue
+        cond_.notify_all();
+
+        {
+            TRACE_SCOPE("render");
+            render(*batch, buffer);
+        }
+
+        batch->entries.clear();
+        batch->values.clear();
+
+        {
+            lock_guard<mutex> lock(mutex_);
+            free_.push_back(batch);
+        }
+
+        if(buffer.size() >= BUFFER_SIZE) {
+            TRACE_SCOPE("write");
+            out_.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+
+    out_.write(buffer.data(), buffer.size());
+    out_.flush();
+}
+
+void AsyncOutput::render(const Batch&batch, string&buffer) {
+    for(const Entry&entry : batch.entries) {
+        const char*src = batch.values.data() + entry.offset;
+
+        if(!entry.link) {
+            // Write the preceding differences first
+            out_.write(buffer.data(), buffer.size());
+            out_.flush();
+            buffer.clear();
+
+            string text;
+            read_string(src, text);
+            err_ << text << endl;
+            continue;
+        }
+
+        if(!header_ || entry.time != last_time_) {
+            buffer += "diff #" + to_string(entry.time) + "\n";
+            buffer += "==================\n";
+            header_ = true;
+            last_time_ = entry.time;
+        }
+
+        unsigned int id = entry.link->id();
+
+        if(id >= names1_.size()) {
+            names1_.resize(id + 1);
+            names2_.resize(id + 1);
+        }
+
+        // Names are aligned the same way as Link::print() does
+        if(names1_[id].empty()) {
+            stringstream s1, s2;
+            s1 << *entry.link->first();
+            s2 << *entry.link->second();
+
+            names1_[id] = s1.str();
+            names2_[id] = s2.str();
+
+            if(names1_[id].size() > names2_[id].size())
+                names2_[id].append(names1_[id].size() - names2_[id].size(), ' ');
+            else
+                names1_[id].append(names2_[id].size() - names1_[id].size(), ' ');
+
+            names1_[id] += "\t= ";
+            names2_[id] += "\t= ";
+        }
+
+        for(const string*name : { &names1_[id], &names2_[id] }) {
+            bool changed = *src++;
+            buffer += *name;
+
+            if(changed) {
+                src = read_string(src, buffer);
+                buffer += " -> ";
+            }
+
+            src = read_string(src, buffer);
+            buffer += '\n';
+        }
+
+        buffer += '\n';
+    }
+}
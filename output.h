@@ -0,0 +1,126 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Link;
+class Variable;
+
+/**
+ * @brief Prints differences on a separate thread. The comparison thread only
+ * copies the values of the mismatching variables into batches, formatting
+ * and writing to the stream is done by the writer thread. The output is
+ * the same as printed by operator<<(std::ostream&, const Link&).
+ */
+class AsyncOutput {
+public:
+    /**
+     * @param out receives the differences.
+     * @param err receives the messages added with message().
+     */
+    AsyncOutput(std::ostream&out, std::ostream&err);
+
+    /**
+     * @brief Waits until all differences are written.
+     */
+    ~AsyncOutput();
+
+    /**
+     * @brief Stores the values of a mismatching link. Differences have to be
+     * added in the printing order.
+     */
+    void add(unsigned long time, const Link*link);
+
+    /**
+     * @brief Prints a message (e.g. a warning) after the differences added
+     * so far, so both streams are ordered as if they were printed directly.
+     */
+    void message(const std::string&text);
+
+    /**
+     * @brief Writes all added differences and stops the writer thread.
+     */
+    void finish();
+
+private:
+    struct Entry {
+        unsigned long time;
+        // NULL for messages
+        const Link*link;
+
+        // Values (see add()) or message start at this offset in Batch::values
+        unsigned int offset;
+    };
+
+    struct Batch {
+        std::vector<Entry> entries;
+
+        // For each side: changed flag, previous value (if changed) and
+        // the current value, values are preceded by their lengths
+        std::string values;
+    };
+
+    // Passes the current batch to the writer, waits if the queue is full
+    void submit();
+
+    void writer();
+
+    // Formats a batch and appends it to the output buffer
+    void render(const Batch&batch, std::string&buffer);
+
+    // Appends a string preceded by its length
+    static void append_string(std::string&dst, const char*str, unsigned int len);
+
+    // Appends a variable value preceded by its length
+    static void append_value(std::string&dst, const Variable*var, bool prev);
+
+    // Appends a string stored by append_string() to the output
+    static const char*read_string(const char*src, std::string&dst);
+
+    std::ostream&out_;
+    std::ostream&err_;
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+
+    // Batches waiting for the writer, and the ones that might be reused
+    std::deque<Batch*> queue_;
+    std::vector<Batch*> free_;
+    bool finished_;
+
+    // Batch filled by the comparison thread
+    Batch*current_;
+
+    // Writer state: time of the last difference and names aligned for
+    // each link, indexed by Link::id()
+    bool header_;
+    unsigned long last_time_;
+    std::vector<std::string> names1_, names2_;
+};
+
+#endif /* OUTPUT_H */
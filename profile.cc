@@ -0,0 +1,135 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "profile.h"
+#include "link.h"
+#include "wavefile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <sstream>
+
+using namespace std;
+
+// Returns the scope of a variable, vector elements use the vector scope
+static const Scope*var_scope(const Variable*var) {
+    while(!var->scope() && var->parent())
+        var = var->parent();
+
+    return var->scope();
+}
+
+static string var_name(const Variable*var) {
+    stringstream name;
+    name << *var;
+    return name.str();
+}
+
+// Prints entries sorted by the number of changes
+static void print_activity(ostream&out, unsigned int count,
+        vector<pair<string, SignalProfile> >&entries) {
+    sort(entries.begin(), entries.end(),
+        [](const pair<string, SignalProfile>&a, const pair<string, SignalProfile>&b) {
+            if(a.second.changes != b.second.changes)
+                return a.second.changes > b.second.changes;
+
+            return a.first < b.first;
+        });
+
+    char line[64];
+    snprintf(line, sizeof(line), "  %12s %14s  ", "changes", "bytes");
+    out << line << "name" << endl;
+
+    for(unsigned int i = 0; i < entries.size() && i < count; ++i) {
+        snprintf(line, sizeof(line), "  %12lu %14lu  ",
+                entries[i].second.changes, entries[i].second.bytes);
+        out << line << entries[i].first << endl;
+    }
+}
+
+static void print_file_profile(ostream&out, unsigned int count,
+        const WaveFile&file) {
+    vector<pair<string, SignalProfile> > signals;
+    map<const Scope*, SignalProfile> scopes;
+
+    for(const auto&entry : file.profile()) {
+        signals.push_back(make_pair(var_name(entry.first), entry.second));
+
+        // Roll up the activity to all parent scopes
+        for(const Scope*scope = var_scope(entry.first);
+                scope && scope->parent(); scope = scope->parent()) {
+            SignalProfile&profile = scopes[scope];
+            profile.changes += entry.second.changes;
+            profile.bytes += entry.second.bytes;
+        }
+    }
+
+    out << "Most active signals in " << file.filename() << ":" << endl;
+    print_activity(out, count, signals);
+    out << endl;
+
+    vector<pair<string, SignalProfile> > scope_list;
+
+    for(const auto&entry : scopes)
+        scope_list.push_back(make_pair(entry.first->full_name(), entry.second));
+
+    out << "Most active scopes in " << file.filename()
+        << " (including subscopes):" << endl;
+    print_activity(out, count, scope_list);
+    out << endl;
+}
+
+void print_profile(ostream&out, unsigned int count,
+        const WaveFile&file1, const WaveFile&file2,
+        const list<Link*>&links, const vector<LinkProfile>&link_profile) {
+    print_file_profile(out, count, file1);
+    print_file_profile(out, count, file2);
+
+    vector<const Link*> sorted;
+
+    for(const Link*link : links) {
+        if(link->id() < link_profile.size() && link_profile[link->id()].compares > 0)
+            sorted.push_back(link);
+    }
+
+    sort(sorted.begin(), sorted.end(), [&](const Link*a, const Link*b) {
+            const LinkProfile&pa = link_profile[a->id()];
+            const LinkProfile&pb = link_profile[b->id()];
+
+            if(pa.mismatches != pb.mismatches)
+                return pa.mismatches > pb.mismatches;
+
+            if(pa.compares != pb.compares)
+                return pa.compares > pb.compares;
+
+            return a->id() < b->id();
+        });
+
+    char line[64];
+    out << "Compared links:" << endl;
+    snprintf(line, sizeof(line), "  %12s %14s  ", "compares", "mismatches");
+    out << line << "name" << endl;
+
+    for(unsigned int i = 0; i < sorted.size() && i < count; ++i) {
+        const LinkProfile&profile = link_profile[sorted[i]->id()];
+        snprintf(line, sizeof(line), "  %12lu %14lu  ",
+                profile.compares, profile.mismatches);
+        out << line << var_name(sorted[i]->first()) << endl;
+    }
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <list>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+class Link;
+class Variable;
+class WaveFile;
+
+///> Activity of a single identifier, collected with --profile
+struct SignalProfile {
+    SignalProfile() : changes(0), bytes(0) {}
+
+    unsigned long changes;
+
+    // Size of the value change records (value, identifier and separators)
+    unsigned long bytes;
+};
+
+typedef std::unordered_map<const Variable*, SignalProfile> SignalProfileMap;
+
+///> Comparison results of a single Link, collected with --profile
+struct LinkProfile {
+    LinkProfile() : compares(0), mismatches(0) {}
+
+    unsigned long compares, mismatches;
+};
+
+/**
+ * @brief Prints the most active signals of both files, their activity
+ * summed per scope and the links with the most mismatches.
+ * @param count is the number of entries in each list.
+ * @param link_profile is indexed by Link::id().
+ */
+void print_profile(std::ostream&out, unsigned int count,
+        const WaveFile&file1, const WaveFile&file2,
+        const std::list<Link*>&links,
+        const std::vector<LinkProfile>&link_profile);
+
+#endif /* PROFILE_H */
@@ -0,0 +1,195 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "progress.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+bool progress_enabled = false;
+
+static thread reporter;
+static atomic<bool> stopping(false);
+static chrono::steady_clock::time_point start_time;
+
+// Compared files
+static string filenames[2];
+static unsigned long file_sizes[2];
+
+// Active slots and totals of the removed ones
+static mutex slots_mutex;
+static set<ProgressSlot*> slots;
+static unsigned long done_bytes[2], done_changes[2];
+
+ProgressSlot::ProgressSlot(const WaveFile&file, unsigned int index)
+    : file_(file), index_(index), start_position_(file.position()),
+    start_changes_(file.changes()), time_(0), position_(start_position_),
+    changes_(start_changes_) {
+    if(progress_enabled) {
+        lock_guard<mutex> lock(slots_mutex);
+        slots.insert(this);
+    }
+}
+
+ProgressSlot::~ProgressSlot() {
+    if(progress_enabled) {
+        lock_guard<mutex> lock(slots_mutex);
+        done_bytes[index_] += file_.position() - start_position_;
+        done_changes[index_] += file_.changes() - start_changes_;
+        slots.erase(this);
+    }
+}
+
+// Formats a size in bytes using a readable unit
+static string format_size(double size) {
+    const char*units[] = { "B", "kB", "MB", "GB", "TB" };
+    unsigned int unit = 0;
+    char buf[32];
+
+    while(size >= 1000.0 && unit < 4) {
+        size /= 1000.0;
+        ++unit;
+    }
+
+    snprintf(buf, sizeof(buf), "%.1f %s", size, units[unit]);
+    return buf;
+}
+
+void progress_report() {
+    unsigned long bytes[2], changes = 0;
+    unsigned long time = numeric_limits<unsigned long>::max();
+
+    {
+        lock_guard<mutex> lock(slots_mutex);
+
+        for(unsigned int i = 0; i < 2; ++i) {
+            bytes[i] = done_bytes[i];
+            changes += done_changes[i];
+        }
+
+        for(const ProgressSlot*slot : slots) {
+            bytes[slot->index_] += slot->position_.load(memory_order_relaxed)
+                - slot->start_position_;
+            changes += slot->changes_.load(memory_order_relaxed) - slot->start_changes_;
+            time = min(time, slot->time_.load(memory_order_relaxed));
+        }
+    }
+
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start_time;
+    double seconds = max(elapsed.count(), 1e-3);
+    unsigned long total_bytes = bytes[0] + bytes[1];
+    unsigned long total_size = file_sizes[0] + file_sizes[1];
+    string msg = "Progress:";
+    char buf[128];
+
+    for(unsigned int i = 0; i < 2; ++i) {
+        snprintf(buf, sizeof(buf), " %s %s/%s (%.1f%%),", filenames[i].c_str(),
+                format_size(bytes[i]).c_str(), format_size(file_sizes[i]).c_str(),
+                file_sizes[i] ? 100.0 * bytes[i] / file_sizes[i] : 100.0);
+        msg += buf;
+    }
+
+    if(time != numeric_limits<unsigned long>::max()) {
+        snprintf(buf, sizeof(buf), " time #%lu,", time);
+        msg += buf;
+    }
+
+    if(Counter::enabled) {
+        snprintf(buf, sizeof(buf), " %.0f changes/s,", changes / seconds);
+        msg += buf;
+    }
+
+    snprintf(buf, sizeof(buf), " %s/s", format_size(total_bytes / seconds).c_str());
+    msg += buf;
+
+    if(total_bytes > 0 && total_size > total_bytes) {
+        unsigned long eta = (total_size - total_bytes) * seconds / total_bytes;
+        snprintf(buf, sizeof(buf), ", ETA %lu:%02lu:%02lu",
+                eta / 3600, (eta / 60) % 60, eta % 60);
+        msg += buf;
+    }
+
+    flockfile(stderr);
+    fprintf(stderr, "%s\n", msg.c_str());
+    funlockfile(stderr);
+}
+
+static void reporter_loop(unsigned int interval) {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+
+    struct timespec timeout;
+    timeout.tv_sec = interval;
+    timeout.tv_nsec = 0;
+
+    while(true) {
+        int res = interval > 0 ? sigtimedwait(&set, NULL, &timeout)
+            : sigwaitinfo(&set, NULL);
+
+        if(stopping)
+            break;
+
+        // Interrupted by another signal
+        if(res < 0 && errno == EINTR)
+            continue;
+
+        progress_report();
+    }
+}
+
+void progress_start(const string&file1, const string&file2, unsigned int interval) {
+    filenames[0] = file1;
+    filenames[1] = file2;
+
+    for(unsigned int i = 0; i < 2; ++i) {
+        struct stat st;
+        file_sizes[i] = stat(filenames[i].c_str(), &st) == 0 ? st.st_size : 0;
+    }
+
+    // Threads inherit the signal mask, so only the reporter receives SIGUSR1
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    start_time = chrono::steady_clock::now();
+    progress_enabled = true;
+    reporter = thread(reporter_loop, interval);
+}
+
+void progress_stop() {
+    if(!progress_enabled)
+        return;
+
+    stopping = true;
+    pthread_kill(reporter.native_handle(), SIGUSR1);
+    reporter.join();
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <atomic>
+#include <string>
+
+#include "wavefile.h"
+
+// Progress reports are printed by a separate thread, either periodically
+// or on SIGUSR1. Comparison loops only publish their position once per
+// timestamp, so the parsers are not affected.
+
+///> Set when the reporter thread is running
+extern bool progress_enabled;
+
+/**
+ * @brief Starts the reporter thread. It has to be called before any other
+ * thread is created, as SIGUSR1 is blocked in all threads and handled only
+ * by the reporter.
+ * @param interval is the report period in seconds, 0 means that reports
+ * are printed only on SIGUSR1.
+ */
+void progress_start(const std::string&file1, const std::string&file2,
+        unsigned int interval);
+
+/**
+ * @brief Stops the reporter thread.
+ */
+void progress_stop();
+
+/**
+ * @brief Position of a loop reading a file, read by the reporter thread.
+ */
+class ProgressSlot {
+public:
+    /**
+     * @param index is the file number (0 or 1).
+     */
+    ProgressSlot(const WaveFile&file, unsigned int index);
+    ~ProgressSlot();
+
+    /**
+     * @brief Publishes the current position, called once per timestamp.
+     */
+    inline void update(unsigned long time) {
+        if(!progress_enabled)
+            return;
+
+        time_.store(time, std::memory_order_relaxed);
+        position_.store(file_.position(), std::memory_order_relaxed);
+        changes_.store(file_.changes(), std::memory_order_relaxed);
+    }
+
+private:
+    const WaveFile&file_;
+    unsigned int index_;
+
+    // Values at the slot creation
+    unsigned long start_position_, start_changes_;
+
+    std::atomic<unsigned long> time_, position_, changes_;
+
+    friend void progress_report();
+};
+
+#endif /* PROGRESS_H */
@@ -0,0 +1,135 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rewrite.h"
+
+#include <cassert>
+#include <queue>
+
+using namespace std;
+
+RewriteRules rewrite_rules;
+
+static const unsigned int ALPHABET = 256;
+
+RewriteRules::RewriteRules() {
+    compile();
+}
+
+bool RewriteRules::add(const string&rule) {
+    size_t sep = rule.find('=');
+
+    if(sep == string::npos || sep == 0)
+        return false;
+
+    string from = rule.substr(0, sep);
+    string to = rule.substr(sep + 1);
+
+    for(auto&existing : rules_) {
+        if(existing.first == from) {
+            existing.second = to;
+            return true;
+        }
+    }
+
+    rules_.push_back(make_pair(from, to));
+    return true;
+}
+
+void RewriteRules::compile() {
+    // Trie of the patterns, 0 is the root state and it is never a target
+    // of a trie edge, so it marks missing transitions
+    next_.assign(ALPHABET, 0);
+    match_.assign(1, -1);
+
+    for(unsigned int i = 0; i < rules_.size(); ++i) {
+        unsigned int state = 0;
+
+        for(unsigned char c : rules_[i].first) {
+            if(!next_[state * ALPHABET + c]) {
+                next_[state * ALPHABET + c] = match_.size();
+                next_.resize(next_.size() + ALPHABET, 0);
+                match_.push_back(-1);
+            }
+
+            state = next_[state * ALPHABET + c];
+        }
+
+        match_[state] = i;
+    }
+
+    // Failure links computed in the breadth-first order turn the trie
+    // into a complete automaton
+    vector<unsigned int> fail(match_.size(), 0);
+    queue<unsigned int> states;
+
+    for(unsigned int c = 0; c < ALPHABET; ++c) {
+        if(next_[c])
+            states.push(next_[c]);
+    }
+
+    while(!states.empty()) {
+        unsigned int state = states.front();
+        states.pop();
+
+        // The longest pattern is the state's own, otherwise the longest suffix
+        if(match_[state] < 0)
+            match_[state] = match_[fail[state]];
+
+        for(unsigned int c = 0; c < ALPHABET; ++c) {
+            unsigned int&target = next_[state * ALPHABET + c];
+            unsigned int fallback = next_[fail[state] * ALPHABET + c];
+
+            if(target) {
+                fail[target] = fallback;
+                states.push(target);
+            } else {
+                target = fallback;
+            }
+        }
+    }
+}
+
+string RewriteRules::apply(const char*name) const {
+    if(rules_.empty())
+        return name;
+
+    string result;
+    unsigned int state = 0;
+    const char*copied = name;
+
+    for(const char*c = name; *c; ++c) {
+        state = next_[state * ALPHABET + (unsigned char) *c];
+
+        if(match_[state] < 0)
+            continue;
+
+        // Replace the match and restart, so replacements do not overlap
+        const auto&rule = rules_[match_[state]];
+        const char*start = c + 1 - rule.first.size();
+        assert(start >= copied);
+
+        result.append(copied, start - copied);
+        result.append(rule.second);
+        copied = c + 1;
+        state = 0;
+    }
+
+    result.append(copied);
+    return result;
+}
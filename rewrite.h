@@ -0,0 +1,80 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REWRITE_H
+#define REWRITE_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Substring replacements applied to scope and variable names while
+ * the headers are parsed, so names generated by different simulators match
+ * exactly (e.g. 'gen_blk(3)' and 'gen_blk[3]').
+ *
+ * All rules are compiled into a single Aho-Corasick automaton, so a name
+ * is scanned once regardless of the number of rules. Replaced parts do not
+ * overlap; if several rules match, the one that ends first is applied, and
+ * the longest one among those.
+ */
+class RewriteRules {
+public:
+    RewriteRules();
+
+    /**
+     * @brief Adds a rule in the '<from>=<to>' format. A rule with the same
+     * <from> part replaces the previous one.
+     * @return false if the rule is invalid.
+     */
+    bool add(const std::string&rule);
+
+    /**
+     * @brief Builds the automaton, it has to be called after adding rules.
+     */
+    void compile();
+
+    inline bool empty() const {
+        return rules_.empty();
+    }
+
+    ///> Pairs of (from, to) in the order of adding
+    inline const std::vector<std::pair<std::string, std::string> >&rules() const {
+        return rules_;
+    }
+
+    /**
+     * @brief Returns the name with the rules applied.
+     */
+    std::string apply(const char*name) const;
+
+private:
+    // Pairs of (from, to)
+    std::vector<std::pair<std::string, std::string> > rules_;
+
+    // Transitions of the automaton, 256 entries per state
+    std::vector<unsigned int> next_;
+
+    // Rule matched when a state is reached, -1 if there is none
+    std::vector<int> match_;
+};
+
+///> Rules given with --rewrite
+extern RewriteRules rewrite_rules;
+
+#endif /* REWRITE_H */
@@ -18,71 +18,179 @@
 
 #include "scope.h"
 #include "debug.h"
+#include "memusage.h"
 
+#include <algorithm>
 #include <cassert>
+#include <mutex>
+#include <unordered_set>
 
 using namespace std;
 
+// Names shared by all files. The pool is split into shards with separate
+// locks, so files parsed in parallel rarely wait for each other.
+namespace {
+struct NameShard {
+    mutex lock;
+    unordered_set<string> names;
+};
+}
+
+static const unsigned int NAME_SHARDS = 64;
+static NameShard name_shards[NAME_SHARDS];
+
+static inline NameShard&name_shard(const string&name) {
+    return name_shards[hash<string>()(name) % NAME_SHARDS];
+}
+
+const string*intern_name(const string&name) {
+    NameShard&shard = name_shard(name);
+    lock_guard<mutex> lock(shard.lock);
+    return &*shard.names.insert(name).first;
+}
+
+const string*find_name(const string&name) {
+    NameShard&shard = name_shard(name);
+    lock_guard<mutex> lock(shard.lock);
+    auto it = shard.names.find(name);
+
+    return it != shard.names.end() ? &*it : NULL;
+}
+
+void interned_names_usage(MemUsage&usage) {
+    for(NameShard&shard : name_shards) {
+        lock_guard<mutex> lock(shard.lock);
+
+        // Hash table nodes store the hash next to the string
+        for(const string&name : shard.names) {
+            usage.add(MemUsage::NAMES, MemUsage::alloc_size(
+                        sizeof(void*) + sizeof(string) + sizeof(size_t))
+                    + MemUsage::string_size(name));
+        }
+    }
+}
+
+template<typename T>
+static bool name_less(const pair<const string*, T*>&a, const pair<const string*, T*>&b) {
+    return compare_names(a.first, b.first) < 0;
+}
+
+// Finds a child in a sorted list
+template<typename T>
+static T*find_child(const vector<pair<const string*, T*> >&list, const string&name) {
+    auto it = lower_bound(list.begin(), list.end(), name,
+            [](const pair<const string*, T*>&child, const string&name) {
+                return child.first->compare(name) < 0;
+            });
+
+    return (it != list.end() && *it->first == name) ? it->second : NULL;
+}
+
 Scope::Scope(scope_type_t scope_type, const string&name, Scope*parent)
-    : name_(name), scope_type_(scope_type), parent_(parent)
+    : name_(intern_name(name)), scope_type_(scope_type), frozen_(false), parent_(parent)
 {
     assert(scope_type != UNKNOWN);
 
     // Cache the full name, including hierarchy
-    const Scope*s = parent_;
-    full_name_ = name_;
-
-    // Concatenate scope names following the hierarchy to the root scope
-    while(s) {
-        full_name_ = s->name() + "." + full_name_;
-        s = s->parent();
-    }
+    full_name_ = parent_ ? intern_name(parent_->full_name() + "." + name) : name_;
 }
 
 Scope::~Scope() {
-    for(ScopeStringMap::iterator it = scopes_.begin();
-            it != scopes_.end(); ++it) {
-        delete it->second;
-    }
+    for(auto&scope : scopes_)
+        delete scope.second;
 
-    for(VarStringMap::iterator it = vars_.begin();
-            it != vars_.end(); ++it) {
-        delete it->second;
-    }
+    for(auto&var : vars_)
+        delete var.second;
+}
+
+void Scope::freeze() {
+    if(frozen_)
+        return;
+
+    sort(scopes_.begin(), scopes_.end(), name_less<Scope>);
+    sort(vars_.begin(), vars_.end(), name_less<Variable>);
+    frozen_ = true;
+
+    // Release the memory, clear() keeps the buckets
+    unordered_map<const string*, unsigned int>().swap(scope_index_);
+    unordered_map<const string*, unsigned int>().swap(var_index_);
+
+    for(auto&scope : scopes_)
+        scope.second->freeze();
 }
 
 Scope*Scope::make_scope(scope_type_t type, const string&name) {
-    pair<ScopeStringMap::iterator, bool> res;
+    assert(!frozen_);
 
-    res = scopes_.insert(make_pair(name, new Scope(type, name, this)));
+    Scope*scope = new Scope(type, name, this);
+    bool inserted = scope_index_.insert(make_pair(scope->name_, scopes_.size())).second;
     // Be sure that scope names are unique
-    assert(res.second);
+    assert(inserted);
+    (void) inserted;
+
+    scopes_.push_back(make_pair(scope->name_, scope));
 
-    return res.first->second;
+    return scopes_.back().second;
 }
 
 Scope*Scope::get_scope(const string&name) {
-    ScopeStringMap::iterator res = scopes_.find(name);
+    if(frozen_)
+        return find_child(scopes_, name);
+
+    // Names that are not in the pool cannot belong to any child
+    const string*handle = find_name(name);
+
+    if(!handle)
+        return NULL;
 
-    if(res != scopes_.end())
-        return res->second;
+    auto res = scope_index_.find(handle);
 
-    return NULL;
+    return (res != scope_index_.end() ? scopes_[res->second].second : NULL);
 }
 
 void Scope::add_variable(Variable*var) {
-    assert(vars_.count(var->name()) == 0);
+    assert(!frozen_);
+
+    const string*handle = var->name_handle();
+    bool inserted = var_index_.insert(make_pair(handle, vars_.size())).second;
+    assert(inserted);
+    (void) inserted;
 
     DBG("added var %s\tident %s\tsize %d",
             var->full_name().c_str(), var->ident().c_str(), var->size());
 
-    vars_[var->name()] = var;
+    vars_.push_back(make_pair(handle, var));
     var->set_scope(this);
 }
 
 Variable*Scope::get_variable(const string&name) {
-    VarStringMap::iterator var = vars_.find(name);
+    if(frozen_)
+        return find_child(vars_, name);
+
+    const string*handle = find_name(name);
+
+    if(!handle)
+        return NULL;
 
-    return (var != vars_.end() ? var->second : NULL);
+    auto res = var_index_.find(handle);
+
+    return (res != var_index_.end() ? vars_[res->second].second : NULL);
 }
 
+void Scope::mem_usage(MemUsage&usage) const {
+    usage.add(MemUsage::SCOPES, MemUsage::alloc_size(sizeof(Scope)));
+
+    // Children lists, the names are stored in the pool
+    if(scopes_.capacity() > 0) {
+        usage.add(MemUsage::SCOPES, MemUsage::alloc_size(
+                    scopes_.capacity() * sizeof(ScopeList::value_type)), 0);
+    }
+
+    if(vars_.capacity() > 0) {
+        usage.add(MemUsage::SCOPES, MemUsage::alloc_size(
+                    vars_.capacity() * sizeof(VarList::value_type)), 0);
+    }
+
+    for(const auto&var : vars_)
+        var.second->mem_usage(usage);
+}
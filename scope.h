@@ -22,11 +22,40 @@
 #include "variable.h"
 
 #include <string>
-#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 class Scope;
 
-typedef std::map<std::string, Scope*> ScopeStringMap;
+/**
+ * @brief Returns a handle to a name, equal names get the same handle
+ * in all files. Handles stay valid until the program exits.
+ */
+const std::string*intern_name(const std::string&name);
+
+/**
+ * @brief Returns the handle of an already interned name, or NULL if there
+ * is none. The name is not added to the pool.
+ */
+const std::string*find_name(const std::string&name);
+
+/**
+ * @brief Adds the memory used by the interned names to a summary.
+ */
+void interned_names_usage(MemUsage&usage);
+
+/**
+ * @brief Compares names like std::string::compare(), but equal handles
+ * are recognized without comparing the strings.
+ */
+inline int compare_names(const std::string*name1, const std::string*name2) {
+    return name1 == name2 ? 0 : name1->compare(*name2);
+}
+
+///> Children of a scope, (name handle, object) pairs sorted by name
+typedef std::vector<std::pair<const std::string*, Scope*> > ScopeList;
+typedef std::vector<std::pair<const std::string*, Variable*> > VarList;
 
 class Scope {
 public:
@@ -39,11 +68,11 @@ public:
     ~Scope();
 
     inline const std::string&name() const {
-        return name_;
+        return *name_;
     }
 
     inline const std::string&full_name() const {
-        return full_name_;
+        return *full_name_;
     }
 
     inline scope_type_t type() const {
@@ -53,14 +82,29 @@ public:
     Scope*make_scope(scope_type_t type, const std::string&name);
     Scope*get_scope(const std::string&name);
 
-    ScopeStringMap&scopes() {
+    /**
+     * @brief Sorts the subscopes and variables, and releases the lookup
+     * tables used while the hierarchy is built. It has to be called
+     * once the header is parsed, before the children are iterated.
+     */
+    void freeze();
+
+    ScopeList&scopes() {
+        return scopes_;
+    }
+
+    const ScopeList&scopes() const {
         return scopes_;
     }
 
     void add_variable(Variable*var);
     Variable*get_variable(const std::string&name);
 
-    std::map<std::string, Variable*>&variables() {
+    VarList&variables() {
+        return vars_;
+    }
+
+    const VarList&variables() const {
         return vars_;
     }
 
@@ -68,21 +112,33 @@ public:
         return parent_;
     }
 
+    /**
+     * @brief Adds the memory used by the scope and its variables to
+     * a memory usage summary. Subscopes are not included.
+     */
+    void mem_usage(MemUsage&usage) const;
+
 private:
-    // The unique part of the scope name
-    const std::string name_;
+    // The unique part of the scope name (interned)
+    const std::string*name_;
 
-    // Full scope name, including the scopes hierarchy
-    std::string full_name_;
+    // Full scope name, including the scopes hierarchy (interned)
+    const std::string*full_name_;
 
     // Scope kind
     const scope_type_t scope_type_;
 
     // Subscopes
-    ScopeStringMap scopes_;
+    ScopeList scopes_;
 
     // Variables stored in the scope
-    VarStringMap vars_;
+    VarList vars_;
+
+    // Positions of the children indexed by name handles, used only
+    // until the scope is frozen
+    std::unordered_map<const std::string*, unsigned int> scope_index_, var_index_;
+
+    bool frozen_;
 
     // Parent scope, NULL if it is the root scope
     Scope*parent_;
@@ -0,0 +1,155 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "stats.h"
+#include "options.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <new>
+
+#include <sys/resource.h>
+
+using namespace std;
+
+#ifdef ALLOC_STATS
+// Number of allocations, counted only with --stats. Replacing operator new
+// affects every allocation, so it is enabled only in builds with ALLOC_STATS.
+static atomic<unsigned long> allocations(0);
+
+void*operator new(size_t size) {
+    if(stats_mode)
+        allocations.fetch_add(1, memory_order_relaxed);
+
+    void*ptr = malloc(size ? size : 1);
+
+    if(!ptr)
+        throw bad_alloc();
+
+    return ptr;
+}
+
+void operator delete(void*ptr) noexcept {
+    free(ptr);
+}
+#endif /* ALLOC_STATS */
+
+// Returns the CPU time used by all threads of the process
+static double process_cpu_time() {
+    struct timespec ts;
+
+    if(clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) != 0)
+        return 0.0;
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+PhaseTimer::PhaseTimer(PhaseTime&phase, bool with_cpu)
+    : phase_(stats_mode ? &phase : NULL), with_cpu_(with_cpu), cpu_start_(0.0) {
+    if(!phase_)
+        return;
+
+    wall_start_ = chrono::steady_clock::now();
+
+    if(with_cpu_)
+        cpu_start_ = process_cpu_time();
+}
+
+void PhaseTimer::stop() {
+    if(!phase_)
+        return;
+
+    chrono::duration<double> wall = chrono::steady_clock::now() - wall_start_;
+    phase_->wall += wall.count();
+
+    if(with_cpu_)
+        phase_->cpu += process_cpu_time() - cpu_start_;
+
+    phase_ = NULL;
+}
+
+void Stats::merge(const Stats&other) {
+    bytes += other.bytes;
+    lines += other.lines;
+    tokens += other.tokens;
+    changes += other.changes;
+    timestamps += other.timestamps;
+    diffs += other.diffs;
+    parsing += other.parsing;
+    output += other.output;
+}
+
+static void print_phase(ostream&out, const char*name, const PhaseTime&phase,
+        bool with_cpu) {
+    char line[128];
+
+    if(with_cpu)
+        snprintf(line, sizeof(line), "  %-24s %10.3f %10.3f", name, phase.wall, phase.cpu);
+    else
+        snprintf(line, sizeof(line), "  %-24s %10.3f %10s", name, phase.wall, "-");
+
+    out << line << endl;
+}
+
+static void print_counter(ostream&out, const char*name, unsigned long value) {
+    char line[128];
+    snprintf(line, sizeof(line), "  %-24s %10lu", name, value);
+    out << line << endl;
+}
+
+void print_stats(ostream&out, const Stats&stats) {
+    PhaseTime total;
+    total += stats.header;
+    total += stats.mapping;
+    total += stats.comparison;
+
+    out << "Statistics:" << endl;
+    out << "  phase                      wall [s]    cpu [s]" << endl;
+    print_phase(out, "header parsing", stats.header, true);
+    print_phase(out, "signal mapping", stats.mapping, true);
+    print_phase(out, "value changes", stats.comparison, true);
+    print_phase(out, "  parsing (threads)", stats.parsing, false);
+    print_phase(out, "  output (threads)", stats.output, false);
+    print_phase(out, "total", total, true);
+
+    if(Counter::enabled) {
+        print_counter(out, "bytes read", stats.bytes.value());
+        print_counter(out, "lines read", stats.lines.value());
+        print_counter(out, "tokens lexed", stats.tokens.value());
+        print_counter(out, "value changes applied", stats.changes.value());
+        print_counter(out, "timestamps processed", stats.timestamps.value());
+        print_counter(out, "diffs emitted", stats.diffs.value());
+    } else {
+        out << "  (counters disabled at build time)" << endl;
+    }
+
+    print_counter(out, "links", stats.links);
+    print_counter(out, "aliases", stats.aliases);
+    print_counter(out, "unmatched signals", stats.unmatched);
+
+#ifdef ALLOC_STATS
+    print_counter(out, "allocations", allocations.load());
+#endif
+
+    struct rusage usage;
+
+    if(getrusage(RUSAGE_SELF, &usage) == 0)
+        print_counter(out, "peak RSS [kB]", usage.ru_maxrss);
+}
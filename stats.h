@@ -0,0 +1,150 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <chrono>
+#include <ostream>
+
+/**
+ * @brief Event counter reported with --stats. Counting is selected at
+ * compile time: when vcdiff is built with NO_STATS defined (make STATS=0),
+ * counters are empty classes and all updates are removed by the compiler.
+ * Otherwise a counter is a plain integer, updated by a single thread.
+ */
+template<bool Enabled>
+class BasicCounter {
+public:
+    inline void add(unsigned long) {}
+    inline void operator++() {}
+    inline void operator+=(const BasicCounter&) {}
+
+    inline unsigned long value() const {
+        return 0;
+    }
+
+    static const bool enabled = false;
+};
+
+template<>
+class BasicCounter<true> {
+public:
+    BasicCounter() : value_(0) {}
+
+    inline void add(unsigned long count) {
+        value_ += count;
+    }
+
+    inline void operator++() {
+        ++value_;
+    }
+
+    inline void operator+=(const BasicCounter&other) {
+        value_ += other.value_;
+    }
+
+    inline unsigned long value() const {
+        return value_;
+    }
+
+    static const bool enabled = true;
+
+private:
+    unsigned long value_;
+};
+
+#ifdef NO_STATS
+typedef BasicCounter<false> Counter;
+#else
+typedef BasicCounter<true> Counter;
+#endif
+
+///> Time spent in a phase (seconds)
+struct PhaseTime {
+    PhaseTime() : wall(0.0), cpu(0.0) {}
+
+    inline void operator+=(const PhaseTime&other) {
+        wall += other.wall;
+        cpu += other.cpu;
+    }
+
+    double wall, cpu;
+};
+
+/**
+ * @brief Adds the time elapsed between construction and destruction to
+ * a PhaseTime. Clocks are read only if --stats has been given.
+ */
+class PhaseTimer {
+public:
+    /**
+     * @param with_cpu enables measuring the process CPU time. It is too
+     * costly for short phases measured repeatedly, they report only
+     * the wall time.
+     */
+    PhaseTimer(PhaseTime&phase, bool with_cpu = false);
+
+    ~PhaseTimer() {
+        stop();
+    }
+
+    /**
+     * @brief Ends the measurement before the timer is destroyed.
+     */
+    void stop();
+
+private:
+    PhaseTime*phase_;       // NULL if disabled
+    bool with_cpu_;
+    std::chrono::steady_clock::time_point wall_start_;
+    double cpu_start_;
+};
+
+/**
+ * @brief Statistics collected during a comparison.
+ */
+struct Stats {
+    // Input files
+    Counter bytes, lines, tokens, changes;
+
+    // Comparison
+    Counter timestamps, diffs;
+
+    // Phases, parsing and output are parts of the comparison phase and
+    // are summed over all threads
+    PhaseTime header, mapping, comparison, parsing, output;
+
+    // Signal mapping results
+    unsigned long links, aliases, unmatched;
+
+    Stats() : links(0), aliases(0), unmatched(0) {}
+
+    /**
+     * @brief Adds counters and times collected by another thread.
+     */
+    void merge(const Stats&other);
+};
+
+/**
+ * @brief Prints the report, together with the peak memory usage and
+ * the allocation count (only in builds with ALLOC_STATS).
+ */
+void print_stats(std::ostream&out, const Stats&stats);
+
+#endif /* STATS_H */
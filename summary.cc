@@ -0,0 +1,145 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "summary.h"
+#include "link.h"
+#include "scope.h"
+#include "variable.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <sstream>
+
+using namespace std;
+
+void LinkSummary::merge(const LinkSummary&later) {
+    if(later.diffs == 0)
+        return;
+
+    if(diffs == 0) {
+        first = later.first;
+        value1 = later.value1;
+        value2 = later.value2;
+    }
+
+    diffs += later.diffs;
+    last = later.last;
+}
+
+///> Differences summed for a scope and its subscopes
+struct ScopeSummary {
+    ScopeSummary() : diffs(0), signals(0), first(0), last(0) {}
+
+    unsigned long diffs, signals;
+    unsigned long first, last;
+};
+
+// Returns the scope of a variable, vector elements use the vector scope
+static const Scope*var_scope(const Variable*var) {
+    while(!var->scope() && var->parent())
+        var = var->parent();
+
+    return var->scope();
+}
+
+static string var_name(const Variable*var) {
+    stringstream name;
+    name << *var;
+    return name.str();
+}
+
+void print_summary(ostream&out, const list<Link*>&links,
+        const vector<LinkSummary>&summary) {
+    vector<const Link*> sorted;
+    map<const Scope*, ScopeSummary> scopes;
+    unsigned long total = 0;
+
+    for(const Link*link : links) {
+        if(link->id() >= summary.size() || summary[link->id()].diffs == 0)
+            continue;
+
+        const LinkSummary&entry = summary[link->id()];
+        sorted.push_back(link);
+        total += entry.diffs;
+
+        // Roll up the differences to all parent scopes
+        for(const Scope*scope = var_scope(link->first());
+                scope && scope->parent(); scope = scope->parent()) {
+            ScopeSummary&scope_entry = scopes[scope];
+
+            if(scope_entry.signals++ == 0 || entry.first < scope_entry.first)
+                scope_entry.first = entry.first;
+
+            scope_entry.last = max(scope_entry.last, entry.last);
+            scope_entry.diffs += entry.diffs;
+        }
+    }
+
+    sort(sorted.begin(), sorted.end(), [&](const Link*a, const Link*b) {
+            const LinkSummary&sa = summary[a->id()];
+            const LinkSummary&sb = summary[b->id()];
+
+            if(sa.diffs != sb.diffs)
+                return sa.diffs > sb.diffs;
+
+            return a->id() < b->id();
+        });
+
+    out << "Differences: " << total << " in " << sorted.size() << " signals" << endl;
+    out << endl;
+
+    char line[80];
+    out << "Mismatching signals:" << endl;
+    snprintf(line, sizeof(line), "  %12s %14s %14s  ", "diffs", "first", "last");
+    out << line << "name\tfirst values" << endl;
+
+    for(const Link*link : sorted) {
+        const LinkSummary&entry = summary[link->id()];
+        snprintf(line, sizeof(line), "  %12lu %14lu %14lu  ",
+                entry.diffs, entry.first, entry.last);
+        out << line << var_name(link->first()) << "\t"
+            << entry.value1 << " | " << entry.value2 << endl;
+    }
+
+    out << endl;
+
+    vector<pair<string, ScopeSummary> > scope_list;
+
+    for(const auto&entry : scopes)
+        scope_list.push_back(make_pair(entry.first->full_name(), entry.second));
+
+    sort(scope_list.begin(), scope_list.end(),
+        [](const pair<string, ScopeSummary>&a, const pair<string, ScopeSummary>&b) {
+            if(a.second.diffs != b.second.diffs)
+                return a.second.diffs > b.second.diffs;
+
+            return a.first < b.first;
+        });
+
+    out << "Mismatching scopes (including subscopes):" << endl;
+    snprintf(line, sizeof(line), "  %12s %10s %14s %14s  ",
+            "diffs", "signals", "first", "last");
+    out << line << "name" << endl;
+
+    for(const auto&entry : scope_list) {
+        snprintf(line, sizeof(line), "  %12lu %10lu %14lu %14lu  ", entry.second.diffs,
+                entry.second.signals, entry.second.first, entry.second.last);
+        out << line << entry.first << endl;
+    }
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+#include <list>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class Link;
+
+///> Differences of a single Link, collected with --summary
+struct LinkSummary {
+    LinkSummary() : diffs(0), first(0), last(0) {}
+
+    /**
+     * @brief Counts a difference, the values are formatted only for
+     * the first one.
+     */
+    inline bool add(unsigned long time) {
+        last = time;
+
+        if(diffs++ > 0)
+            return false;
+
+        first = time;
+        return true;
+    }
+
+    /**
+     * @brief Adds differences found later in time (e.g. in the next window).
+     */
+    void merge(const LinkSummary&later);
+
+    // Number of timestamps with differences, times of the first and last one
+    unsigned long diffs;
+    unsigned long first, last;
+
+    // Values at the first difference
+    std::string value1, value2;
+};
+
+/**
+ * @brief Prints the mismatching links and the differences summed per scope,
+ * sorted by the number of differences.
+ * @param summary is indexed by Link::id().
+ */
+void print_summary(std::ostream&out, const std::list<Link*>&links,
+        const std::vector<LinkSummary>&summary);
+
+#endif /* SUMMARY_H */
@@ -23,7 +23,7 @@
 using namespace std;
 
 Tokenizer::Tokenizer(const string&filename)
-    : file_(filename.c_str()), line_number_(0), buf_size_(1024)
+    : file_(filename.c_str()), line_number_(0), offset_(0), buf_size_(1024)
 {
     buf_ = new char[buf_size_];
     buf_ptr_ = buf_;
@@ -38,6 +38,41 @@ Tokenizer::~Tokenizer() {
     file_.close();
 }
 
+void Tokenizer::seek(unsigned long offset, int line_number) {
+    file_.clear();
+    file_.seekg(offset);
+
+    offset_ = offset;
+    line_number_ = line_number;
+
+    // Mark buffer as empty
+    buf_ptr_ = buf_;
+    buf_cur_ = buf_;
+    *buf_ptr_ = 0;
+}
+
+bool Tokenizer::get_line(string&line) {
+    skip_whitespace();
+
+    if(*buf_ptr_ != 0 && *buf_ptr_ != '\n' && *buf_ptr_ != '\r')
+        return false;
+
+    if(!getline(file_, line))
+        return false;
+
+    offset_ += line.size();
+    ++line_number_;
+    bytes_.add(line.size());
+    ++lines_;
+
+    if(!file_.eof()) {
+        ++offset_;
+        bytes_.add(1);
+    }
+
+    return true;
+}
+
 int Tokenizer::get(char*&dest) {
     skip_whitespace();
 
@@ -49,6 +84,7 @@ int Tokenizer::get(char*&dest) {
     // Set the pointer to a new token
     dest = buf_ptr_;
     buf_cur_ = buf_ptr_;
+    ++tokens_;
 
     // Move to the next token
     int len = 0;
@@ -105,7 +141,10 @@ bool Tokenizer::fill_if_empty() {
         // Try until we get non-whitespace characters or the file is finished
         while(buf_ptr_[0] == 0 && file_.good()) {
             ++line_number_;
+            ++lines_;
             file_.getline(buf_, buf_size_);
+            offset_ += file_.gcount();
+            bytes_.add(file_.gcount());
 
             while(file_.fail() && !file_.eof()) {
                 // We have filled the current buffer, but there was no newline,
@@ -113,6 +152,8 @@ bool Tokenizer::fill_if_empty() {
                 file_.clear();
                 char*target = inc_buffer();
                 file_.getline(target, buf_size_ / 2);
+                offset_ += file_.gcount();
+                bytes_.add(file_.gcount());
             }
 
             skip_whitespace();
@@ -124,6 +165,12 @@ bool Tokenizer::fill_if_empty() {
     return file_.good();
 }
 
+void Tokenizer::collect_stats(Stats&stats) const {
+    stats.bytes += bytes_;
+    stats.lines += lines_;
+    stats.tokens += tokens_;
+}
+
 void Tokenizer::skip_whitespace() {
     while(*buf_ptr_ && isblank(*buf_ptr_)) ++buf_ptr_;
 }
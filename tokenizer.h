@@ -19,6 +19,8 @@
 #ifndef TOKENIZER_H
 #define TOKENIZER_H
 
+#include "stats.h"
+
 #include <fstream>
 #include <string>
 #include <cassert>
@@ -54,10 +56,36 @@ public:
         return line_number_;
     }
 
+    /*
+     * @brief Returns the offset of the first line that has not been read yet.
+     */
+    inline unsigned long offset() const {
+        return offset_;
+    }
+
+    /*
+     * @brief Moves to a line beginning, discarding the buffered tokens.
+     * @param offset is the line offset in bytes.
+     * @param line_number is the line number used in messages.
+     */
+    void seek(unsigned long offset, int line_number);
+
+    /*
+     * @brief Reads the next line without splitting it into tokens.
+     * @return false if the current line has not been processed yet
+     * or the file has finished.
+     */
+    bool get_line(std::string&line);
+
     inline bool valid() const {
         return file_.good();
     }
 
+    /*
+     * @brief Adds the number of read bytes, lines and tokens to statistics.
+     */
+    void collect_stats(Stats&stats) const;
+
 private:
     // Loads another line if the buffer is empty
     bool fill_if_empty();
@@ -77,6 +105,9 @@ private:
     // Current line number in the processed file
     int line_number_;
 
+    // Number of bytes read from the file
+    unsigned long offset_;
+
     // Buffer to store the currently processed line
     char*buf_;
 
@@ -88,6 +119,10 @@ private:
 
     // Current buffer size
     int buf_size_;
+
+    // Statistics, unlike offset_ and line_number_ they are not affected
+    // by seek()
+    Counter bytes_, lines_, tokens_;
 };
 
 #endif /* TOKENIZER_H */
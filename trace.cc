@@ -0,0 +1,195 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+///> Complete event ("ph":"X")
+struct TraceEvent {
+    const char*name;
+    string args;        // JSON object members, without braces
+    double start, duration;
+};
+
+///> Events recorded by a single thread
+struct TraceBuffer {
+    unsigned int tid;
+    string name;
+    vector<TraceEvent> events;
+};
+
+// Tracing is enabled before any thread is started, so the flag is not
+// modified while it is read by other threads
+static bool enabled = false;
+static FILE*trace_file = NULL;
+static chrono::steady_clock::time_point epoch;
+
+// Buffers are owned by the list, so they outlive their threads
+static mutex buffers_mutex;
+static vector<unique_ptr<TraceBuffer> > buffers;
+static thread_local TraceBuffer*local_buffer = NULL;
+
+// Time since the trace start in microseconds
+static inline double now() {
+    chrono::duration<double, micro> time = chrono::steady_clock::now() - epoch;
+    return time.count();
+}
+
+static TraceBuffer&get_buffer() {
+    if(!local_buffer) {
+        lock_guard<mutex> lock(buffers_mutex);
+        buffers.push_back(unique_ptr<TraceBuffer>(new TraceBuffer));
+        local_buffer = buffers.back().get();
+        local_buffer->tid = buffers.size();
+    }
+
+    return *local_buffer;
+}
+
+static string escape(const string&str) {
+    string res;
+
+    for(char c : str) {
+        if(c == '"' || c == '\\')
+            res.push_back('\\');
+
+        if((unsigned char) c >= 0x20)
+            res.push_back(c);
+    }
+
+    return res;
+}
+
+// Writes all recorded events, called at exit
+static void trace_write() {
+    lock_guard<mutex> lock(buffers_mutex);
+    bool first = true;
+
+    fprintf(trace_file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    for(const unique_ptr<TraceBuffer>&buffer : buffers) {
+        if(!buffer->name.empty()) {
+            fprintf(trace_file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                    "\"tid\":%u,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n",
+                    buffer->tid, escape(buffer->name).c_str());
+            first = false;
+        }
+
+        for(const TraceEvent&event : buffer->events) {
+            fprintf(trace_file, "%s{\"name\":\"%s\",\"cat\":\"vcdiff\",\"ph\":\"X\","
+                    "\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{%s}}",
+                    first ? "" : ",\n", escape(event.name).c_str(), event.start,
+                    event.duration, buffer->tid, event.args.c_str());
+            first = false;
+        }
+    }
+
+    fprintf(trace_file, "\n]}\n");
+    fclose(trace_file);
+}
+
+bool trace_start(const char*filename) {
+    trace_file = fopen(filename, "w");
+
+    if(!trace_file)
+        return false;
+
+    epoch = chrono::steady_clock::now();
+    enabled = true;
+    atexit(trace_write);
+    trace_thread_name("main");
+
+    return true;
+}
+
+void trace_thread_name(const string&name) {
+    if(enabled)
+        get_buffer().name = name;
+}
+
+static void record(const char*name, const string&args, double start) {
+    TraceEvent event;
+    event.name = name;
+    event.args = args;
+    event.start = start;
+    event.duration = now() - start;
+    get_buffer().events.push_back(event);
+}
+
+TraceScope::TraceScope(const char*name, const string&args)
+    : name_(NULL), start_(0.0) {
+    if(enabled) {
+        name_ = name;
+        args_ = args;
+        start_ = now();
+    }
+}
+
+void TraceScope::end() {
+    if(!name_)
+        return;
+
+    record(name_, args_, start_);
+    name_ = NULL;
+}
+
+void TraceScope::restart(const char*name, const string&args) {
+    end();
+
+    if(enabled) {
+        name_ = name;
+        args_ = args;
+        start_ = now();
+    }
+}
+
+TraceBatch::TraceBatch(const char*name, unsigned int size)
+    : name_(name), size_(size), count_(0), first_time_(0), start_(0.0) {
+}
+
+void TraceBatch::next(unsigned long time) {
+    if(!enabled)
+        return;
+
+    if(count_ == size_)
+        end();
+
+    if(count_ == 0) {
+        first_time_ = time;
+        start_ = now();
+    }
+
+    ++count_;
+}
+
+void TraceBatch::end() {
+    if(count_ == 0)
+        return;
+
+    record(name_, "\"from\":" + to_string(first_time_)
+            + ",\"count\":" + to_string(count_), start_);
+    count_ = 0;
+}
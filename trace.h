@@ -0,0 +1,100 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+
+// Timeline of the internal phases, saved in the Chrome trace event format
+// (loads in chrome://tracing and Perfetto). Events are stored in per-thread
+// buffers and written when the program exits. All functions do nothing
+// unless trace_start() has been called.
+
+/**
+ * @brief Enables tracing, the events are written to a file at exit.
+ * @return false if the file could not be created.
+ */
+bool trace_start(const char*filename);
+
+/**
+ * @brief Names the calling thread in the timeline.
+ */
+void trace_thread_name(const std::string&name);
+
+/**
+ * @brief Records a complete event, covering the lifetime of the object.
+ */
+class TraceScope {
+public:
+    TraceScope(const char*name, const std::string&args = std::string());
+
+    ~TraceScope() {
+        end();
+    }
+
+    /**
+     * @brief Ends the event before the object is destroyed.
+     */
+    void end();
+
+    /**
+     * @brief Ends the current event and starts a new one.
+     */
+    void restart(const char*name, const std::string&args = std::string());
+
+private:
+    const char*name_;       // NULL if the event is not recorded
+    std::string args_;
+    double start_;
+};
+
+/**
+ * @brief Groups repeated operations into events spanning a number of
+ * iterations, e.g. a batch of next_delta() calls.
+ */
+class TraceBatch {
+public:
+    TraceBatch(const char*name, unsigned int size = 1024);
+
+    ~TraceBatch() {
+        end();
+    }
+
+    /**
+     * @brief Marks the beginning of an iteration.
+     * @param time is the simulation time, stored with the batch.
+     */
+    void next(unsigned long time);
+
+    void end();
+
+private:
+    const char*name_;
+    unsigned int size_, count_;
+    unsigned long first_time_;
+    double start_;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+///> Records an event until the end of the current block
+#define TRACE_SCOPE(name...) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+#endif /* TRACE_H */
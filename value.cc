@@ -100,7 +100,7 @@ size_t Value::hash() const {
 
         case VECTOR:
             for(unsigned int i = 0; i < size; ++i)
-                res += std::hash<bit_t>()(data.vec[i]);
+                res = hash_combine(res, std::hash<bit_t>()(data.vec[i]));
             break;
 
         case REAL:
@@ -195,6 +195,22 @@ Value::operator string() const {
     return string();
 }
 
+void Value::append_to(string&str) const {
+    switch(type) {
+        case BIT:
+            str += data.bit;
+            break;
+
+        case VECTOR:
+            str.append(data.vec, size);
+            break;
+
+        default:
+            str += (string) *this;
+            break;
+    }
+}
+
 ostream&operator<<(ostream&out, const Value&var)
 {
     out << (string) var;
@@ -27,6 +27,14 @@
 /// Basic bit type (possible values 0, 1, X, Z)
 typedef char bit_t;
 
+/**
+ * @brief Mixes the hash of an element into the hash of a sequence, so the
+ * result depends on the order of elements and none of them is shifted out.
+ */
+inline size_t hash_combine(size_t seed, size_t hash) {
+    return seed ^ (hash + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
 class Value {
 public:
     enum data_type_t { BIT, VECTOR, REAL, UNDEFINED };
@@ -70,6 +78,12 @@ public:
     bool operator!=(const Value&other) const;
     operator std::string() const;
 
+    /**
+     * @brief Appends the value to a string, avoiding a temporary string
+     * for bits and vectors.
+     */
+    void append_to(std::string&str) const;
+
     data_type_t type;
 
     union data_t {
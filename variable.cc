@@ -19,6 +19,7 @@
 // TODO ident as char[8] to speed up?
 
 #include "variable.h"
+#include "memusage.h"
 #include "scope.h"
 
 #include <ostream>
@@ -28,7 +29,7 @@ using namespace std;
 
 Variable::Variable(var_type_t type, Value::data_type_t data_type,
         const string&name, const string&identifier)
-    : scope_(NULL), name_(name), ident_(identifier),
+    : scope_(NULL), name_(intern_name(name)), full_name_(NULL), ident_(identifier),
         type_(type), data_type_(data_type),
         parent_(NULL), idx_(-1), link_(NULL) {
     assert(type_ != UNKNOWN);
@@ -39,7 +40,7 @@ Variable::Variable(var_type_t type, Value::data_type_t data_type,
 
 void Variable::recache_var_name() {
     //assert(!name().empty());
-    full_name_ = name() + full_index();
+    full_name_ = intern_name(name() + full_index());
 }
 
 std::string Variable::full_index(bool last) const {
@@ -57,6 +58,16 @@ std::string Variable::full_index(bool last) const {
     return s.str();
 }
 
+void Variable::mem_usage(MemUsage&usage) const {
+    // Names are counted in the pool
+    usage.add_name(ident_);
+
+    if(alias_links_.capacity() > 0) {
+        usage.add(MemUsage::LINKS, MemUsage::alloc_size(
+                    alias_links_.capacity() * sizeof(const Link*)), 0);
+    }
+}
+
 Vector::Vector(var_type_t type, int left_idx, int right_idx,
         const string&name, const string&identifier)
     : Variable(type, Value::VECTOR, name, identifier),
@@ -145,10 +156,8 @@ void Vector::clear_transition() {
 size_t Vector::hash() const {
     size_t res = 0;
 
-    for(auto&var : children_) {
-        res ^= var.second->hash();
-        res <<= 1;
-    }
+    for(auto&var : children_)
+        res = hash_combine(res, var.second->hash());
 
     return res;
 }
@@ -156,30 +165,31 @@ size_t Vector::hash() const {
 size_t Vector::prev_hash() const {
     size_t res = 0;
 
-    for(auto&var : children_) {
-        res ^= var.second->prev_hash();
-        res <<= 1;
-    }
+    for(auto&var : children_)
+        res = hash_combine(res, var.second->prev_hash());
 
     return res;
 }
 
 string Vector::value_str() const {
-    stringstream s;
-
-    for(auto&var : children_)
-        s << var.second->value_str();
+    string s;
+    s.reserve(children_.size());
+    append_value_str(s, false);
 
-    return s.str();
+    return s;
 }
 
 string Vector::prev_value_str() const {
-    stringstream s;
+    string s;
+    s.reserve(children_.size());
+    append_value_str(s, true);
 
-    for(auto&var : children_)
-        s << var.second->prev_value_str();
+    return s;
+}
 
-    return s.str();
+void Vector::append_value_str(string&str, bool prev) const {
+    for(auto&var : children_)
+        var.second->append_value_str(str, prev);
 }
 
 string Vector::index_str() const {
@@ -207,6 +217,15 @@ void Vector::fill() {
     }
 }
 
+void Vector::mem_usage(MemUsage&usage) const {
+    usage.add(MemUsage::VECTORS, MemUsage::alloc_size(sizeof(Vector))
+            + children_.size() * MemUsage::tree_node_size<std::pair<const int, Variable*> >());
+    Variable::mem_usage(usage);
+
+    for(const auto&child : children_)
+        child.second->mem_usage(usage);
+}
+
 Scalar::Scalar(var_type_t type, Value::data_type_t data_type,
         const string&name, const string&identifier)
     : Variable(type, data_type, name, identifier),
@@ -227,6 +246,13 @@ string Scalar::index_str() const {
     return s.str();
 }
 
+void Scalar::mem_usage(MemUsage&usage) const {
+    usage.add(MemUsage::SCALARS, MemUsage::alloc_size(sizeof(Scalar)));
+    usage.add(MemUsage::VALUES, MemUsage::value_size(value_)
+            + MemUsage::value_size(prev_value_), 2);
+    Variable::mem_usage(usage);
+}
+
 Alias::Alias(const string&name, Variable*target)
     : Variable(target->type(), target->data_type(), name,
             target->ident()), target_(target)
@@ -234,6 +260,11 @@ Alias::Alias(const string&name, Variable*target)
     assert(target);
 }
 
+void Alias::mem_usage(MemUsage&usage) const {
+    usage.add(MemUsage::ALIASES, MemUsage::alloc_size(sizeof(Alias)));
+    Variable::mem_usage(usage);
+}
+
 std::ostream&operator<<(std::ostream&out, const Variable&var) {
     Scope*scope = var.scope();
 
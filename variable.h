@@ -22,6 +22,7 @@
 #include <functional>
 #include <map>
 #include <string>
+#include <vector>
 
 #include <cassert>
 #include <cmath>
@@ -29,6 +30,7 @@
 #include "value.h"
 
 class Link;
+class MemUsage;
 class Scope;
 
 class Variable {
@@ -65,6 +67,13 @@ public:
      * returns 'var').
      */
     inline const std::string&name() const {
+        return *name_;
+    }
+
+    /**
+     * @brief Returns the interned handle of the short name.
+     */
+    inline const std::string*name_handle() const {
         return name_;
     }
 
@@ -72,7 +81,7 @@ public:
      * @brief Returns the full name including indexes.
      */
     inline const std::string& full_name() const {
-        return full_name_.empty() ? name_ : full_name_;
+        return full_name_ ? *full_name_ : *name_;
     }
 
     /**
@@ -135,6 +144,19 @@ public:
         link_ = link;
     }
 
+    /**
+     * @brief Returns Link objects of aliases to the variable. Aliases share
+     * the value changes with their target, so the links have to be reported
+     * whenever the variable is modified.
+     */
+    inline const std::vector<const Link*>&alias_links() const {
+        return alias_links_;
+    }
+
+    inline void add_alias_link(const Link*link) {
+        alias_links_.push_back(link);
+    }
+
     /**
      * @brief Return the parent variable, if any. This variable is set
      * only when the variable is set as a part of a vector.
@@ -193,11 +215,23 @@ public:
      */
     virtual std::string prev_value_str() const = 0;
 
+    /**
+     * @brief Appends the current (or the previous one if prev is set) value
+     * to a string, so values might be copied without temporary strings.
+     */
+    virtual void append_value_str(std::string&str, bool prev = false) const = 0;
+
     /**
      * @brief Displays indexes of the variable.
      */
     virtual std::string index_str() const = 0;
 
+    /**
+     * @brief Adds the memory used by the variable (and its children,
+     * if any) to a memory usage summary.
+     */
+    virtual void mem_usage(MemUsage&usage) const;
+
 protected:
     /**
      * @brief Updates the cached full name.
@@ -214,11 +248,11 @@ private:
     ///> Parent scope
     Scope*scope_;
 
-    ///> Variable name
-    const std::string name_;
+    ///> Variable name (interned)
+    const std::string*name_;
 
-    /// Cached full variable name
-    std::string full_name_;
+    /// Cached full variable name (interned)
+    const std::string*full_name_;
 
     ///> Variable identifier
     const std::string ident_;
@@ -237,6 +271,9 @@ private:
 
     ///> Associated Link object pointing to twin variable in another VCD file
     const Link*link_;
+
+    ///> Links of aliases to the variable
+    std::vector<const Link*> alias_links_;
 };
 
 class Vector : public Variable {
@@ -300,6 +337,7 @@ public:
 
     std::string value_str() const;
     std::string prev_value_str() const;
+    void append_value_str(std::string&str, bool prev = false) const;
 
     std::string index_str() const;
 
@@ -330,6 +368,8 @@ public:
 
     std::ostream&operator<<(std::ostream&out) const;
 
+    void mem_usage(MemUsage&usage) const;
+
 private:
     /**
      * @brief Returns size of the declared vector range.
@@ -394,8 +434,14 @@ public:
         return std::string(prev_value_);
     }
 
+    void append_value_str(std::string&str, bool prev = false) const {
+        (prev ? prev_value_ : value_).append_to(str);
+    }
+
     std::string index_str() const;
 
+    void mem_usage(MemUsage&usage) const;
+
 private:
     Value value_, prev_value_;
     bool changed_;
@@ -453,10 +499,16 @@ public:
         return target_->prev_value_str();
     }
 
+    void append_value_str(std::string&str, bool prev = false) const {
+        target_->append_value_str(str, prev);
+    }
+
     std::string index_str() const {
         return target_->index_str();
     }
 
+    void mem_usage(MemUsage&usage) const;
+
 private:
     Variable*target_;
 };
@@ -18,33 +18,21 @@
 
 #include "vcdfile.h"
 #include "options.h"
+#include "rewrite.h"
 #include "debug.h"
 
+#include <algorithm>
+#include <fstream>
 #include <list>
+#include <unordered_map>
 #include <cstring>
 
-#define PARSE_WARN(x...)\
-    { fprintf(stderr, "Warning: %s:%d: ", filename().c_str(), line_number());\
-        fprintf(stderr, x); fprintf(stderr, "\n"); }
-
-#define PARSE_ERROR(x...)\
-    { fprintf(stderr, "Error: %s:%d: ", filename().c_str(), line_number());\
-        fprintf(stderr, x); fprintf(stderr, "\n"); }
-
 using namespace std;
 
-// Converts a string to lower case in-place
-static void to_lower_case(char*str) {
-    while(*str) {
-        *str = tolower(*str);
-        ++str;
-    }
-}
-
 VcdFile::VcdFile(const char*filename)
-    : filename_(filename), tokenizer_(filename),
-    root_(Scope::BEGIN, "(" + filename_ + ")", NULL), cur_scope_(&root_),
-    timescale_(0), cur_timestamp_(0), next_timestamp_(0), ignore_scope_(false)
+    : WaveFile(filename), tokenizer_(filename), block_offset_(0),
+    block_line_(0), block_cur_timestamp_(0), block_next_timestamp_(0),
+    blocks_pending_(false), pending_offset_(0), ignore_scope_(false)
 {
 }
 
@@ -129,6 +117,9 @@ bool VcdFile::next_delta(set<const Link*>&changes) {
         string ident;
         bool assign = false;
 
+        // Record size without the identifier, used for profiling
+        unsigned int record_size = 0;
+
         switch(token[0]) {
             case '#':
                 if(sscanf(token, "#%lu", &tstamp) != 1) {
@@ -158,6 +149,7 @@ bool VcdFile::next_delta(set<const Link*>&changes) {
             case 'b':
                 // Get the new vector value (skip 'b', store only the new value)
                 new_value = Value(string(&token[1]));
+                record_size = new_value.size + 2;
 
                 // Get the variable identifier
                 tokenizer_.get(token);
@@ -167,6 +159,7 @@ bool VcdFile::next_delta(set<const Link*>&changes) {
 
             case 'r':
                 new_value = Value((float) ::atof(&token[1]));
+                record_size = profile_count ? strlen(token) + 1 : 0;
 
                 // Get the variable identifier
                 tokenizer_.get(token);
@@ -187,6 +180,7 @@ bool VcdFile::next_delta(set<const Link*>&changes) {
 
                 new_value = Value(token[0]);
                 ident = string(&token[1]);
+                record_size = 1;
                 assign = true;
                 break;
             }
@@ -209,18 +203,10 @@ bool VcdFile::next_delta(set<const Link*>&changes) {
 
             Variable*var = res->second;
             assert(var);
-            var->set_value(new_value);
-
-            const Link*link = NULL;
-
-            if(const Variable*parent = var->parent())
-                link = parent->link();
-
-            if(!link)
-                link = var->link();
+            set_value(var, new_value, changes);
 
-            if(link)
-                changes.insert(link);
+            if(profile_count)
+                add_profile(var, record_size + ident.size() + 1);
 
             DBG("%s: %s changed to %s", filename_.c_str(),
                     var->full_name().c_str(), string(new_value).c_str());
@@ -230,16 +216,223 @@ bool VcdFile::next_delta(set<const Link*>&changes) {
     return false;
 }
 
-void VcdFile::show_state() const {
-    cout << filename_ << " @ " << cur_timestamp_ << endl;
+// Finds value changes in a line of text, without assigning them. The most
+// recent values are stored in a map indexed by variable identifiers.
+static void scan_values(const string&line, unordered_map<string, string>&values,
+        string&value, bool&expect_ident) {
+    size_t end = 0;
+
+    while(true) {
+        size_t start = line.find_first_not_of(" \t\r", end);
+
+        if(start == string::npos)
+            break;
+
+        end = line.find_first_of(" \t\r", start);
+
+        if(end == string::npos)
+            end = line.size();
+
+        string token = line.substr(start, end - start);
+
+        // Vector and real values are followed by an identifier
+        if(expect_ident) {
+            values[token] = value;
+            expect_ident = false;
+            continue;
+        }
+
+        switch(token[0]) {
+            case 'b':
+            case 'r':
+                value = token;
+                expect_ident = true;
+                break;
+
+            case '0':
+            case '1':
+            case 'X':
+            case 'Z':
+            case 'x':
+            case 'z':
+                values[token.substr(1)] = token.substr(0, 1);
+                break;
+        }
+    }
+}
+
+bool VcdFile::build_index(unsigned int count, vector<Checkpoint>&checkpoints) {
+    ifstream file(filename_.c_str(), ios::binary);
+
+    if(!file.good())
+        return false;
 
-    for(VarStringMap::const_iterator it = var_idents_.begin();
-            it != var_idents_.end(); ++it) {
-        Variable*var = it->second;
-        cout << "    " << *var << " = " << var->value_str() << endl;
+    // Value changes start right after the header
+    unsigned long offset = tokenizer_.offset();
+    int line_number = tokenizer_.line_number();
+
+    file.seekg(0, ios::end);
+    unsigned long size = file.tellg();
+    unsigned long interval = max(1ul, (size - min(size, offset)) / (count + 1));
+    unsigned long last_checkpoint = offset;
+    file.seekg(offset);
+
+    // Most recent values, indexed by variable identifiers
+    unordered_map<string, string> values;
+    string line, value;
+    bool expect_ident = false;
+
+    while(getline(file, line)) {
+        unsigned long line_offset = offset;
+        offset += line.size() + 1;
+        ++line_number;
+
+        // Checkpoints are placed only at line beginnings
+        size_t start = line.find_first_not_of(" \t\r");
+
+        if(start != string::npos && line[start] == '#'
+                && line_offset - last_checkpoint >= interval) {
+            unsigned long tstamp = strtoul(&line[start + 1], NULL, 10);
+
+            // Timestamp #0 is skipped by next_delta()
+            if(tstamp != 0 && (checkpoints.empty()
+                        || tstamp > checkpoints.back().time)) {
+                Checkpoint checkpoint;
+                checkpoint.time = tstamp;
+                checkpoint.offset = line_offset;
+                checkpoint.line = line_number - 1;
+                checkpoint.values.assign(values.begin(), values.end());
+                checkpoints.push_back(checkpoint);
+                last_checkpoint = line_offset;
+            }
+        }
+
+        scan_values(line, values, value, expect_ident);
     }
 
-    cout << endl;
+    return true;
+}
+
+bool VcdFile::restore(const Checkpoint&checkpoint, set<const Link*>&changes) {
+    tokenizer_.seek(checkpoint.offset, checkpoint.line);
+
+    // Read the checkpoint timestamp
+    if(!next_delta(changes) || next_timestamp_ != checkpoint.time)
+        return false;
+
+    for(const pair<string, string>&entry : checkpoint.values)
+        assign(entry.first, entry.second, changes);
+
+    return true;
+}
+
+bool VcdFile::read_block(string&block, bool&finished) {
+    unsigned long offset = tokenizer_.offset();
+    int line_number = tokenizer_.line_number();
+    string line;
+
+    block.clear();
+    finished = true;
+    block_offset_ = offset;
+    block_line_ = line_number;
+    block_cur_timestamp_ = cur_timestamp_;
+    block_next_timestamp_ = next_timestamp_;
+
+    while(tokenizer_.get_line(line)) {
+        size_t start = line.find_first_not_of(" \t\r");
+
+        if(start != string::npos && line[start] == '#') {
+            unsigned long tstamp;
+            char next;
+
+            // Blocks end at lines containing only a timestamp
+            if(sscanf(&line[start], "#%lu %c", &tstamp, &next) != 1) {
+                tokenizer_.seek(offset, line_number);
+                return false;
+            }
+
+            // Skip the initial timestamp, as next_delta() does
+            if(tstamp != 0) {
+                cur_timestamp_ = next_timestamp_;
+                next_timestamp_ = tstamp;
+                finished = false;
+                break;
+            }
+        }
+
+        block.append(line);
+        block.push_back('\n');
+    }
+
+    // Current line has been partially processed
+    if(finished && tokenizer_.offset() == offset && tokenizer_.valid())
+        return false;
+
+    // Let next_delta() display warnings about sections in the initial blocks
+    if(block_cur_timestamp_ == 0 && warn_unexpected_tokens
+            && block.find('$') != string::npos) {
+        unread_block();
+        return false;
+    }
+
+    if(!blocks_pending_) {
+        blocks_pending_ = true;
+        pending_offset_ = offset;
+    }
+
+    return true;
+}
+
+void VcdFile::unread_block() {
+    tokenizer_.seek(block_offset_, block_line_);
+    cur_timestamp_ = block_cur_timestamp_;
+    next_timestamp_ = block_next_timestamp_;
+
+    // Nothing has been skipped, if it was the first block
+    if(pending_offset_ == block_offset_)
+        blocks_pending_ = false;
+}
+
+void VcdFile::apply_blocks(set<const Link*>&changes) {
+    if(!blocks_pending_)
+        return;
+
+    blocks_pending_ = false;
+
+    ifstream file(filename_.c_str(), ios::binary);
+    file.seekg(pending_offset_);
+
+    // Only the most recent value of each variable matters
+    unordered_map<string, string> values;
+    unsigned long offset = pending_offset_;
+    string line, value;
+    bool expect_ident = false;
+
+    while(offset < tokenizer_.offset() && getline(file, line)) {
+        offset += line.size() + 1;
+        scan_values(line, values, value, expect_ident);
+    }
+
+    for(const pair<const string, string>&entry : values)
+        assign(entry.first, entry.second, changes);
+}
+
+void VcdFile::assign(const string&ident, const string&token,
+        set<const Link*>&changes) {
+    VarStringMap::iterator res = var_idents_.find(ident);
+
+    if(res == var_idents_.end())
+        return;
+
+    Value value;
+
+    switch(token[0]) {
+        case 'b': value = Value(token.substr(1)); break;
+        case 'r': value = Value((float) ::atof(&token[1])); break;
+        default:  value = Value(token[0]); break;
+    }
+
+    set_value(res->second, value, changes);
 }
 
 bool VcdFile::parse_enddefinitions() {
@@ -249,6 +442,7 @@ bool VcdFile::parse_enddefinitions() {
     }
 
     DBG("%s: header correct", filename_.c_str());
+    root_.freeze();
     return true;
 }
 
@@ -267,10 +461,12 @@ bool VcdFile::parse_scope() {
             || (type == Scope::TASK && skip_task);
 
     if(!ignore_scope_) {
+        string name = rewrite_rules.apply(token);
+
         if(!ignore_case)
-            to_lower_case(token);
+            to_lower_case(&name[0]);
 
-        push_scope(type, token);
+        push_scope(type, name.c_str());
     }
 
     if(!tokenizer_.expect("$end")) {
@@ -376,13 +572,16 @@ bool VcdFile::parse_var() {
     if(strlen(ident) == sizeof(ident))
         PARSE_WARN("too long variable identifier, could have been clamped (%s)", token);
 
-    if(!ignore_case)
-        to_lower_case(name);
+    if(!ignore_scope_) {
+        string var_name = rewrite_rules.apply(name);
 
-    if(!ignore_scope_)
-        add_variable(name, ident, size, type);
+        if(!ignore_case)
+            to_lower_case(&var_name[0]);
 
-    return true;
+        add_variable(var_name.c_str(), ident, size, type);
+    }
+
+    return check_mem_limit();
 }
 
 bool VcdFile::parse_not_handled(const char*section) {
@@ -442,275 +641,3 @@ Scope::scope_type_t VcdFile::parse_scope_type(const char*token) const
 
     return Scope::UNKNOWN;
 }
-
-void VcdFile::add_variable(const char*name, const char*ident,
-                    int size, Variable::var_type_t type) {
-    // Some parameter and real variables have 0 size
-    assert(size > 0 || type == Variable::REAL || type == Variable::PARAMETER);
-
-    string base_name;
-    int left_idx = size > 0 ? size - 1 : 0;
-    int right_idx = 0;
-    list<int>idxs;
-    bool has_index = false;
-    //bool has_range = false;
-
-    // Check if there is an index or a range in the name
-    const char*bracket = strchr(name, '[');
-
-    if(bracket) {
-        int tmp_left, tmp_right;
-        if(sscanf(bracket, "[%d:%d]", &tmp_left, &tmp_right) == 2) {
-            left_idx = tmp_left;
-            right_idx = tmp_right;
-
-            assert(left_idx >= 0 && right_idx >= 0);
-            assert(size == std::abs(left_idx - right_idx) + 1);
-
-            //has_range = true;
-        } else {
-            // Look for multiple indexes
-            int tmp_idx;
-            const char*cur_bracket = bracket;
-
-            while(cur_bracket && sscanf(cur_bracket, "[%d]", &tmp_idx) == 1) {
-                cur_bracket = strchr(cur_bracket + 1, '[');
-                idxs.push_back(tmp_idx);
-            }
-
-            assert(idxs.size() > 0);
-            has_index = true;
-        }
-    }
-
-    // Copy the name without any indexes or ranges
-    if(bracket)
-        base_name.append(name, (int)(bracket - name));
-    else
-        base_name.append(name);
-
-    // var_name is the top level variable (e.g. a vector that stores the
-    // full hierarchy), var_ident is the individual variable that contains
-    // the specific bits associated with an identifier
-    Variable*var_name = cur_scope_->get_variable(base_name);
-
-    // Is it a new variable or are we extending an existing vector?
-    const bool new_variable = (var_name == NULL);
-
-    // It is possible to have two variables with the same identifier if they
-    // are exactly the same signal. For consistency, keep variables with
-    // the shortest signal name, otherwise variable mapping might be wrong.
-    VarStringMap::iterator it = var_idents_.find(ident);
-    Variable*var_ident = (it == var_idents_.end() ? NULL : it->second);
-
-    // Is it a new identifier or the variable is an alias to an existing one?
-    const bool new_ident = (var_ident == NULL);
-
-    if(!new_ident) {
-        Alias*alias = new Alias(base_name, var_ident);
-        alias->set_scope(cur_scope_);
-
-        if(warn_duplicate_vars) {
-            cerr << "Info: " << filename_ << ": '" << *alias
-                << "' is the same signal as '" << *var_ident
-                << "', creating an alias." << endl;
-        }
-
-        var_ident = alias;
-    }
-
-    if(new_variable) {
-        Value::data_type_t data_type =
-            (type == Variable::PARAMETER) ? Value::REAL : Value::BIT;
-
-        switch(type) {
-            case Variable::TIME:
-            case Variable::INTEGER:
-            case Variable::REG:
-            case Variable::WIRE:
-                assert(size > 0);
-
-            case Variable::PARAMETER:
-                // Parameters are stored as numbers
-                if(size == 1 && !has_index) {
-                    // The simplest case: a scalar
-                    if(new_ident) {
-                        var_name = new Scalar(type, data_type, base_name, ident);
-                        var_ident = var_name;
-                    } else {
-                        var_name = var_ident;
-                    }
-
-                } else if(size == 1 && has_index) {
-                    // Even though it is one bit wide, it is likely to
-                    // be a vector, just splitted into separate variables.
-                    // Once the other signals belonging to the vector occur,
-                    // they will be grouped.
-                    int prev_idx = idxs.front();
-
-                    list<int>::iterator it = idxs.begin()++;
-                    Vector*cur_vec = new Vector(type, prev_idx, prev_idx,
-                            base_name);
-
-                    // This is the top vector, so store it in the name map
-                    var_name = cur_vec;
-
-                    // Create vectors for all indexes in the hierarchy,
-                    // but the last one - it is going to be our scalar
-                    for(unsigned int i = 0; i < idxs.size() - 1; ++i) {
-                        int cur_idx = *it;
-                        Vector*v = new Vector(type, cur_idx, cur_idx);
-                        cur_vec->add_variable(prev_idx, v);
-
-                        cur_vec = v;
-                        prev_idx = cur_idx;
-                        ++it;
-                    }
-
-                    // Now add the scalar at the bottom of the hierarchy
-                    if(new_ident)
-                        var_ident = new Scalar(type, data_type, base_name, ident);
-
-                    cur_vec->add_variable(idxs.back(), var_ident);
-
-                } else if(size > 1 && has_index) {
-                    // For now we support only 2-dimensional arrays
-                    assert(idxs.size() == 1);
-
-                    // Single word of a multidimensional array
-                    int idx = idxs.front();
-
-                    // Parent vector
-                    Vector*top_vec = new Vector(type, idx, idx, base_name);
-
-                    if(new_ident) {
-                        // Child vector
-                        Vector*vec = new Vector(type, left_idx, right_idx,
-                                base_name, ident);
-                        vec->fill();
-
-                        var_ident = vec;
-                    }
-
-                    top_vec->add_variable(idx, var_ident);
-                    var_name = top_vec;
-
-                } else if(size > 1 && !has_index) {
-                    // Vector of scalars, including integers
-                    assert(size == std::abs(left_idx - right_idx) + 1);
-
-                    if(new_ident) {
-                        Vector*vec = new Vector(type, left_idx, right_idx,
-                                base_name, ident);
-                        vec->fill();
-
-                        var_name = vec;
-                        var_ident = vec;
-                    } else {
-                        var_name = var_ident;
-                    }
-
-                } else if(size == 0 && type == Variable::PARAMETER) {
-                    // Size == 0 indicates a parameter
-                    // (at least in the Modelsim land)
-                    var_ident = new Scalar(type, data_type, base_name, ident);
-                    var_name = var_ident;
-                    size = 1;
-                } else {
-                    assert(false);
-                }
-                break;
-
-            case Variable::REAL:
-                var_ident = new Scalar(Variable::REAL, Value::REAL, base_name, ident);
-                var_name = var_ident;
-                size = 1;
-                break;
-
-            default:
-                PARSE_ERROR("not implemented variable type, sorry");
-                assert(false);
-                return;
-        }
-
-    } else {
-        // There is already a variable with such base_name, so it should be
-        // an indexed vector. It is another variable belonging to an
-        // already existing vector.
-        assert(has_index);
-        assert(var_name->is_vector());
-        Vector*vec = static_cast<Vector*>(var_name);
-
-        switch(type) {
-            case Variable::TIME:
-            case Variable::INTEGER:
-            case Variable::WIRE:
-            case Variable::REG:
-            case Variable::PARAMETER:
-                assert(size > 0);
-
-                if(size == 1) {
-                    // Go through the vectors hierarchy, add a scalar
-                    // at the end. There might be missing vectors, so we
-                    // add them as needed.
-                    list<int>::iterator it = idxs.begin();
-
-                    for(unsigned int i = 0; i < idxs.size() - 1; ++i) {
-                        int idx = *it;
-
-                        if(vec->is_valid_idx(idx)) {
-                            vec = static_cast<Vector*>((*vec)[idx]);
-                            assert(vec);
-                            ++it;
-                        } else {
-                            int new_idx = *++it;
-                            Vector*v = new Vector(type, new_idx, new_idx);
-                            vec->add_variable(idx, v);
-                            vec = v;
-                        }
-                    }
-
-                    if(new_ident)
-                        var_ident = new Scalar(type, Value::BIT, base_name, ident);
-
-                    vec->add_variable(idxs.back(), var_ident);
-
-                } else {
-                    assert(idxs.size() == 1);
-
-                    Vector*new_vec = new Vector( type, left_idx, right_idx,
-                            base_name, ident);
-                    new_vec->fill();
-
-                    assert(new_ident);
-                    var_ident = new_vec;
-                    vec->add_variable(idxs.front(), var_ident);
-                }
-                break;
-
-            default:
-                PARSE_ERROR("not implemented variable type, sorry");
-                assert(false);
-                return;
-        }
-
-        DBG("%s: extended var %s\tident %s\tsize %d\tidx %d(%lu)",
-                filename_.c_str(), vec->full_name().c_str(), ident, size,
-                idxs.front(), idxs.size());
-    }
-
-    if(new_variable) {
-        assert(var_name);
-        assert(!var_name->name().empty());
-        cur_scope_->add_variable(var_name);
-    }
-
-    if(new_ident) {
-        assert(var_ident);
-        assert(var_ident->size() == (unsigned)size);
-        assert(!var_ident->ident().empty());
-        var_idents_[ident] = var_ident;
-        var_ident->set_scope(cur_scope_);
-    }
-}
-
@@ -19,15 +19,14 @@
 #ifndef VCDFILE_H
 #define VCDFILE_H
 
-#include <iostream>
 #include <set>
 #include <string>
+#include <vector>
 
-#include "scope.h"
 #include "tokenizer.h"
-#include "variable.h"
+#include "wavefile.h"
 
-class VcdFile {
+class VcdFile : public WaveFile {
 public:
     VcdFile(const char*filename);
 
@@ -35,42 +34,34 @@ public:
         return tokenizer_.valid();
     }
 
-    inline const std::string&filename() const {
-        return filename_;
-    }
-
-    inline int timescale() const {
-        return timescale_;
-    }
-
     bool parse_header();
 
     bool next_delta(std::set<const Link*>&changes);
 
-    inline unsigned long next_timestamp() const {
-        return next_timestamp_;
+    unsigned long line_number() const {
+        return tokenizer_.line_number();
     }
 
-    inline Scope&root_scope() {
-        return root_;
+    unsigned long position() const {
+        return tokenizer_.offset();
     }
 
-    void show_state() const;
+    bool build_index(unsigned int count, std::vector<Checkpoint>&checkpoints);
 
-    int line_number() const {
-        return tokenizer_.line_number();
-    }
+    bool restore(const Checkpoint&checkpoint, std::set<const Link*>&changes);
 
-private:
-    inline void push_scope(Scope::scope_type_t type, const char*scope) {
-        cur_scope_ = cur_scope_->make_scope(type, scope);
-    }
+    bool read_block(std::string&block, bool&finished);
+
+    void unread_block();
+
+    void apply_blocks(std::set<const Link*>&changes);
 
-    inline void pop_scope() {
-        cur_scope_ = cur_scope_->parent();
-        assert(cur_scope_);
+    void collect_stats(Stats&stats) const {
+        WaveFile::collect_stats(stats);
+        tokenizer_.collect_stats(stats);
     }
 
+private:
     // Parsers for specific header sections
     bool parse_enddefinitions();
     bool parse_scope();
@@ -89,17 +80,20 @@ private:
 
     Scope::scope_type_t parse_scope_type(const char*token) const;
 
-    void add_variable(const char*name, const char*ident,
-                      int size, Variable::var_type_t type);
+    // Assigns a value, as stored in the file, to a variable
+    void assign(const std::string&ident, const std::string&token,
+                std::set<const Link*>&changes);
 
-    // TODO comments
-    const std::string filename_;
     Tokenizer tokenizer_;
-    Scope root_;
-    Scope*cur_scope_;
-    int timescale_;
-    unsigned long cur_timestamp_, next_timestamp_;
-    VarStringMap var_idents_;
+
+    // Position before the last read_block() call, used to undo it
+    unsigned long block_offset_;
+    int block_line_;
+    unsigned long block_cur_timestamp_, block_next_timestamp_;
+
+    // Position of the first block that has not been applied to variables
+    bool blocks_pending_;
+    unsigned long pending_offset_;
 
     // Flag to indicate the current scope as ignored
     bool ignore_scope_;
@@ -0,0 +1,468 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "wavefile.h"
+#include "vcdfile.h"
+#include "ghwfile.h"
+#include "memusage.h"
+#include "options.h"
+#include "debug.h"
+
+#include <fstream>
+#include <list>
+#include <cstring>
+
+using namespace std;
+
+WaveFile::WaveFile(const char*filename)
+    : filename_(filename),
+    root_(Scope::BEGIN, "(" + filename_ + ")", NULL), cur_scope_(&root_),
+    timescale_(0), cur_timestamp_(0), next_timestamp_(0), aliases_(0),
+    mem_checks_(0)
+{
+}
+
+WaveFile*WaveFile::open(const char*filename) {
+    // GHW files start with a magic string, anything else is treated as VCD
+    char magic[9] = { 0, };
+    ifstream file(filename, ios::binary);
+
+    if(file.read(magic, sizeof(magic)) && GhwFile::is_ghw(magic, sizeof(magic)))
+        return new GhwFile(filename);
+
+    return new VcdFile(filename);
+}
+
+void WaveFile::show_state() const {
+    cout << filename_ << " @ " << cur_timestamp_ << endl;
+
+    for(VarStringMap::const_iterator it = var_idents_.begin();
+            it != var_idents_.end(); ++it) {
+        Variable*var = it->second;
+        cout << "    " << *var << " = " << var->value_str() << endl;
+    }
+
+    cout << endl;
+}
+
+void WaveFile::set_value(Variable*var, const Value&value,
+        set<const Link*>&changes) {
+    var->set_value(value);
+    ++changes_;
+
+    const Link*link = NULL;
+
+    if(const Variable*parent = var->parent())
+        link = parent->link();
+
+    if(!link)
+        link = var->link();
+
+    if(link)
+        changes.insert(link);
+
+    for(const Link*alias_link : var->alias_links())
+        changes.insert(alias_link);
+}
+
+void WaveFile::merge_profile(const WaveFile&other) {
+    // Variables are different objects, so they are matched by identifiers
+    for(const auto&entry : other.profile_) {
+        VarStringMap::const_iterator it = var_idents_.find(entry.first->ident());
+
+        if(it == var_idents_.end())
+            continue;
+
+        SignalProfile&profile = profile_[it->second];
+        profile.changes += entry.second.changes;
+        profile.bytes += entry.second.bytes;
+    }
+}
+
+// Returns true if a variable or any of its elements is linked. Aliases
+// report the links of their targets, so their own links are checked too.
+// Targets of linked aliases store their values, so they have to be kept.
+static bool has_link(const Variable*var) {
+    if(var->link() || var->Variable::link() || !var->alias_links().empty())
+        return true;
+
+    if(const Vector*vec = dynamic_cast<const Vector*>(var)) {
+        for(int i = vec->min_idx(); i <= vec->max_idx(); ++i) {
+            if(has_link((*vec)[i]))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+// Adds a variable and its elements to a set
+static void add_tree(const Variable*var, set<const Variable*>&vars) {
+    vars.insert(var);
+
+    if(const Vector*vec = dynamic_cast<const Vector*>(var)) {
+        for(int i = vec->min_idx(); i <= vec->max_idx(); ++i)
+            add_tree((*vec)[i], vars);
+    }
+}
+
+// Removes unlinked variables from a scope hierarchy
+static void remove_unlinked(Scope&scope, set<const Variable*>&dropped,
+        list<Variable*>&removed) {
+    for(auto&subscope : scope.scopes())
+        remove_unlinked(*subscope.second, dropped, removed);
+
+    VarList&vars = scope.variables();
+    VarList::iterator last = vars.begin();
+
+    // Linked variables are moved to the front, so the order is kept
+    for(auto&var : vars) {
+        if(has_link(var.second)) {
+            *last++ = var;
+            continue;
+        }
+
+        add_tree(var.second, dropped);
+        removed.push_back(var.second);
+    }
+
+    vars.erase(last, vars.end());
+    vars.shrink_to_fit();
+}
+
+unsigned int WaveFile::drop_unlinked() {
+    set<const Variable*> dropped;
+    list<Variable*> removed;
+
+    remove_unlinked(root_, dropped, removed);
+    forget_variables(dropped);
+
+    // Alias destructors do not access their targets, so the order
+    // does not matter
+    for(Variable*var : removed)
+        delete var;
+
+    return dropped.size();
+}
+
+void WaveFile::forget_variables(const set<const Variable*>&vars) {
+    for(VarStringMap::iterator it = var_idents_.begin(); it != var_idents_.end();) {
+        if(vars.count(it->second))
+            it = var_idents_.erase(it);
+        else
+            ++it;
+    }
+
+    for(const Variable*var : vars)
+        profile_.erase(var);
+}
+
+bool WaveFile::check_mem_limit() {
+    // Reading the resident size is not free, so it is checked periodically
+    if(!mem_limit || (++mem_checks_ % 1024) != 0)
+        return true;
+
+    size_t used = mem_resident();
+
+    if(used <= mem_limit * 1024 * 1024)
+        return true;
+
+    PARSE_ERROR("memory limit of %lu MB exceeded while reading the header "
+            "(%lu MB used)", mem_limit, (unsigned long) (used >> 20));
+    return false;
+}
+
+void WaveFile::to_lower_case(char*str) {
+    while(*str) {
+        *str = tolower(*str);
+        ++str;
+    }
+}
+
+void WaveFile::add_variable(const char*name, const char*ident,
+                    int size, Variable::var_type_t type) {
+    // Some parameter and real variables have 0 size
+    assert(size > 0 || type == Variable::REAL || type == Variable::PARAMETER);
+
+    string base_name;
+    int left_idx = size > 0 ? size - 1 : 0;
+    int right_idx = 0;
+    list<int>idxs;
+    bool has_index = false;
+    //bool has_range = false;
+
+    // Check if there is an index or a range in the name
+    const char*bracket = strchr(name, '[');
+
+    if(bracket) {
+        int tmp_left, tmp_right;
+        if(sscanf(bracket, "[%d:%d]", &tmp_left, &tmp_right) == 2) {
+            left_idx = tmp_left;
+            right_idx = tmp_right;
+
+            assert(left_idx >= 0 && right_idx >= 0);
+            assert(size == std::abs(left_idx - right_idx) + 1);
+
+            //has_range = true;
+        } else {
+            // Look for multiple indexes
+            int tmp_idx;
+            const char*cur_bracket = bracket;
+
+            while(cur_bracket && sscanf(cur_bracket, "[%d]", &tmp_idx) == 1) {
+                cur_bracket = strchr(cur_bracket + 1, '[');
+                idxs.push_back(tmp_idx);
+            }
+
+            assert(idxs.size() > 0);
+            has_index = true;
+        }
+    }
+
+    // Copy the name without any indexes or ranges
+    if(bracket)
+        base_name.append(name, (int)(bracket - name));
+    else
+        base_name.append(name);
+
+    // var_name is the top level variable (e.g. a vector that stores the
+    // full hierarchy), var_ident is the individual variable that contains
+    // the specific bits associated with an identifier
+    Variable*var_name = cur_scope_->get_variable(base_name);
+
+    // Is it a new variable or are we extending an existing vector?
+    const bool new_variable = (var_name == NULL);
+
+    // It is possible to have two variables with the same identifier if they
+    // are exactly the same signal. For consistency, keep variables with
+    // the shortest signal name, otherwise variable mapping might be wrong.
+    VarStringMap::iterator it = var_idents_.find(ident);
+    Variable*var_ident = (it == var_idents_.end() ? NULL : it->second);
+
+    // Is it a new identifier or the variable is an alias to an existing one?
+    const bool new_ident = (var_ident == NULL);
+
+    if(!new_ident) {
+        Alias*alias = new Alias(base_name, var_ident);
+        alias->set_scope(cur_scope_);
+        ++aliases_;
+
+        if(warn_duplicate_vars) {
+            cerr << "Info: " << filename_ << ": '" << *alias
+                << "' is the same signal as '" << *var_ident
+                << "', creating an alias." << endl;
+        }
+
+        var_ident = alias;
+    }
+
+    if(new_variable) {
+        Value::data_type_t data_type =
+            (type == Variable::PARAMETER) ? Value::REAL : Value::BIT;
+
+        switch(type) {
+            case Variable::TIME:
+            case Variable::INTEGER:
+            case Variable::REG:
+            case Variable::WIRE:
+                assert(size > 0);
+
+            case Variable::PARAMETER:
+                // Parameters are stored as numbers
+                if(size == 1 && !has_index) {
+                    // The simplest case: a scalar
+                    if(new_ident) {
+                        var_name = new Scalar(type, data_type, base_name, ident);
+                        var_ident = var_name;
+                    } else {
+                        var_name = var_ident;
+                    }
+
+                } else if(size == 1 && has_index) {
+                    // Even though it is one bit wide, it is likely to
+                    // be a vector, just splitted into separate variables.
+                    // Once the other signals belonging to the vector occur,
+                    // they will be grouped.
+                    int prev_idx = idxs.front();
+
+                    list<int>::iterator it = idxs.begin()++;
+                    Vector*cur_vec = new Vector(type, prev_idx, prev_idx,
+                            base_name);
+
+                    // This is the top vector, so store it in the name map
+                    var_name = cur_vec;
+
+                    // Create vectors for all indexes in the hierarchy,
+                    // but the last one - it is going to be our scalar
+                    for(unsigned int i = 0; i < idxs.size() - 1; ++i) {
+                        int cur_idx = *it;
+                        Vector*v = new Vector(type, cur_idx, cur_idx);
+                        cur_vec->add_variable(prev_idx, v);
+
+                        cur_vec = v;
+                        prev_idx = cur_idx;
+                        ++it;
+                    }
+
+                    // Now add the scalar at the bottom of the hierarchy
+                    if(new_ident)
+                        var_ident = new Scalar(type, data_type, base_name, ident);
+
+                    cur_vec->add_variable(idxs.back(), var_ident);
+
+                } else if(size > 1 && has_index) {
+                    // For now we support only 2-dimensional arrays
+                    assert(idxs.size() == 1);
+
+                    // Single word of a multidimensional array
+                    int idx = idxs.front();
+
+                    // Parent vector
+                    Vector*top_vec = new Vector(type, idx, idx, base_name);
+
+                    if(new_ident) {
+                        // Child vector
+                        Vector*vec = new Vector(type, left_idx, right_idx,
+                                base_name, ident);
+                        vec->fill();
+
+                        var_ident = vec;
+                    }
+
+                    top_vec->add_variable(idx, var_ident);
+                    var_name = top_vec;
+
+                } else if(size > 1 && !has_index) {
+                    // Vector of scalars, including integers
+                    assert(size == std::abs(left_idx - right_idx) + 1);
+
+                    if(new_ident) {
+                        Vector*vec = new Vector(type, left_idx, right_idx,
+                                base_name, ident);
+                        vec->fill();
+
+                        var_name = vec;
+                        var_ident = vec;
+                    } else {
+                        var_name = var_ident;
+                    }
+
+                } else if(size == 0 && type == Variable::PARAMETER) {
+                    // Size == 0 indicates a parameter
+                    // (at least in the Modelsim land)
+                    var_ident = new Scalar(type, data_type, base_name, ident);
+                    var_name = var_ident;
+                    size = 1;
+                } else {
+                    assert(false);
+                }
+                break;
+
+            case Variable::REAL:
+                var_ident = new Scalar(Variable::REAL, Value::REAL, base_name, ident);
+                var_name = var_ident;
+                size = 1;
+                break;
+
+            default:
+                PARSE_ERROR("not implemented variable type, sorry");
+                assert(false);
+                return;
+        }
+
+    } else {
+        // There is already a variable with such base_name, so it should be
+        // an indexed vector. It is another variable belonging to an
+        // already existing vector.
+        assert(has_index);
+        assert(var_name->is_vector());
+        Vector*vec = static_cast<Vector*>(var_name);
+
+        switch(type) {
+            case Variable::TIME:
+            case Variable::INTEGER:
+            case Variable::WIRE:
+            case Variable::REG:
+            case Variable::PARAMETER:
+                assert(size > 0);
+
+                if(size == 1) {
+                    // Go through the vectors hierarchy, add a scalar
+                    // at the end. There might be missing vectors, so we
+                    // add them as needed.
+                    list<int>::iterator it = idxs.begin();
+
+                    for(unsigned int i = 0; i < idxs.size() - 1; ++i) {
+                        int idx = *it;
+
+                        if(vec->is_valid_idx(idx)) {
+                            vec = static_cast<Vector*>((*vec)[idx]);
+                            assert(vec);
+                            ++it;
+                        } else {
+                            int new_idx = *++it;
+                            Vector*v = new Vector(type, new_idx, new_idx);
+                            vec->add_variable(idx, v);
+                            vec = v;
+                        }
+                    }
+
+                    if(new_ident)
+                        var_ident = new Scalar(type, Value::BIT, base_name, ident);
+
+                    vec->add_variable(idxs.back(), var_ident);
+
+                } else {
+                    assert(idxs.size() == 1);
+
+                    Vector*new_vec = new Vector( type, left_idx, right_idx,
+                            base_name, ident);
+                    new_vec->fill();
+
+                    assert(new_ident);
+                    var_ident = new_vec;
+                    vec->add_variable(idxs.front(), var_ident);
+                }
+                break;
+
+            default:
+                PARSE_ERROR("not implemented variable type, sorry");
+                assert(false);
+                return;
+        }
+
+        DBG("%s: extended var %s\tident %s\tsize %d\tidx %d(%lu)",
+                filename_.c_str(), vec->full_name().c_str(), ident, size,
+                idxs.front(), idxs.size());
+    }
+
+    if(new_variable) {
+        assert(var_name);
+        assert(!var_name->name().empty());
+        cur_scope_->add_variable(var_name);
+    }
+
+    if(new_ident) {
+        assert(var_ident);
+        assert(var_ident->size() == (unsigned)size);
+        assert(!var_ident->ident().empty());
+        var_idents_[ident] = var_ident;
+        var_ident->set_scope(cur_scope_);
+    }
+}
+
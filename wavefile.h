@@ -0,0 +1,280 @@
+/*
+ * Copyright CERN 2016
+ * @author Maciej Suminski (maciej.suminski@cern.ch)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAVEFILE_H
+#define WAVEFILE_H
+
+#include <iostream>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <cstdio>
+
+#include "profile.h"
+#include "scope.h"
+#include "stats.h"
+#include "variable.h"
+
+// Files might be parsed in parallel, so stderr is locked to keep messages intact
+#define PARSE_WARN(x...)\
+    { flockfile(stderr);\
+        fprintf(stderr, "Warning: %s:%lu: ", filename().c_str(), line_number());\
+        fprintf(stderr, x); fprintf(stderr, "\n"); funlockfile(stderr); }
+
+#define PARSE_ERROR(x...)\
+    { flockfile(stderr);\
+        fprintf(stderr, "Error: %s:%lu: ", filename().c_str(), line_number());\
+        fprintf(stderr, x); fprintf(stderr, "\n"); funlockfile(stderr); }
+
+/**
+ * @brief Common part of waveform file readers. It stores the scope and
+ * variable hierarchy, so the Comparator does not need to know which file
+ * format has been used to describe the waveforms.
+ */
+class WaveFile {
+public:
+    WaveFile(const char*filename);
+    virtual ~WaveFile() {}
+
+    /**
+     * @brief Creates a reader matching the file contents (VCD or GHW).
+     */
+    static WaveFile*open(const char*filename);
+
+    virtual bool valid() const = 0;
+
+    inline const std::string&filename() const {
+        return filename_;
+    }
+
+    inline int timescale() const {
+        return timescale_;
+    }
+
+    /**
+     * @brief Reads the scopes and variables declarations.
+     */
+    virtual bool parse_header() = 0;
+
+    /**
+     * @brief Applies all value changes for the next timestamp.
+     * @param changes is the set of links that has been modified.
+     * @return false if there are no more value changes to process.
+     */
+    virtual bool next_delta(std::set<const Link*>&changes) = 0;
+
+    inline unsigned long next_timestamp() const {
+        return next_timestamp_;
+    }
+
+    inline Scope&root_scope() {
+        return root_;
+    }
+
+    inline const Scope&root_scope() const {
+        return root_;
+    }
+
+    void show_state() const;
+
+    ///> Position in a file, together with the values assigned before it
+    struct Checkpoint {
+        // Timestamp processed after the checkpoint
+        unsigned long time;
+
+        // Offset (in bytes) and line number
+        unsigned long offset;
+        int line;
+
+        // Pairs of (variable identifier, value as stored in the file)
+        std::vector<std::pair<std::string, std::string> > values;
+    };
+
+    /**
+     * @brief Scans the value changes to find checkpoints, so the file
+     * might be processed starting from the middle. Has to be called after
+     * parse_header().
+     * @param count is the approximate number of checkpoints, they are
+     * distributed evenly in the file.
+     * @return false if the file format does not support checkpoints.
+     */
+    virtual bool build_index(unsigned int count,
+                             std::vector<Checkpoint>&checkpoints) {
+        return false;
+    }
+
+    /**
+     * @brief Moves to a checkpoint found by build_index() and restores
+     * the variable values. The next call to next_delta() processes
+     * the checkpoint timestamp.
+     * @param changes is the set of links that has been modified.
+     */
+    virtual bool restore(const Checkpoint&checkpoint,
+                         std::set<const Link*>&changes) {
+        return false;
+    }
+
+    /**
+     * @brief Reads value changes for the next timestamp as raw data, without
+     * assigning them to variables. It allows to compare files quickly, when
+     * they are known to be stored in the same way.
+     * @param block receives the data.
+     * @param finished is set if there are no more value changes.
+     * @return false if the data cannot be read this way, next_delta() has to
+     * be used instead.
+     */
+    virtual bool read_block(std::string&block, bool&finished) {
+        return false;
+    }
+
+    /**
+     * @brief Moves back to the beginning of the block returned by the last
+     * read_block() call.
+     */
+    virtual void unread_block() {
+    }
+
+    /**
+     * @brief Assigns the value changes from blocks obtained with read_block(),
+     * so the variables reflect the current position in the file.
+     * @param changes is the set of links that has been modified.
+     */
+    virtual void apply_blocks(std::set<const Link*>&changes) {
+    }
+
+    /**
+     * @brief Returns variables indexed by their identifiers.
+     */
+    inline const VarStringMap&idents() const {
+        return var_idents_;
+    }
+
+    /**
+     * @brief Returns the current position in the file, used in messages.
+     */
+    virtual unsigned long line_number() const = 0;
+
+    /**
+     * @brief Adds the file statistics (read data, applied value changes).
+     */
+    virtual void collect_stats(Stats&stats) const {
+        stats.changes += changes_;
+    }
+
+    ///> Number of variables that share an identifier with another one
+    inline unsigned int aliases() const {
+        return aliases_;
+    }
+
+    ///> Number of applied value changes (0 if counters are disabled)
+    inline unsigned long changes() const {
+        return changes_.value();
+    }
+
+    /**
+     * @brief Returns the number of bytes read so far.
+     */
+    virtual unsigned long position() const = 0;
+
+    /**
+     * @brief Returns the activity of variables, indexed by the variables
+     * stored in idents().
+     */
+    inline const SignalProfileMap&profile() const {
+        return profile_;
+    }
+
+    /**
+     * @brief Adds the activity collected by another reader of the same file.
+     */
+    void merge_profile(const WaveFile&other);
+
+    inline void clear_profile() {
+        profile_.clear();
+    }
+
+    /**
+     * @brief Removes variables that are not linked to any variable in the
+     * other file, so their value changes are skipped. It has to be called
+     * after the signals are mapped.
+     * @return Number of removed variables, including vector elements.
+     */
+    unsigned int drop_unlinked();
+
+protected:
+    inline void push_scope(Scope::scope_type_t type, const char*scope) {
+        cur_scope_ = cur_scope_->make_scope(type, scope);
+    }
+
+    inline void pop_scope() {
+        cur_scope_ = cur_scope_->parent();
+        assert(cur_scope_);
+    }
+
+    void add_variable(const char*name, const char*ident,
+                      int size, Variable::var_type_t type);
+
+    /**
+     * @brief Assigns a new value to a variable and stores the associated
+     * Link (if any) in the set of changes.
+     */
+    void set_value(Variable*var, const Value&value,
+                   std::set<const Link*>&changes);
+
+    /**
+     * @brief Called before dropped variables are destroyed, so derived
+     * classes may remove the references they keep.
+     */
+    virtual void forget_variables(const std::set<const Variable*>&vars);
+
+    /**
+     * @brief Checks the memory limit while parsing the header.
+     * @return False if the limit is exceeded.
+     */
+    bool check_mem_limit();
+
+    // Records a value change for --profile
+    inline void add_profile(const Variable*var, unsigned long bytes) {
+        SignalProfile&profile = profile_[var];
+        ++profile.changes;
+        profile.bytes += bytes;
+    }
+
+    // Converts a string to lower case in-place
+    static void to_lower_case(char*str);
+
+    const std::string filename_;
+    Scope root_;
+    Scope*cur_scope_;
+    int timescale_;
+    unsigned long cur_timestamp_, next_timestamp_;
+    VarStringMap var_idents_;
+
+    // Statistics
+    Counter changes_;
+    unsigned int aliases_;
+    SignalProfileMap profile_;
+
+private:
+    // Number of check_mem_limit() calls
+    unsigned int mem_checks_;
+};
+
+#endif /* WAVEFILE_H */